@@ -1,5 +1,9 @@
 #include "arm_float_to_q23.h"
 
+#if !defined(ARM_MATH_NEON_EXPERIMENTAL) && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #if defined(ARM_MATH_NEON_EXPERIMENTAL)
 void arm_float_to_q23(const float32_t * pSrc, q23_t * pDst, uint32_t blockSize)
 {
@@ -86,3 +90,166 @@ void arm_float_to_q23(const float32_t * pSrc, q23_t * pDst, uint32_t blockSize)
 
 }
 #endif /* #if defined(ARM_MATH_NEON_EXPERIMENTAL) */
+
+#if defined(ARM_MATH_NEON_EXPERIMENTAL)
+static inline int32x4_t scale_to_q23_neon(const float32_t * pIn, float32_t scale)
+{
+    int32x4_t cvt = vcvtq_n_s32_f32(vmulq_n_f32(vld1q_f32(pIn), scale), 23);
+
+    /* saturate */
+    cvt = vminq_s32(cvt, vdupq_n_s32(0x007fffff));
+    cvt = vmaxq_s32(cvt, vdupq_n_s32(0xff800000));
+
+    return cvt;
+}
+#elif defined(__SSE2__)
+static inline __m128i scale_to_q23_sse2(const float32_t * pIn, float32_t scale)
+{
+    /* saturate in the float domain, the conversion truncates like vcvtq_n_s32_f32 */
+    __m128 in = _mm_mul_ps(_mm_loadu_ps(pIn), _mm_set1_ps(scale * 8388608.0f));
+    in = _mm_min_ps(in, _mm_set1_ps(8388607.0f));
+    in = _mm_max_ps(in, _mm_set1_ps(-8388608.0f));
+
+    return _mm_cvttps_epi32(in);
+}
+#endif
+
+void arm_scale_interleave2_f32_to_q23(const float32_t * pSrcL, const float32_t * pSrcR,
+                                      float32_t scale, q23_t * pDst, uint32_t blockSize)
+{
+    uint32_t blkCnt;                               /* loop counter */
+    const float32_t scaleQ23 = scale * 8388608.0f;
+
+#if defined(ARM_MATH_NEON_EXPERIMENTAL)
+    /* Compute 4 frames at a time, vst2q_s32 interleaves L and R */
+    blkCnt = blockSize >> 2U;
+
+    while (blkCnt > 0U)
+    {
+        int32x4x2_t out;
+        out.val[0] = scale_to_q23_neon(pSrcL, scale);
+        out.val[1] = scale_to_q23_neon(pSrcR, scale);
+        vst2q_s32(pDst, out);
+
+        pSrcL += 4;
+        pSrcR += 4;
+        pDst += 8;
+        blkCnt--;
+    }
+
+    blkCnt = blockSize & 3U;
+#elif defined(__SSE2__)
+    blkCnt = blockSize >> 2U;
+
+    while (blkCnt > 0U)
+    {
+        __m128i l = scale_to_q23_sse2(pSrcL, scale);
+        __m128i r = scale_to_q23_sse2(pSrcR, scale);
+        _mm_storeu_si128((__m128i *) pDst, _mm_unpacklo_epi32(l, r));
+        _mm_storeu_si128((__m128i *) (pDst + 4), _mm_unpackhi_epi32(l, r));
+
+        pSrcL += 4;
+        pSrcR += 4;
+        pDst += 8;
+        blkCnt--;
+    }
+
+    blkCnt = blockSize & 3U;
+#else
+    blkCnt = blockSize;
+#endif
+
+    /* Compute remaining frames */
+    while (blkCnt > 0U)
+    {
+        *pDst++ = (q23_t) __SSAT((q31_t) (*pSrcL++ * scaleQ23), 24);
+        *pDst++ = (q23_t) __SSAT((q31_t) (*pSrcR++ * scaleQ23), 24);
+
+        blkCnt--;
+    }
+}
+
+void arm_scale_interleave8_f32_to_q23(const float32_t * const pSrc[8],
+                                      float32_t scale, q23_t * pDst, uint32_t blockSize)
+{
+    uint32_t blkCnt;                               /* loop counter */
+    uint32_t nFrame = 0;
+    const float32_t scaleQ23 = scale * 8388608.0f;
+
+#if defined(ARM_MATH_NEON_EXPERIMENTAL)
+    /* Compute 4 frames at a time: convert 4 samples of each channel and
+    ** transpose the two 4x4 blocks (channels 0-3 and 4-7) into frames */
+    blkCnt = blockSize >> 2U;
+
+    while (blkCnt > 0U)
+    {
+        for (uint32_t nHalf = 0; nHalf < 2; nHalf++)
+        {
+            const float32_t * const *pIn = pSrc + nHalf * 4;
+
+            int32x4x2_t z01 = vzipq_s32(scale_to_q23_neon(pIn[0] + nFrame, scale),
+                                        scale_to_q23_neon(pIn[1] + nFrame, scale));
+            int32x4x2_t z23 = vzipq_s32(scale_to_q23_neon(pIn[2] + nFrame, scale),
+                                        scale_to_q23_neon(pIn[3] + nFrame, scale));
+
+            q23_t *pOut = pDst + nHalf * 4;
+            vst1q_s32(pOut,      vcombine_s32(vget_low_s32(z01.val[0]),  vget_low_s32(z23.val[0])));
+            vst1q_s32(pOut + 8,  vcombine_s32(vget_high_s32(z01.val[0]), vget_high_s32(z23.val[0])));
+            vst1q_s32(pOut + 16, vcombine_s32(vget_low_s32(z01.val[1]),  vget_low_s32(z23.val[1])));
+            vst1q_s32(pOut + 24, vcombine_s32(vget_high_s32(z01.val[1]), vget_high_s32(z23.val[1])));
+        }
+
+        nFrame += 4;
+        pDst += 32;
+        blkCnt--;
+    }
+
+    blkCnt = blockSize & 3U;
+#elif defined(__SSE2__)
+    blkCnt = blockSize >> 2U;
+
+    while (blkCnt > 0U)
+    {
+        for (uint32_t nHalf = 0; nHalf < 2; nHalf++)
+        {
+            const float32_t * const *pIn = pSrc + nHalf * 4;
+
+            __m128i c0 = scale_to_q23_sse2(pIn[0] + nFrame, scale);
+            __m128i c1 = scale_to_q23_sse2(pIn[1] + nFrame, scale);
+            __m128i c2 = scale_to_q23_sse2(pIn[2] + nFrame, scale);
+            __m128i c3 = scale_to_q23_sse2(pIn[3] + nFrame, scale);
+
+            __m128i z01lo = _mm_unpacklo_epi32(c0, c1);
+            __m128i z01hi = _mm_unpackhi_epi32(c0, c1);
+            __m128i z23lo = _mm_unpacklo_epi32(c2, c3);
+            __m128i z23hi = _mm_unpackhi_epi32(c2, c3);
+
+            q23_t *pOut = pDst + nHalf * 4;
+            _mm_storeu_si128((__m128i *) pOut,        _mm_unpacklo_epi64(z01lo, z23lo));
+            _mm_storeu_si128((__m128i *) (pOut + 8),  _mm_unpackhi_epi64(z01lo, z23lo));
+            _mm_storeu_si128((__m128i *) (pOut + 16), _mm_unpacklo_epi64(z01hi, z23hi));
+            _mm_storeu_si128((__m128i *) (pOut + 24), _mm_unpackhi_epi64(z01hi, z23hi));
+        }
+
+        nFrame += 4;
+        pDst += 32;
+        blkCnt--;
+    }
+
+    blkCnt = blockSize & 3U;
+#else
+    blkCnt = blockSize;
+#endif
+
+    /* Compute remaining frames */
+    while (blkCnt > 0U)
+    {
+        for (uint32_t nChannel = 0; nChannel < 8; nChannel++)
+        {
+            *pDst++ = (q23_t) __SSAT((q31_t) (pSrc[nChannel][nFrame] * scaleQ23), 24);
+        }
+
+        nFrame++;
+        blkCnt--;
+    }
+}
@@ -17,6 +17,29 @@ extern "C"
  */
 void arm_float_to_q23(const float32_t * pSrc, q23_t * pDst, uint32_t blockSize);
 
+/**
+ * @brief Scales two floating-point vectors, converts them to Q23 with saturation
+ *        and interleaves them into one stereo vector (L, R, L, R, ...).
+ * @param[in]  pSrcL      points to the left channel input vector
+ * @param[in]  pSrcR      points to the right channel input vector
+ * @param[in]  scale      gain applied before the conversion
+ * @param[out] pDst       points to the interleaved Q23 output vector (2 * blockSize)
+ * @param[in]  blockSize  number of frames
+ */
+void arm_scale_interleave2_f32_to_q23(const float32_t * pSrcL, const float32_t * pSrcR,
+                                      float32_t scale, q23_t * pDst, uint32_t blockSize);
+
+/**
+ * @brief Scales eight floating-point vectors, converts them to Q23 with saturation
+ *        and interleaves them into one 8-channel vector.
+ * @param[in]  pSrc       points to the eight channel input vectors
+ * @param[in]  scale      gain applied before the conversion
+ * @param[out] pDst       points to the interleaved Q23 output vector (8 * blockSize)
+ * @param[in]  blockSize  number of frames
+ */
+void arm_scale_interleave8_f32_to_q23(const float32_t * const pSrc[8],
+                                      float32_t scale, q23_t * pDst, uint32_t blockSize);
+
 #ifdef __cplusplus
 }
 #endif
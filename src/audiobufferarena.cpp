@@ -0,0 +1,79 @@
+//
+// audiobufferarena.cpp
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2022  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "audiobufferarena.h"
+#include <circle/logger.h>
+#include <string.h>
+#include <assert.h>
+
+LOGMODULE ("arena");
+
+CAudioBufferArena::CAudioBufferArena (void)
+:	m_pMemory (0),
+	m_pBase (0),
+	m_nSize (0),
+	m_nUsed (0)
+{
+}
+
+CAudioBufferArena::~CAudioBufferArena (void)
+{
+	delete [] m_pMemory;
+}
+
+bool CAudioBufferArena::Initialize (size_t nSize)
+{
+	assert (!m_pMemory);
+
+	m_pMemory = new u8[nSize + Alignment];
+	if (!m_pMemory)
+	{
+		LOGERR ("Cannot allocate %u bytes", (unsigned) nSize);
+
+		return false;
+	}
+
+	m_pBase = reinterpret_cast<u8 *> (  (reinterpret_cast<uintptr> (m_pMemory) + Alignment-1)
+					  & ~(uintptr) (Alignment-1));
+	m_nSize = nSize;
+	m_nUsed = 0;
+
+	memset (m_pBase, 0, m_nSize);
+
+	LOGDBG ("%u bytes allocated", (unsigned) m_nSize);
+
+	return true;
+}
+
+void *CAudioBufferArena::Allocate (size_t nSize)
+{
+	nSize = GetAlignedSize (nSize);
+	if (m_nUsed + nSize > m_nSize)
+	{
+		LOGERR ("Arena exhausted (%u + %u > %u bytes)",
+			(unsigned) m_nUsed, (unsigned) nSize, (unsigned) m_nSize);
+
+		return 0;
+	}
+
+	void *pBuffer = m_pBase + m_nUsed;
+	m_nUsed += nSize;
+
+	return pBuffer;
+}
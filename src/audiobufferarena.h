@@ -0,0 +1,66 @@
+//
+// audiobufferarena.h
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2022  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _audiobufferarena_h
+#define _audiobufferarena_h
+
+#include <circle/types.h>
+#include <stddef.h>
+
+// Fixed block of memory for the buffers of the audio path. It is allocated
+// once, when the chunk size is known, and split into cache line aligned
+// buffers, which are used for every chunk. This keeps the (large) buffers
+// off the stack and aligns them for SIMD loads and stores.
+
+class CAudioBufferArena
+{
+public:
+	static const size_t Alignment = 64;	// cache line size (Cortex-A53/A72/A76)
+
+public:
+	CAudioBufferArena (void);
+	~CAudioBufferArena (void);
+
+	bool Initialize (size_t nSize);		// in bytes, use GetAlignedSize() for each buffer
+
+	// returns 0 if the arena is exhausted
+	template <typename T>
+	T *Allocate (size_t nCount)
+	{
+		return static_cast<T *> (Allocate (nCount * sizeof (T)));
+	}
+
+	void *Allocate (size_t nSize);
+
+	size_t GetSize (void) const	{ return m_nSize; }
+	size_t GetUsed (void) const	{ return m_nUsed; }
+
+	static size_t GetAlignedSize (size_t nSize)
+	{
+		return (nSize + Alignment-1) & ~(Alignment-1);
+	}
+
+private:
+	u8 *m_pMemory;
+	u8 *m_pBase;		// m_pMemory aligned to Alignment
+	size_t m_nSize;
+	size_t m_nUsed;
+};
+
+#endif
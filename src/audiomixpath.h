@@ -0,0 +1,113 @@
+//
+// audiomixpath.h
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2024  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _audiomixpath_h
+#define _audiomixpath_h
+
+#include <arm_math.h>
+#include "common.h"
+#include "effect_mixer.hpp"
+#include "effect_platervbstereo.h"
+#include "arm_float_to_q23.h"
+#include <circle/spinlock.h>
+#include <stdint.h>
+#include <assert.h>
+
+// The stereo part of the audio path, which follows the TGs: the TG outputs
+// and the reverb sends are mixed in one pass, the reverb is added and the
+// result is converted to interleaved q23 samples. CMiniDexed::ProcessAudioPath()
+// and the offline renderer (host/hostrender.cpp) both use it, so that the
+// renderer measures the same code.
+
+enum TMixStage
+{
+	MixStageMix,
+	MixStageReverb,
+	MixStageOutput,
+	MixStageUnknown
+};
+
+// called at the start (bStart) and at the end of each stage
+typedef void TMixStageHandler (TMixStage Stage, bool bStart, void *pParam);
+
+struct TMixBuffers		// nFrames each, left and right
+{
+	float32_t *pSample[2];
+	float32_t *pReverbSend[2];
+	float32_t *pReverb[2];
+};
+
+// ppTGOutput[i] is 0 for a TG, which is not mixed (silent). pReverb is 0, if
+// the reverb is disabled.
+template <int NN>
+void MixStereo (AudioStereoSendMixer<NN> *pMixer, float32_t *ppTGOutput[NN],
+		AudioEffectPlateReverb *pReverb, CSpinLock *pReverbSpinLock,
+		const TMixBuffers &rBuffers, bool bChannelsSwapped, float32_t fMasterVolume,
+		int32_t *pOutput, unsigned nFrames,
+		TMixStageHandler *pStageHandler, void *pParam)
+{
+	assert (pMixer);
+	assert (pReverbSpinLock);
+	assert (pOutput);
+	assert (pStageHandler);
+
+	(*pStageHandler) (MixStageMix, true, pParam);
+
+	pMixer->doMix (ppTGOutput, rBuffers.pSample[0], rBuffers.pSample[1],
+		       pReverb ? rBuffers.pReverbSend[0] : 0,
+		       pReverb ? rBuffers.pReverbSend[1] : 0, nFrames);
+
+	(*pStageHandler) (MixStageMix, false, pParam);
+
+	if (pReverb)
+	{
+		(*pStageHandler) (MixStageReverb, true, pParam);
+
+		arm_fill_f32 (0.0f, rBuffers.pReverb[0], nFrames);
+		arm_fill_f32 (0.0f, rBuffers.pReverb[1], nFrames);
+
+		pReverbSpinLock->Acquire ();
+
+		pReverb->doReverb (rBuffers.pReverbSend[0], rBuffers.pReverbSend[1],
+				   rBuffers.pReverb[0], rBuffers.pReverb[1], nFrames);
+
+		// scale down and add the reverb buffers by the reverb level
+		for (unsigned i = 0; i < 2; i++)
+		{
+			arm_scale_f32 (rBuffers.pReverb[i], pReverb->get_level (), rBuffers.pReverb[i], nFrames);
+			arm_add_f32 (rBuffers.pSample[i], rBuffers.pReverb[i], rBuffers.pSample[i], nFrames);
+		}
+
+		pReverbSpinLock->Release ();
+
+		(*pStageHandler) (MixStageReverb, false, pParam);
+	}
+
+	(*pStageHandler) (MixStageOutput, true, pParam);
+
+	// swap the stereo channels, if needed, and convert the dual float array
+	// (left, right) to a single interleaved q23 array (left/right)
+	unsigned nLeft = bChannelsSwapped ? 1 : 0;
+	arm_scale_interleave2_f32_to_q23 (rBuffers.pSample[nLeft], rBuffers.pSample[1-nLeft],
+					  fMasterVolume, pOutput, nFrames);
+
+	(*pStageHandler) (MixStageOutput, false, pParam);
+}
+
+#endif
@@ -0,0 +1,79 @@
+//
+// bankdirhash.cpp
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2024  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "bankdirhash.h"
+#include <fatfs/ff.h>
+#include <string.h>
+#include <strings.h>
+#include <assert.h>
+
+// FatFs is used directly, because the directory entries of newlib do not
+// have the size and the time of the file. The time of a directory does not
+// change on FAT, when a file in it is replaced.
+static bool HashDirectory (const std::string &rPath, unsigned nSubDirs, uint32_t *pHash)
+{
+	assert (pHash);
+
+	DIR Directory;
+	if (f_opendir (&Directory, rPath.c_str ()) != FR_OK)
+	{
+		return false;
+	}
+
+	HashBytes (pHash, rPath.c_str (), rPath.length () + 1);
+
+	bool bResult = true;
+
+	FILINFO FileInfo;
+	while (   f_readdir (&Directory, &FileInfo) == FR_OK
+	       && FileInfo.fname[0])
+	{
+		const char *pName = FileInfo.fname;
+		size_t nLen = strlen (pName);
+
+		if (FileInfo.fattrib & AM_DIR)
+		{
+			if (   nSubDirs > 0
+			    && !HashDirectory (rPath + "/" + pName, nSubDirs-1, pHash))
+			{
+				bResult = false;
+				break;
+			}
+		}
+		else if (   nLen >= 5
+			 && strcasecmp (&pName[nLen-4], ".syx") == 0)
+		{
+			HashBytes (pHash, pName, nLen + 1);
+
+			uint32_t Values[2] = {(uint32_t) FileInfo.fsize,
+					      (uint32_t) FileInfo.fdate << 16 | FileInfo.ftime};
+			HashBytes (pHash, Values, sizeof Values);
+		}
+	}
+
+	f_closedir (&Directory);
+
+	return bResult;
+}
+
+// rDirName is a newlib path on the SD card (e.g. "/sysex/voice")
+bool HashBankDirectory (const std::string &rDirName, unsigned nSubDirs, uint32_t *pHash)
+{
+	return HashDirectory ((rDirName[0] == '/' ? "SD:" : "SD:/") + rDirName, nSubDirs, pHash);
+}
@@ -0,0 +1,43 @@
+//
+// bankdirhash.h
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2024  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _bankdirhash_h
+#define _bankdirhash_h
+
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+
+// Feeds the names of the bank files (.syx) and subdirectories in a directory
+// tree into the hash, together with the size, date and time of each bank
+// file. This information is taken from the directory listing, no file is
+// opened. nSubDirs is the number of nested subdirectories, which are visited.
+// Returns false, if a directory cannot be read, so that the hash is not valid.
+bool HashBankDirectory (const std::string &rDirName, unsigned nSubDirs, uint32_t *pHash);
+
+inline void HashBytes (uint32_t *pHash, const void *pData, size_t nLength)
+{
+	const uint8_t *p = static_cast<const uint8_t *> (pData);
+	for (size_t i = 0; i < nLength; i++)
+	{
+		*pHash = (*pHash ^ p[i]) * 16777619U;	// FNV-1a
+	}
+}
+
+#endif
@@ -0,0 +1,208 @@
+//
+// bankregistry.h
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2024  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _bankregistry_h
+#define _bankregistry_h
+
+#include <vector>
+#include <algorithm>
+#include <stddef.h>
+#include <stdint.h>
+#include <assert.h>
+
+// Sparse map from bank IDs (0 .. MaxBankID) to a value, which only takes
+// memory for the banks, which exist. The banks are added in any order with
+// Add() and Finish() sorts them by ID afterwards. Finish() also builds a table
+// with the index of the first bank >= ID for each possible ID (2 bytes per
+// ID, 32 KB for 16384 IDs), so that Find(), GetNext() and GetPrevious() do
+// not search at all.
+
+template <typename T, unsigned MaxBankID>
+class CBankRegistry
+{
+	static_assert (MaxBankID < UINT16_MAX, "Bank index must fit into 16 bits");
+
+public:
+	void Clear (void)
+	{
+		m_Entries.clear ();
+		m_Entries.shrink_to_fit ();
+		m_Added.clear ();
+		m_LowerBound.clear ();
+		m_LowerBound.shrink_to_fit ();
+	}
+
+	// returns false, if the bank has been added before
+	bool Add (unsigned nBankID, const T &rValue)
+	{
+		assert (nBankID <= MaxBankID);
+
+		if (m_Added.empty ())
+		{
+			m_Added.resize (MaxBankID+1);		// while adding only
+		}
+
+		if (m_Added[nBankID])
+		{
+			return false;
+		}
+
+		m_Added[nBankID] = true;
+		m_Entries.push_back ({nBankID, rValue});
+
+		return true;
+	}
+
+	// must be called after the last Add()
+	void Finish (void)
+	{
+		std::sort (m_Entries.begin (), m_Entries.end (),
+			   [] (const TEntry &a, const TEntry &b) { return a.nBankID < b.nBankID; });
+		m_Entries.shrink_to_fit ();
+
+		m_Added.clear ();
+		m_Added.shrink_to_fit ();
+
+		m_LowerBound.resize (MaxBankID+1);
+		unsigned nIndex = 0;
+		for (unsigned nBankID = 0; nBankID <= MaxBankID; nBankID++)
+		{
+			while (   nIndex < m_Entries.size ()
+			       && m_Entries[nIndex].nBankID < nBankID)
+			{
+				nIndex++;
+			}
+
+			m_LowerBound[nBankID] = nIndex;
+		}
+	}
+
+	unsigned GetCount (void) const
+	{
+		return m_Entries.size ();
+	}
+
+	size_t GetMemory (void) const			// of the entries and the table
+	{
+		return   m_Entries.capacity () * sizeof (TEntry)
+		       + m_LowerBound.capacity () * sizeof (uint16_t);
+	}
+
+	// the values in the order of their bank IDs
+	const T &GetValue (unsigned nIndex) const
+	{
+		assert (nIndex < m_Entries.size ());
+		return m_Entries[nIndex].Value;
+	}
+
+	// returns nullptr, if the bank does not exist
+	const T *Find (unsigned nBankID) const
+	{
+		unsigned nIndex = Search (nBankID);
+		if (   nIndex < m_Entries.size ()
+		    && m_Entries[nIndex].nBankID == nBankID)
+		{
+			return &m_Entries[nIndex].Value;
+		}
+
+		return nullptr;
+	}
+
+	// 0, if there are no banks
+	unsigned GetHighest (void) const
+	{
+		return m_Entries.empty () ? 0 : m_Entries.back ().nBankID;
+	}
+
+	// the next bank above nBankID (which need not exist) with wrap-around,
+	// nBankID, if there is no other bank
+	unsigned GetNext (unsigned nBankID) const
+	{
+		unsigned nCount = m_Entries.size ();
+		if (nCount == 0)
+		{
+			return nBankID;
+		}
+
+		unsigned nIndex = Search (nBankID);
+		if (   nIndex < nCount
+		    && m_Entries[nIndex].nBankID == nBankID)
+		{
+			nIndex++;
+		}
+
+		if (nIndex == nCount)
+		{
+			nIndex = 0;				// wrap-around
+		}
+
+		return Select (nIndex, nBankID);
+	}
+
+	// the next bank below nBankID (which need not exist) with wrap-around,
+	// nBankID, if there is no other bank
+	unsigned GetPrevious (unsigned nBankID) const
+	{
+		unsigned nCount = m_Entries.size ();
+		if (nCount == 0)
+		{
+			return nBankID;
+		}
+
+		unsigned nIndex = Search (nBankID);		// first bank >= nBankID
+		nIndex = nIndex > 0 ? nIndex-1 : nCount-1;	// with wrap-around
+
+		return Select (nIndex, nBankID);
+	}
+
+private:
+	// index of the first bank >= nBankID
+	unsigned Search (unsigned nBankID) const
+	{
+		assert (m_Added.empty ());			// Finish() has been called
+		assert (nBankID <= MaxBankID);
+		assert (!m_LowerBound.empty () || m_Entries.empty ());
+
+		return m_Entries.empty () ? 0 : m_LowerBound[nBankID];
+	}
+
+	unsigned Select (unsigned nIndex, unsigned nBankID) const
+	{
+		unsigned nResult = m_Entries[nIndex].nBankID;
+		if (nResult == nBankID)
+		{
+			return nBankID;				// the only bank
+		}
+
+		return nResult;
+	}
+
+private:
+	struct TEntry
+	{
+		unsigned nBankID;
+		T Value;
+	};
+
+	std::vector<TEntry> m_Entries;			// sorted by nBankID after Finish()
+	std::vector<bool> m_Added;			// while adding
+	std::vector<uint16_t> m_LowerBound;		// index of the first bank >= ID
+};
+
+#endif
@@ -49,6 +49,12 @@ void CConfig::Load (void)
 	{
 		m_nPolyphony = DefaultNotes;
 	}
+	m_bPolyphonyGovernor = m_Properties.GetNumber ("PolyphonyGovernor", 0) != 0;
+	m_nVoicePool = m_Properties.GetNumber ("VoicePool", 0);
+	if (m_nVoicePool > MaxVoicePool)
+	{
+		m_nVoicePool = MaxVoicePool;
+	}
 	
 	m_bUSBGadget = m_Properties.GetNumber ("USBGadget", 0) != 0;
 	m_nUSBGadgetPin = m_Properties.GetNumber ("USBGadgetPin", 0); // Default OFF
@@ -69,6 +75,18 @@ void CConfig::Load (void)
 		m_nChunkSize = m_Properties.GetNumber ("ChunkSize", 1024);
 #endif
 	}
+	if (m_nChunkSize > MaxChunkSize)
+	{
+		m_nChunkSize = MaxChunkSize;
+	}
+#ifdef ARM_ALLOW_MULTI_CORE
+	m_bPipelinedRender = m_Properties.GetNumber ("PipelinedRender", 0) != 0;
+	m_bDirectSoundOutput = m_Properties.GetNumber ("DirectSoundOutput", 0) != 0;
+#else
+	m_bPipelinedRender = false;
+	m_bDirectSoundOutput = false;
+#endif
+	m_bAdaptiveChunkSize = m_Properties.GetNumber ("AdaptiveChunkSize", 0) != 0;
 	m_nDACI2CAddress = m_Properties.GetNumber ("DACI2CAddress", 0);
 	m_bChannelsSwapped = m_Properties.GetNumber ("ChannelsSwapped", 0) != 0;
 
@@ -104,6 +122,7 @@ void CConfig::Load (void)
 	}
 	
 	m_bMIDIRXProgramChange = m_Properties.GetNumber ("MIDIRXProgramChange", 1) != 0;
+	m_bSampleAccurateMIDI = m_Properties.GetNumber ("SampleAccurateMIDI", 0) != 0;
 	m_bIgnoreAllNotesOff = m_Properties.GetNumber ("IgnoreAllNotesOff", 0) != 0;
 	m_bMIDIAutoVoiceDumpOnPC = m_Properties.GetNumber ("MIDIAutoVoiceDumpOnPC", 0) != 0;
 	m_bHeaderlessSysExVoices = m_Properties.GetNumber ("HeaderlessSysExVoices", 0) != 0;
@@ -230,6 +249,16 @@ unsigned CConfig::GetPolyphony (void) const
 	return m_nPolyphony;
 }
 
+bool CConfig::GetPolyphonyGovernor (void) const
+{
+	return m_bPolyphonyGovernor;
+}
+
+unsigned CConfig::GetVoicePool (void) const
+{
+	return m_nVoicePool;
+}
+
 unsigned CConfig::GetTGsCore1 (void) const
 {
 #ifndef ARM_ALLOW_MULTI_CORE
@@ -297,6 +326,21 @@ unsigned CConfig::GetChunkSize (void) const
 	return m_nChunkSize;
 }
 
+bool CConfig::GetPipelinedRender (void) const
+{
+	return m_bPipelinedRender;
+}
+
+bool CConfig::GetDirectSoundOutput (void) const
+{
+	return m_bDirectSoundOutput;
+}
+
+bool CConfig::GetAdaptiveChunkSize (void) const
+{
+	return m_bAdaptiveChunkSize;
+}
+
 unsigned CConfig::GetDACI2CAddress (void) const
 {
 	return m_nDACI2CAddress;
@@ -337,6 +381,11 @@ bool CConfig::GetMIDIRXProgramChange (void) const
 	return m_bMIDIRXProgramChange;
 }
 
+bool CConfig::GetSampleAccurateMIDI (void) const
+{
+	return m_bSampleAccurateMIDI;
+}
+
 bool CConfig::GetIgnoreAllNotesOff (void) const
 {
 	return m_bIgnoreAllNotesOff;
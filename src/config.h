@@ -79,6 +79,7 @@ public:
 	static const unsigned MaxNotes = 16;
 	static const unsigned DefaultNotes = 16;
 #endif
+	static const unsigned MaxVoicePool = 255;	// voices of all TGs, see VoicePool
 
 	static const unsigned MaxChunkSize = 4096;
 
@@ -101,6 +102,8 @@ public:
 	// TGs and Polyphony
 	unsigned GetToneGenerators (void) const;
 	unsigned GetPolyphony (void) const;
+	bool GetPolyphonyGovernor (void) const;		// false if not specified
+	unsigned GetVoicePool (void) const;		// 0 if not specified (no pool)
 	unsigned GetTGsCore1 (void) const;
 	unsigned GetTGsCore23 (void) const;
 	
@@ -114,6 +117,9 @@ public:
 	const char *GetSoundDevice (void) const;
 	unsigned GetSampleRate (void) const;
 	unsigned GetChunkSize (void) const;
+	bool GetPipelinedRender (void) const;		// false if not specified
+	bool GetDirectSoundOutput (void) const;		// false if not specified
+	bool GetAdaptiveChunkSize (void) const;		// false if not specified
 	unsigned GetDACI2CAddress (void) const;		// 0 for auto probing
 	bool GetChannelsSwapped (void) const;
 	unsigned GetEngineType (void) const;
@@ -124,6 +130,7 @@ public:
 	const char *GetMIDIThruIn (void) const;	// "" if not specified
 	const char *GetMIDIThruOut (void) const;	// "" if not specified
 	bool GetMIDIRXProgramChange (void) const;	// true if not specified
+	bool GetSampleAccurateMIDI (void) const;	// false if not specified
 	bool GetIgnoreAllNotesOff (void) const;
 	bool GetMIDIAutoVoiceDumpOnPC (void) const; // false if not specified
 	bool GetHeaderlessSysExVoices (void) const; // false if not specified
@@ -264,6 +271,8 @@ private:
 	
 	unsigned m_nToneGenerators;
 	unsigned m_nPolyphony;
+	bool m_bPolyphonyGovernor;
+	unsigned m_nVoicePool;
 	
 	bool m_bUSBGadget;
 	unsigned m_nUSBGadgetPin;
@@ -272,6 +281,9 @@ private:
 	std::string m_SoundDevice;
 	unsigned m_nSampleRate;
 	unsigned m_nChunkSize;
+	bool m_bPipelinedRender;
+	bool m_bDirectSoundOutput;
+	bool m_bAdaptiveChunkSize;
 	unsigned m_nDACI2CAddress;
 	bool m_bChannelsSwapped;
 	unsigned m_EngineType;
@@ -281,6 +293,7 @@ private:
 	std::string m_MIDIThruIn;
 	std::string m_MIDIThruOut;
 	bool m_bMIDIRXProgramChange;
+	bool m_bSampleAccurateMIDI;
 	bool m_bIgnoreAllNotesOff;
 	bool m_bMIDIAutoVoiceDumpOnPC;
 	bool m_bHeaderlessSysExVoices;
@@ -957,7 +957,7 @@ void CMiniLab3DawConnection::SetPadColor (TBankID BankID, TPadID PadID, CColor c
 		return;
 
 	const uint8_t pSetPadColor[] = {0xF0, 0x00, 0x20, 0x6B, 0x7F, 0x42, 0x02, 0x02, 0x16, (uint8_t)(PadID + BankID), color.r, color.g, color.b, 0xF7};
-	m_pKeyboard->Send (pSetPadColor, sizeof pSetPadColor, 0);
+	m_pKeyboard->SendState (pSetPadColor, sizeof pSetPadColor, 10, 0);
 
 	if (BankID == BankA)
 		m_PadColorCache[PadID] = color;
@@ -966,7 +966,7 @@ void CMiniLab3DawConnection::SetPadColor (TBankID BankID, TPadID PadID, CColor c
 void CMiniLab3DawConnection::UpdateEncoder (uint8_t ucEncID, uint8_t ucValue)
 {
 	uint8_t pUpdateEncoder[] = {0xF0, 0x00, 0x20, 0x6B, 0x7F, 0x42, 0x21, 0x10, 0x00, ucEncID+=7, 0x00, ucValue, 0xF7};
-	m_pKeyboard->Send (pUpdateEncoder, sizeof pUpdateEncoder, 0);
+	m_pKeyboard->SendState (pUpdateEncoder, sizeof pUpdateEncoder, 10, 0);
 }
 
 void CMiniLab3DawConnection::UpdateTGColors ()
@@ -1592,7 +1592,7 @@ void CKeyLabEs3DawConnection::DisplayWrite (const char *pMenu, const char *pPara
 void CKeyLabEs3DawConnection::UpdateEncoder (uint8_t ucEncID, uint8_t ucValue)
 {
 	uint8_t pUpdateEncoder[] = {0xF0, 0x00, 0x20, 0x6B, 0x7F, 0x42, 0x02, 0x0F, 0x40, ucEncID += 3, ucValue, 0xF7};
-	m_pKeyboard->Send (pUpdateEncoder, sizeof pUpdateEncoder, 0);
+	m_pKeyboard->SendState (pUpdateEncoder, sizeof pUpdateEncoder, 10, 0);
 } 
 
 void CKeyLabEs3DawConnection::UpdateState ()
@@ -1826,7 +1826,7 @@ CKeyLab2DawConnection::CKeyLab2DawConnection (CMiniDexed *pSynthesizer, CMIDIKey
 void CKeyLab2DawConnection::SetButtonColor (TRGBButton &button, CColor color)
 {
 	const uint8_t pSetButtonColor[] = {0xF0, 0x00, 0x20, 0x6B, 0x7F, 0x42, 0x02, 0x00, 0x16, button.sysexID, color.r, color.g, color.b, 0xF7};
-	m_pKeyboard->Send (pSetButtonColor, sizeof pSetButtonColor, 0);
+	m_pKeyboard->SendState (pSetButtonColor, sizeof pSetButtonColor, 10, 0);
 }
 
 void CKeyLab2DawConnection::SetButtonIntensity (TButton &button, uint8_t intensity)
@@ -1835,7 +1835,7 @@ void CKeyLab2DawConnection::SetButtonIntensity (TButton &button, uint8_t intensi
 		return;
 
 	const uint8_t pSetButtonIntensity[] = {0xF0, 0x00, 0x20, 0x6B, 0x7F, 0x42, 0x02, 0x00, 0x10, button.sysexID, intensity, 0xF7};
-	m_pKeyboard->Send (pSetButtonIntensity, sizeof pSetButtonIntensity, 0);
+	m_pKeyboard->SendState (pSetButtonIntensity, sizeof pSetButtonIntensity, 10, 0);
 
 	button.last_value = intensity;
 }
@@ -2292,7 +2292,7 @@ void CDAWController::DAWFallbackTimer(TKernelTimerHandle hTimer, void *pParam, v
 	}
 }
 
-void CDAWController::MIDISysexHandler (u8 *pPacket, unsigned nLength, unsigned nCable)
+void CDAWController::MIDISysexHandler (const u8 *pPacket, unsigned nLength, unsigned nCable)
 {
 	// Add debug logging for all received SysEx messages
 	printf("DAW Controller: Received SysEx message (length=%u, cable=%u): ", nLength, nCable);
@@ -59,7 +59,7 @@ public:
 	void UpdateState();
 	void UpdateMenu(CUIMenu::TCPageType Type, s8 ucPage, u8 ucOP, u8 ucTG);
 	void MIDIListener(u8 ucCable, u8 ucChannel, u8 ucType, u8 ucP1, u8 ucP2);
-	void MIDISysexHandler(u8 *pPacket, unsigned nLength, unsigned nCable);
+	void MIDISysexHandler(const u8 *pPacket, unsigned nLength, unsigned nCable);
 
 	// Looper functions
 	void StartLooper(unsigned nPad);
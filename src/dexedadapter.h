@@ -22,66 +22,800 @@
 #define _dexedadapter_h
 
 #include <synth_dexed.h>
+#include "voicepool.h"
+#include "spscring.h"
 #include <circle/spinlock.h>
+#include <circle/timer.h>
+#include <atomic>
 #include <stdint.h>
+#include <string.h>
+#include <assert.h>
 
 #define DEXED_OP_ENABLE (DEXED_OP_OSC_DETUNE + 1)
 
-// Some Dexed methods require to be guarded from being interrupted
-// by other Dexed calls. This is done herein.
+// The note and voice events (keydown, keyup, sustain, voice loading ...)
+// are not applied by the caller, but put into a lock-free event ring, which
+// the render core drains at the start of getSamples(). This way a burst of
+// MIDI events on core 0 never stalls the render of the TG and vice versa.
+// The producers on core 0 (main loop and USB MIDI interrupt) are serialized
+// with a spinlock, which is never taken by the render core. A TG, which is
+// not rendered (disabled), must call processEvents() once per chunk.
+//
+// Each event is timestamped with the clock ticks, when it was put. The
+// caller of getSamples() maps the first frame of the chunk to a point in
+// time (one chunk period back) and each event is applied at its frame offset
+// in the chunk, by splitting the render of the TG. The offset is rounded
+// down to a multiple of _N_ frames, the block size of Dexed. Events, which
+// are newer than the chunk, stay in the ring for the next one.
+//
+// The setters of voice parameters (voice data elements, transpose, name,
+// mono mode, portamento, pitch bend range ...) are queued in the same ring,
+// so that they are applied in order with the voice loads. The producer keeps
+// a copy of the voice data with all queued changes, which getName(),
+// getVoiceData() and getVoiceDataElement() return.
+//
+// The adapter also tracks, if the TG is sounding at all. When no voice is
+// playing and the output has decayed below SilenceThreshold for
+// SilentChunksIdle chunks, the TG goes idle and getSamples() does not render
+// anything, until the next keydown().
+//
+// The number of live (rendered) voices can be limited below maxnotes at
+// runtime (by the polyphony governor). Voices above the limit are stolen,
+// the quietest releasing voices first, then the quietest held ones. A stolen
+// voice is not cut, but faded out with the fastest release rate. With a
+// voice pool, a keydown reuses a voice of this TG, when the pool is
+// exhausted, and is ignored, if the TG has no voice at all. A TG, which
+// plays all of its voices, reports a voice shortage and the main loop grows
+// its voices with growMaxNotes().
 
 class CDexedAdapter : public Dexed
 {
+public:
+	static constexpr float32_t SilenceThreshold = 1.0e-5f;	// about -100 dBFS
+	static const unsigned SilentChunksIdle = 4;
+
+	static const unsigned EventRingSize = 256;		// events per TG
+	static const unsigned VoiceRingSize = 8;		// voice loads per TG
+
 public:
 	CDexedAdapter (uint8_t maxnotes, int rate)
-	: Dexed (maxnotes, rate)
+	: Dexed (maxnotes, rate),
+	  m_nSampleRate (rate),
+	  m_bActive (false),
+	  m_nSilentChunks (0),
+	  m_nVoiceLimit (UINT8_MAX),
+	  m_nLiveVoices (0),
+	  m_pVoicePool (0),
+	  m_nTG (0),
+	  m_bVoiceShortage (false),
+	  m_bSuspended (false),
+	  m_bRendering (false),
+	  m_nDroppedEvents (0)
 	{
+		memset (m_bFading, 0, sizeof m_bFading);
+
+		Dexed::getVoiceData (m_VoiceData.Data);		// the init voice
+	}
+
+	void setVoicePool (CVoicePool *pVoicePool, unsigned nTG)
+	{
+		m_pVoicePool = pVoicePool;
+		m_nTG = nTG;
+	}
+
+	// Reallocates the voices on the calling core (not from interrupt), call
+	// only on performance changes. The render core skips the TG meanwhile.
+	void setMaxNotes (uint8_t n)
+	{
+		m_bSuspended = true;
+		while (m_bRendering)
+		{
+			// wait until a running getSamples() or processEvents() is done
+		}
+
+		Dexed::setMaxNotes (n);
+		memset (m_bFading, 0, sizeof m_bFading);
+		UpdateLiveVoices (0);
+		m_bVoiceShortage = false;
+
+		m_bSuspended = false;
+	}
+
+	// Adds voices on the calling core (not from interrupt), the voices, which
+	// are playing, are kept. Only the switch to the new voice array suspends
+	// the TG, the memory is allocated and freed outside.
+	void growMaxNotes (uint8_t n)
+	{
+		uint8_t nOld = max_notes;
+		if (n <= nOld)
+		{
+			return;
+		}
+
+		ProcessorVoice *pVoices = new ProcessorVoice[n] ();	// not live
+		for (uint8_t i = nOld; i < n; i++)
+		{
+			pVoices[i].dx7_note = new Dx7Note;
+		}
+
+		m_bSuspended = true;
+		while (m_bRendering)
+		{
+			// wait until a running getSamples() or processEvents() is done
+		}
+
+		for (uint8_t i = 0; i < nOld; i++)
+		{
+			pVoices[i] = voices[i];			// takes over the Dx7Note
+		}
+
+		ProcessorVoice *pOldVoices = voices;
+		voices = pVoices;
+		max_notes = n;
+		m_bVoiceShortage = false;
+
+		m_bSuspended = false;
+
+		delete [] pOldVoices;
+	}
+
+	// all voices have been in use after a keydown
+	bool hasVoiceShortage (void) const
+	{
+		return m_bVoiceShortage;
 	}
 
 	void loadVoiceParameters (uint8_t* data)
 	{
-		m_SpinLock.Acquire ();
-		Dexed::loadVoiceParameters (data);
-		m_SpinLock.Release ();
+		m_ProducerLock.Acquire ();
+
+		memcpy (m_VoiceData.Data, data, sizeof m_VoiceData.Data);
+		PutVoice ();
+
+		m_ProducerLock.Release ();
 	}
 
-	void keyup (int16_t pitch)
+	void setVoiceDataElement (uint8_t address, uint8_t value)
 	{
-		m_SpinLock.Acquire ();
-		Dexed::keyup (pitch);
-		m_SpinLock.Release ();
+		assert (address < sizeof m_VoiceData.Data);
+
+		m_ProducerLock.Acquire ();
+
+		m_VoiceData.Data[address] = value;
+		PutEventLocked (EventVoiceDataElement, address, value);
+
+		m_ProducerLock.Release ();
 	}
 
-	void keydown (int16_t pitch, uint8_t velo)
+	uint8_t getVoiceDataElement (uint8_t address)
+	{
+		assert (address < sizeof m_VoiceData.Data);
+
+		return m_VoiceData.Data[address];
+	}
+
+	void setTranspose (int8_t transpose)
+	{
+		m_ProducerLock.Acquire ();
+
+		m_VoiceData.Data[DEXED_VOICE_OFFSET + DEXED_TRANSPOSE] = transpose;
+		PutEventLocked (EventTranspose, transpose);
+
+		m_ProducerLock.Release ();
+	}
+
+	// the name does not fit into an event, the whole voice is queued
+	void setName (char *name)
+	{
+		m_ProducerLock.Acquire ();
+
+		strncpy ((char *) &m_VoiceData.Data[DEXED_VOICE_OFFSET + DEXED_NAME], name, 10);
+		PutVoice ();
+
+		m_ProducerLock.Release ();
+	}
+
+	void setOPAll (uint8_t ops)
+	{
+		PutEvent (EventOPAll, 0, ops);
+	}
+
+	void setMonoMode (bool mode)
+	{
+		PutEvent (EventMonoMode, 0, mode);
+	}
+
+	void doRefreshVoice (void)
+	{
+		PutEvent (EventRefreshVoice);
+	}
+
+	void setPortamentoMode (uint8_t portamento_mode)
+	{
+		PutEvent (EventPortamentoMode, 0, portamento_mode);
+	}
+
+	void setPortamentoGlissando (uint8_t portamento_glissando)
 	{
-		m_SpinLock.Acquire ();
-		Dexed::keydown (pitch, velo);
-		m_SpinLock.Release ();
+		PutEvent (EventPortamentoGlissando, 0, portamento_glissando);
 	}
 
-	void getSamples (float32_t* buffer, uint16_t n_samples)
+	void setPortamentoTime (uint8_t portamento_time)
 	{
-		m_SpinLock.Acquire ();
-		Dexed::getSamples (buffer, n_samples);
-		m_SpinLock.Release ();
+		PutEvent (EventPortamentoTime, 0, portamento_time);
+	}
+
+	void setPitchbendRange (uint8_t range)
+	{
+		PutEvent (EventPitchbendRange, 0, range);
+	}
+
+	void setPitchbendStep (uint8_t step)
+	{
+		PutEvent (EventPitchbendStep, 0, step);
+	}
+
+	void keyup (int16_t pitch)
+	{
+		PutEvent (EventKeyUp, pitch);
+	}
+
+	void keydown (int16_t pitch, uint8_t velo)
+	{
+		PutEvent (EventKeyDown, pitch, velo);
 	}
 
 	void ControllersRefresh (void)
 	{
-		m_SpinLock.Acquire ();
-		Dexed::ControllersRefresh ();
-		m_SpinLock.Release ();
+		PutEvent (EventControllersRefresh);
 	}
 
 	void setSustain (bool sustain)
 	{
-		m_SpinLock.Acquire ();
-		Dexed::setSustain (sustain);
-		m_SpinLock.Release ();
+		PutEvent (EventSustain, 0, sustain);
+	}
+
+	void setSostenuto (bool sostenuto)
+	{
+		PutEvent (EventSostenuto, 0, sostenuto);
+	}
+
+	void setHold (bool hold)
+	{
+		PutEvent (EventHold, 0, hold);
+	}
+
+	void panic (void)
+	{
+		PutEvent (EventPanic);
+	}
+
+	void notesOff (void)
+	{
+		PutEvent (EventNotesOff);
+	}
+
+	void getName (char *buffer)
+	{
+		memcpy (buffer, &m_VoiceData.Data[DEXED_VOICE_OFFSET + DEXED_NAME], 10);
+		buffer[10] = '\0';
+	}
+
+	void getVoiceData (uint8_t *data_copy)
+	{
+		memcpy (data_copy, m_VoiceData.Data, sizeof m_VoiceData.Data);
+	}
+
+	// returns false, if the TG is idle and buffer has not been written
+	// nStartTicks: clock ticks, to which the first frame of buffer is mapped
+	bool getSamples (float32_t* buffer, uint16_t n_samples, unsigned nStartTicks)
+	{
+		if (!BeginRender ())
+		{
+			return false;
+		}
+
+		unsigned nFirstFrame = n_samples;	// first rendered frame
+		unsigned nFrame = 0;
+		while (nFrame < n_samples)
+		{
+			unsigned nNextFrame = ProcessEvents (nStartTicks, nFrame, n_samples);
+			if (nFrame == 0)
+			{
+				LimitVoices (m_nVoiceLimit);
+			}
+
+			if (m_bActive)
+			{
+				if (nFirstFrame == n_samples)
+				{
+					nFirstFrame = nFrame;
+				}
+
+				Dexed::getSamples (buffer + nFrame, nNextFrame - nFrame);
+			}
+
+			nFrame = nNextFrame;
+		}
+
+		if (nFirstFrame == n_samples)
+		{
+			UpdateLiveVoices (0);
+
+			m_bRendering = false;
+
+			return false;
+		}
+
+		// the TG has been woken up by a keydown within the chunk
+		memset (buffer, 0, nFirstFrame * sizeof *buffer);
+
+		UpdateActivity (buffer, n_samples);
+
+		UpdateLiveVoices (CountLiveVoices ());
+
+		m_bRendering = false;
+
+		return true;
+	}
+
+	// render core only, applies all pending events
+	void processEvents (void)
+	{
+		if (!BeginRender ())
+		{
+			return;
+		}
+
+		TEvent Event;
+		while (m_EventRing.Get (&Event))
+		{
+			ApplyEvent (Event);
+		}
+
+		m_bRendering = false;
+	}
+
+	bool IsActive (void) const
+	{
+		return m_bActive;
+	}
+
+	// takes effect with the next getSamples() or keydown()
+	void setVoiceLimit (uint8_t nLimit)
+	{
+		m_nVoiceLimit = nLimit;
+	}
+
+	// in the last getSamples()
+	unsigned getLiveVoices (void) const
+	{
+		return m_nLiveVoices;
+	}
+
+	// events lost, because the event ring was full
+	unsigned getDroppedEvents (void) const
+	{
+		return m_nDroppedEvents;
+	}
+
+private:
+	enum TEventType : uint8_t
+	{
+		EventKeyDown,			// nValue: pitch, ucParam: velocity
+		EventKeyUp,			// nValue: pitch
+		EventSustain,			// ucParam: on
+		EventSostenuto,			// ucParam: on
+		EventHold,			// ucParam: on
+		EventControllersRefresh,
+		EventLoadVoice,			// data from m_VoiceRing
+		EventVoiceDataElement,		// nValue: address, ucParam: value
+		EventTranspose,			// nValue: transpose
+		EventOPAll,			// ucParam: operator mask
+		EventMonoMode,			// ucParam: on
+		EventRefreshVoice,
+		EventPortamentoMode,		// ucParam: mode
+		EventPortamentoGlissando,	// ucParam: glissando
+		EventPortamentoTime,		// ucParam: time
+		EventPitchbendRange,		// ucParam: range
+		EventPitchbendStep,		// ucParam: step
+		EventPanic,
+		EventNotesOff
+	};
+
+	struct TEvent
+	{
+		TEventType Type;
+		uint8_t ucParam;
+		int16_t nValue;
+		unsigned nTicks;		// CTimer::GetClockTicks() when put
+	};
+
+	struct TVoiceData
+	{
+		uint8_t Data[NUM_VOICE_PARAMETERS];
+	};
+
+	// returns false, if the voices are reallocated, must be followed by
+	// m_bRendering = false otherwise
+	bool BeginRender (void)
+	{
+		m_bRendering = true;
+		if (m_bSuspended)
+		{
+			m_bRendering = false;
+
+			return false;
+		}
+
+		return true;
+	}
+
+	void PutEvent (TEventType Type, int16_t nValue = 0, uint8_t ucParam = 0)
+	{
+		m_ProducerLock.Acquire ();
+
+		PutEventLocked (Type, nValue, ucParam);
+
+		m_ProducerLock.Release ();
+	}
+
+	// m_ProducerLock must be held
+	void PutEventLocked (TEventType Type, int16_t nValue = 0, uint8_t ucParam = 0)
+	{
+		TEvent Event = {Type, ucParam, nValue, CTimer::GetClockTicks ()};
+
+		if (!m_EventRing.Put (Event))
+		{
+			m_nDroppedEvents++;
+		}
+	}
+
+	// queues a load of m_VoiceData, m_ProducerLock must be held
+	void PutVoice (void)
+	{
+		// the event must not be seen before its voice data
+		TVoiceData *pVoice = m_VoiceRing.GetWriteEntry ();
+		TEvent *pEvent = m_EventRing.GetWriteEntry ();
+		if (pVoice && pEvent)
+		{
+			memcpy (pVoice->Data, m_VoiceData.Data, sizeof pVoice->Data);
+			m_VoiceRing.Commit ();
+
+			pEvent->Type = EventLoadVoice;
+			pEvent->nTicks = CTimer::GetClockTicks ();
+			m_EventRing.Commit ();
+		}
+		else
+		{
+			m_nDroppedEvents++;
+		}
+	}
+
+	// applies the events up to frame nFrame, returns the frame of the next
+	// pending event (nFrames, if there is none within the chunk)
+	unsigned ProcessEvents (unsigned nStartTicks, unsigned nFrame, unsigned nFrames)
+	{
+		const TEvent *pEvent;
+		while ((pEvent = m_EventRing.GetReadEntry ()) != 0)
+		{
+			unsigned nEventFrame = GetEventFrame (pEvent->nTicks, nStartTicks);
+			if (nEventFrame > nFrame)
+			{
+				return nEventFrame < nFrames ? nEventFrame : nFrames;
+			}
+
+			ApplyEvent (*pEvent);
+			m_EventRing.Release ();
+		}
+
+		return nFrames;
+	}
+
+	unsigned GetEventFrame (unsigned nTicks, unsigned nStartTicks) const
+	{
+		int nDeltaTicks = (int) (nTicks - nStartTicks);	// clock may wrap
+		if (nDeltaTicks <= 0)
+		{
+			return 0;
+		}
+
+		u64 nFrame = (u64) nDeltaTicks * m_nSampleRate / CLOCKHZ;
+		if (nFrame > UINT16_MAX)
+		{
+			return UINT16_MAX;
+		}
+
+		return (unsigned) nFrame / _N_ * _N_;
+	}
+
+	void ApplyEvent (const TEvent &rEvent)
+	{
+		switch (rEvent.Type)
+		{
+		case EventKeyDown:
+			KeyDown (rEvent.nValue, rEvent.ucParam);
+			break;
+
+		case EventKeyUp:
+			Dexed::keyup (rEvent.nValue);
+			break;
+
+		case EventSustain:
+			Dexed::setSustain (!!rEvent.ucParam);
+			break;
+
+		case EventSostenuto:
+			Dexed::setSostenuto (!!rEvent.ucParam);
+			break;
+
+		case EventHold:
+			Dexed::setHold (!!rEvent.ucParam);
+			break;
+
+		case EventControllersRefresh:
+			Dexed::ControllersRefresh ();
+			break;
+
+		case EventLoadVoice: {
+				const TVoiceData *pVoice = m_VoiceRing.GetReadEntry ();
+				assert (pVoice);
+				Dexed::loadVoiceParameters (const_cast<uint8_t *> (pVoice->Data));
+				m_VoiceRing.Release ();
+			} break;
+
+		case EventVoiceDataElement:
+			Dexed::setVoiceDataElement (rEvent.nValue, rEvent.ucParam);
+			break;
+
+		case EventTranspose:
+			Dexed::setTranspose (rEvent.nValue);
+			break;
+
+		case EventOPAll:
+			Dexed::setOPAll (rEvent.ucParam);
+			break;
+
+		case EventMonoMode:
+			Dexed::setMonoMode (!!rEvent.ucParam);
+			break;
+
+		case EventRefreshVoice:
+			Dexed::doRefreshVoice ();
+			break;
+
+		case EventPortamentoMode:
+			Dexed::setPortamentoMode (rEvent.ucParam);
+			break;
+
+		case EventPortamentoGlissando:
+			Dexed::setPortamentoGlissando (rEvent.ucParam);
+			break;
+
+		case EventPortamentoTime:
+			Dexed::setPortamentoTime (rEvent.ucParam);
+			break;
+
+		case EventPitchbendRange:
+			Dexed::setPitchbendRange (rEvent.ucParam);
+			break;
+
+		case EventPitchbendStep:
+			Dexed::setPitchbendStep (rEvent.ucParam);
+			break;
+
+		case EventPanic:
+			Dexed::panic ();
+			break;
+
+		case EventNotesOff:
+			Dexed::notesOff ();
+			break;
+
+		default:
+			assert (0);
+			break;
+		}
+	}
+
+	void KeyDown (int16_t pitch, uint8_t velo)
+	{
+		unsigned nLimit = m_nVoiceLimit;
+		if (   m_pVoicePool
+		    && !m_pVoicePool->CanAllocate (m_nTG))
+		{
+			unsigned nLive = CountLiveVoices ();
+			if (nLive < nLimit)
+			{
+				nLimit = nLive;
+			}
+		}
+
+		if (nLimit > 0)
+		{
+			LimitVoices (nLimit-1);			// make room for the new voice
+			Dexed::keydown (pitch, velo);
+			m_bActive = true;
+			m_nSilentChunks = 0;
+
+			unsigned nLive = CountLiveVoices ();
+			UpdateLiveVoices (nLive);
+
+			if (nLive >= max_notes)
+			{
+				m_bVoiceShortage = true;	// the next keydown steals
+			}
+		}
+	}
+
+	void UpdateActivity (const float32_t* buffer, uint16_t n_samples)
+	{
+		if (Dexed::getNumNotesPlaying () > 0)
+		{
+			m_nSilentChunks = 0;
+
+			return;
+		}
+
+		// no voice is playing, wait for the tail to decay
+		for (uint16_t i = 0; i < n_samples; i++)
+		{
+			if (   buffer[i] > SilenceThreshold
+			    || buffer[i] < -SilenceThreshold)
+			{
+				m_nSilentChunks = 0;
+
+				return;
+			}
+		}
+
+		if (++m_nSilentChunks >= SilentChunksIdle)
+		{
+			m_bActive = false;
+		}
+	}
+
+	void UpdateLiveVoices (unsigned nLive)
+	{
+		m_nLiveVoices = nLive;
+
+		if (m_pVoicePool)
+		{
+			m_pVoicePool->SetVoices (nLive, m_nTG);
+		}
+	}
+
+	// live voices, which are not fading out after being stolen
+	unsigned CountLiveVoices (void)
+	{
+		unsigned nLive = 0;
+		for (uint8_t i = 0; i < max_notes; i++)
+		{
+			if (   !voices[i].live
+			    || voices[i].keydown)
+			{
+				m_bFading[i] = false;		// ended or reused by keydown
+			}
+
+			if (   voices[i].live
+			    && !m_bFading[i])
+			{
+				nLive++;
+			}
+		}
+
+		return nLive;
+	}
+
+	// Stealing a voice shortens its release tail, which is cheaper than
+	// missing the deadline of the audio path. Fading voices do not count.
+	void LimitVoices (unsigned nLimit)
+	{
+		if (nLimit >= max_notes)
+		{
+			return;
+		}
+
+		unsigned nLive = CountLiveVoices ();
+		while (nLive > nLimit)
+		{
+			int nVoice = FindQuietestVoice (true);
+			if (nVoice < 0)
+			{
+				nVoice = FindQuietestVoice (false);
+				if (nVoice < 0)
+				{
+					break;
+				}
+			}
+
+			FadeOutVoice (nVoice);
+			nLive--;
+		}
+	}
+
+	// releases the voice with the fastest release rate of all operators,
+	// the voice is re-initialized with the real voice data on its next keydown
+	void FadeOutVoice (uint8_t nVoice)
+	{
+		uint8_t FastRelease[sizeof data];
+		memcpy (FastRelease, data, sizeof FastRelease);
+		for (unsigned op = 0; op < 6; op++)
+		{
+			FastRelease[DEXED_VOICE_OFFSET + op*21 + DEXED_OP_EG_R4] = 99;
+		}
+
+		ProcessorVoice &rVoice = voices[nVoice];
+		rVoice.dx7_note->update (FastRelease, rVoice.midi_note, rVoice.velocity, rVoice.porta, &controllers);
+		rVoice.dx7_note->keyup ();
+		rVoice.keydown = false;
+		rVoice.sustained = false;
+
+		m_bFading[nVoice] = true;
+	}
+
+	// returns the index of the live voice with the lowest carrier amplitude
+	// (< 0 if none), bReleasing: only voices with the key up and not sustained
+	int FindQuietestVoice (bool bReleasing)
+	{
+		uint8_t ucCarriers = controllers.core->get_carrier_operators (data[DEXED_VOICE_OFFSET + DEXED_ALGORITHM]);
+
+		int nQuietest = -1;
+		uint32_t nMinAmp = UINT32_MAX;
+		for (uint8_t i = 0; i < max_notes; i++)
+		{
+			if (   !voices[i].live
+			    || m_bFading[i]
+			    || (bReleasing && (voices[i].keydown || voices[i].sustained)))
+			{
+				continue;
+			}
+
+			VoiceStatus Status;
+			voices[i].dx7_note->peekVoiceStatus (Status);
+
+			uint32_t nAmp = 0;
+			for (unsigned op = 0; op < 6; op++)
+			{
+				if (ucCarriers & (1 << op))
+				{
+					nAmp += Status.amp[op];
+				}
+			}
+
+			if (nAmp < nMinAmp)
+			{
+				nMinAmp = nAmp;
+				nQuietest = i;
+			}
+		}
+
+		return nQuietest;
 	}
 
 private:
-	CSpinLock m_SpinLock;
+	CSpinLock m_ProducerLock;
+	CSPSCRing<TEvent, EventRingSize> m_EventRing;
+	CSPSCRing<TVoiceData, VoiceRingSize> m_VoiceRing;
+	TVoiceData m_VoiceData;				// producer, with all queued changes
+
+	unsigned m_nSampleRate;
+
+	volatile bool m_bActive;
+	unsigned m_nSilentChunks;
+
+	volatile uint8_t m_nVoiceLimit;		// UINT8_MAX: no limit
+	bool m_bFading[UINT8_MAX+1];		// stolen voice is fading out
+	volatile unsigned m_nLiveVoices;
+
+	CVoicePool *m_pVoicePool;
+	unsigned m_nTG;
+	volatile bool m_bVoiceShortage;
+
+	std::atomic<bool> m_bSuspended;			// setMaxNotes() is running
+	std::atomic<bool> m_bRendering;			// render core is in the TG
+
+	unsigned m_nDroppedEvents;
 };
 
 #endif
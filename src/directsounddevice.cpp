@@ -0,0 +1,123 @@
+//
+// directsounddevice.cpp
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2022  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "directsounddevice.h"
+#include <string.h>
+#include <assert.h>
+
+CDirectI2SSoundDevice::CDirectI2SSoundDevice (CInterruptSystem *pInterrupt, unsigned nSampleRate,
+					      unsigned nChunkSize, CI2CMaster *pI2CMaster,
+					      u8 ucI2CAddress, unsigned nChannels)
+:	CI2SSoundBaseDevice (pInterrupt, nSampleRate, nChunkSize, false,
+			     pI2CMaster, ucI2CAddress, DeviceModeTXOnly, nChannels),
+	m_nChannels (nChannels),
+	m_nBlockSize (nChunkSize),
+	m_nWriteCount (0),
+	m_nReadCount (0),
+	m_nReadOffset (0),
+	m_nUnderruns (0)
+{
+	assert (m_nChannels > 0);
+	assert (m_nBlockSize % m_nChannels == 0);
+
+	for (unsigned i = 0; i < Blocks; i++)
+	{
+		m_pBlock[i] = new s32[m_nBlockSize];
+		assert (m_pBlock[i]);
+
+		memset (m_pBlock[i], 0, m_nBlockSize * sizeof (s32));
+	}
+}
+
+CDirectI2SSoundDevice::~CDirectI2SSoundDevice (void)
+{
+	Cancel ();
+
+	for (unsigned i = 0; i < Blocks; i++)
+	{
+		delete [] m_pBlock[i];
+	}
+}
+
+s32 *CDirectI2SSoundDevice::GetWriteBlock (void)
+{
+	unsigned nWriteCount = m_nWriteCount.load (std::memory_order_relaxed);
+	if (nWriteCount - m_nReadCount.load (std::memory_order_acquire) >= Blocks)
+	{
+		return 0;
+	}
+
+	return m_pBlock[nWriteCount & (Blocks-1)];
+}
+
+void CDirectI2SSoundDevice::CommitWriteBlock (void)
+{
+	m_nWriteCount.fetch_add (1, std::memory_order_release);
+}
+
+unsigned CDirectI2SSoundDevice::GetBlockFrames (void) const
+{
+	return m_nBlockSize / m_nChannels;
+}
+
+unsigned CDirectI2SSoundDevice::GetUnderruns (void) const
+{
+	return m_nUnderruns.load (std::memory_order_relaxed);
+}
+
+unsigned CDirectI2SSoundDevice::GetChunk (u32 *pBuffer, unsigned nChunkSize)
+{
+	assert (pBuffer);
+
+	unsigned nResult = nChunkSize;
+
+	while (nChunkSize > 0)
+	{
+		unsigned nReadCount = m_nReadCount.load (std::memory_order_relaxed);
+		if (nReadCount == m_nWriteCount.load (std::memory_order_acquire))
+		{
+			// audio path too late, output silence
+			memset (pBuffer, 0, nChunkSize * sizeof (u32));
+			m_nUnderruns.fetch_add (1, std::memory_order_relaxed);
+
+			break;
+		}
+
+		const s32 *pBlock = m_pBlock[nReadCount & (Blocks-1)];
+
+		unsigned nCount = m_nBlockSize - m_nReadOffset;
+		if (nCount > nChunkSize)
+		{
+			nCount = nChunkSize;
+		}
+
+		memcpy (pBuffer, pBlock + m_nReadOffset, nCount * sizeof (u32));
+		pBuffer += nCount;
+		nChunkSize -= nCount;
+
+		m_nReadOffset += nCount;
+		if (m_nReadOffset == m_nBlockSize)
+		{
+			m_nReadOffset = 0;
+			m_nReadCount.store (nReadCount + 1, std::memory_order_release);
+		}
+	}
+
+	return nResult;
+}
@@ -0,0 +1,73 @@
+//
+// directsounddevice.h
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2022  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _directsounddevice_h
+#define _directsounddevice_h
+
+#include <circle/sound/i2ssoundbasedevice.h>
+#include <circle/interrupt.h>
+#include <circle/i2cmaster.h>
+#include <circle/types.h>
+#include <atomic>
+
+// I2S sound device without the sound queue of CSoundBaseDevice.
+//
+// The audio path writes the final Q23 samples directly into one of two
+// blocks of ChunkSize samples (the size of a DMA buffer), which GetChunk()
+// copies into the DMA buffer. This replaces Write(), which copies the data
+// into the queue first. As Q23 in 32 bits is the native format of the I2S
+// device, no conversion is needed.
+
+class CDirectI2SSoundDevice : public CI2SSoundBaseDevice
+{
+public:
+	static const unsigned Blocks = 2;	// power of 2
+
+public:
+	CDirectI2SSoundDevice (CInterruptSystem *pInterrupt, unsigned nSampleRate,
+			       unsigned nChunkSize, CI2CMaster *pI2CMaster, u8 ucI2CAddress,
+			       unsigned nChannels);
+	~CDirectI2SSoundDevice (void);
+
+	// returns 0 if no block is free, same block until CommitWriteBlock()
+	s32 *GetWriteBlock (void);
+	void CommitWriteBlock (void);
+
+	unsigned GetBlockFrames (void) const;
+
+	unsigned GetUnderruns (void) const;
+
+protected:
+	// called from the DMA interrupt handler
+	unsigned GetChunk (u32 *pBuffer, unsigned nChunkSize) override;
+
+private:
+	unsigned m_nChannels;
+	unsigned m_nBlockSize;				// samples (all channels)
+
+	s32 *m_pBlock[Blocks];
+
+	std::atomic<unsigned> m_nWriteCount;		// blocks committed
+	std::atomic<unsigned> m_nReadCount;		// blocks consumed
+	unsigned m_nReadOffset;				// samples in current read block
+
+	std::atomic<unsigned> m_nUnderruns;
+};
+
+#endif
@@ -7,6 +7,9 @@
 #include <cstdint>
 #include <assert.h>
 #include "arm_math.h"
+#if !defined(ARM_MATH_NEON) && defined(__SSE__)
+#include <xmmintrin.h>
+#endif
 
 #define UNITY_GAIN 1.0f
 #define MAX_GAIN 1.0f
@@ -15,95 +18,42 @@
 #define MAX_PANORAMA 1.0f
 #define MIN_PANORAMA 0.0f
 
-template <int NN> class AudioMixer
+// Stereo mixer with a post-pan send bus (e.g. for the reverb). doMix() reads
+// each input buffer only once and accumulates the dry and the send bus in
+// registers, instead of separate scale/add passes for each bus.
+template <int NN> class AudioStereoSendMixer
 {
 public:
-	AudioMixer(uint16_t len)
+	AudioStereoSendMixer(uint16_t len)
 	{
 		buffer_length=len;
 		for (uint8_t i=0; i<NN; i++)
+		{
 			multiplier[i] = UNITY_GAIN;
-
-		sumbufL=new float32_t[buffer_length];
-		arm_fill_f32(0.0f, sumbufL, len);
-	}
-
-	~AudioMixer()
-	{
-		delete [] sumbufL;
-	}
-
-        void doAddMix(uint8_t channel, float32_t* in)
-	{
-		float32_t tmp[buffer_length];
-
-		assert(in);
-
-		if(multiplier[channel]!=UNITY_GAIN)
-			arm_scale_f32(in,multiplier[channel],tmp,buffer_length);
-		arm_add_f32(sumbufL, tmp, sumbufL, buffer_length);
+			send_multiplier[i] = MIN_GAIN;
+			panorama[i][0] = UNITY_PANORAMA;
+			panorama[i][1] = UNITY_PANORAMA;
+			update_coefficients(i);
+		}
 	}
 
 	void gain(uint8_t channel, float32_t gain)
 	{
 		if (channel >= NN) return;
 
-		if (gain > MAX_GAIN)
-			gain = MAX_GAIN;
-		else if (gain < MIN_GAIN)
-			gain = MIN_GAIN;
-		multiplier[channel] = powf(gain, 4); // see: https://www.dr-lex.be/info-stuff/volumecontrols.html#ideal2
-	}
-
-	void gain(float32_t gain)
-	{
-		for (uint8_t i = 0; i < NN; i++)
-		{
-			if (gain > MAX_GAIN)
-				gain = MAX_GAIN;
-			else if (gain < MIN_GAIN)
-				gain = MIN_GAIN;
-			multiplier[i] = powf(gain, 4); // see: https://www.dr-lex.be/info-stuff/volumecontrols.html#ideal2
-		} 
-	}
-
-	void getMix(float32_t* buffer)
-	{
-		assert(buffer);
-		assert(sumbufL);
-		arm_copy_f32(sumbufL, buffer, buffer_length);
-
-		if(sumbufL)
-			arm_fill_f32(0.0f, sumbufL, buffer_length);
+		multiplier[channel] = gain_to_multiplier(gain);
+		update_coefficients(channel);
 	}
 
-protected:
-	float32_t multiplier[NN];
-	float32_t* sumbufL;
-	uint16_t buffer_length;
-};
-
-template <int NN> class AudioStereoMixer : public AudioMixer<NN>
-{
-public:
-	AudioStereoMixer(uint16_t len) : AudioMixer<NN>(len)
+	void send(uint8_t channel, float32_t gain)
 	{
-		for (uint8_t i=0; i<NN; i++)
-		{
-			panorama[i][0] = UNITY_PANORAMA;
-			panorama[i][1] = UNITY_PANORAMA;
-		}
-
-		sumbufR=new float32_t[buffer_length];
-		arm_fill_f32(0.0f, sumbufR, buffer_length);
-	}
+		if (channel >= NN) return;
 
-	~AudioStereoMixer()
-	{
-		delete [] sumbufR;
+		send_multiplier[channel] = gain_to_multiplier(gain);
+		update_coefficients(channel);
 	}
 
-        void pan(uint8_t channel, float32_t pan)
+	void pan(uint8_t channel, float32_t pan)
 	{
 		if (channel >= NN) return;
 
@@ -115,65 +65,144 @@ public:
 		// From: https://stackoverflow.com/questions/67062207/how-to-pan-audio-sample-data-naturally
 		panorama[channel][0]=arm_sin_f32(mapfloat(pan, MIN_PANORAMA, MAX_PANORAMA, 0.0, M_PI/2.0));
 		panorama[channel][1]=arm_cos_f32(mapfloat(pan, MIN_PANORAMA, MAX_PANORAMA, 0.0, M_PI/2.0));
+		update_coefficients(channel);
+	}
+
+	// in[channel] == nullptr skips the channel (silent input).
+	// sendL/sendR == nullptr skips the send bus.
+	// len (frames) must not exceed the length given to the constructor.
+	void doMix(float32_t* const in[NN], float32_t* dryL, float32_t* dryR,
+		   float32_t* sendL, float32_t* sendR, uint16_t len)
+	{
+		assert(dryL);
+		assert(dryR);
+		assert(len <= buffer_length);
+
+		const float32_t* inputs[NN];
+		float32_t coefficients[NN][4];
+		unsigned count = 0;
+		for (uint8_t i=0; i<NN; i++)
+		{
+			if (in[i])
+			{
+				inputs[count] = in[i];
+				for (unsigned j=0; j<4; j++)
+					coefficients[count][j] = coefficient[i][j];
+				count++;
+			}
+		}
+
+		if (sendL && sendR)
+			mix<true>(inputs, coefficients, count, dryL, dryR, sendL, sendR, len);
+		else
+			mix<false>(inputs, coefficients, count, dryL, dryR, sendL, sendR, len);
 	}
 
-	void doAddMix(uint8_t channel, float32_t* in)
+private:
+	static float32_t gain_to_multiplier(float32_t gain)
 	{
-		float32_t tmp[buffer_length];
-
-		assert(in);
-
-		// left
-		arm_scale_f32(in, panorama[channel][0], tmp, buffer_length);
-		if(multiplier[channel]!=UNITY_GAIN)
-			arm_scale_f32(tmp,multiplier[channel],tmp,buffer_length);
-		arm_add_f32(sumbufL, tmp, sumbufL, buffer_length);
-		// right
-		arm_scale_f32(in, panorama[channel][1], tmp, buffer_length);
-		if(multiplier[channel]!=UNITY_GAIN)
-			arm_scale_f32(tmp,multiplier[channel],tmp,buffer_length);
-		arm_add_f32(sumbufR, tmp, sumbufR, buffer_length);
+		if (gain > MAX_GAIN)
+			gain = MAX_GAIN;
+		else if (gain < MIN_GAIN)
+			gain = MIN_GAIN;
+		return powf(gain, 4); // see: https://www.dr-lex.be/info-stuff/volumecontrols.html#ideal2
 	}
 
-	void doAddMix(uint8_t channel, float32_t* inL, float32_t* inR)
+	void update_coefficients(uint8_t channel)
 	{
-		float32_t tmp[buffer_length];
-
-		assert(inL);
-		assert(inR);
-
-		// left
-		if(multiplier[channel]!=UNITY_GAIN)
-			arm_scale_f32(inL,multiplier[channel],tmp,buffer_length);
-		arm_add_f32(sumbufL, tmp, sumbufL, buffer_length);
-		// right
-		if(multiplier[channel]!=UNITY_GAIN)
-			arm_scale_f32(inR,multiplier[channel],tmp,buffer_length);
-		arm_add_f32(sumbufR, tmp, sumbufR, buffer_length);
+		float32_t c[4];
+		c[0] = panorama[channel][0] * multiplier[channel];
+		c[1] = panorama[channel][1] * multiplier[channel];
+		c[2] = panorama[channel][0] * send_multiplier[channel];
+		c[3] = panorama[channel][1] * send_multiplier[channel];
+		for (unsigned j=0; j<4; j++)
+			coefficient[channel][j] = c[j];
 	}
 
-	void getMix(float32_t* bufferL, float32_t* bufferR)
+	template <bool with_send>
+	void mix(const float32_t* const inputs[], const float32_t coefficients[][4], unsigned count,
+		 float32_t* dryL, float32_t* dryR, float32_t* sendL, float32_t* sendR, unsigned len)
 	{
-		assert(bufferR);
-		assert(bufferL);
-		assert(sumbufL);
-		assert(sumbufR);
-
-		arm_copy_f32 (sumbufL, bufferL, buffer_length);
-		arm_copy_f32 (sumbufR, bufferR, buffer_length);
-
-		if(sumbufL)
-			arm_fill_f32(0.0f, sumbufL, buffer_length);
-		if(sumbufR)
-			arm_fill_f32(0.0f, sumbufR, buffer_length);
+		unsigned n = 0;
+
+#if defined(ARM_MATH_NEON)
+		for (; n + 4 <= len; n += 4)
+		{
+			float32x4_t dl = vdupq_n_f32(0.0f), dr = dl, sl = dl, sr = dl;
+			for (unsigned i=0; i<count; i++)
+			{
+				float32x4_t x = vld1q_f32(inputs[i] + n);
+				dl = vmlaq_n_f32(dl, x, coefficients[i][0]);
+				dr = vmlaq_n_f32(dr, x, coefficients[i][1]);
+				if (with_send)
+				{
+					sl = vmlaq_n_f32(sl, x, coefficients[i][2]);
+					sr = vmlaq_n_f32(sr, x, coefficients[i][3]);
+				}
+			}
+			vst1q_f32(dryL + n, dl);
+			vst1q_f32(dryR + n, dr);
+			if (with_send)
+			{
+				vst1q_f32(sendL + n, sl);
+				vst1q_f32(sendR + n, sr);
+			}
+		}
+#elif defined(__SSE__)
+		for (; n + 4 <= len; n += 4)
+		{
+			__m128 dl = _mm_setzero_ps(), dr = dl, sl = dl, sr = dl;
+			for (unsigned i=0; i<count; i++)
+			{
+				__m128 x = _mm_loadu_ps(inputs[i] + n);
+				dl = _mm_add_ps(dl, _mm_mul_ps(x, _mm_set1_ps(coefficients[i][0])));
+				dr = _mm_add_ps(dr, _mm_mul_ps(x, _mm_set1_ps(coefficients[i][1])));
+				if (with_send)
+				{
+					sl = _mm_add_ps(sl, _mm_mul_ps(x, _mm_set1_ps(coefficients[i][2])));
+					sr = _mm_add_ps(sr, _mm_mul_ps(x, _mm_set1_ps(coefficients[i][3])));
+				}
+			}
+			_mm_storeu_ps(dryL + n, dl);
+			_mm_storeu_ps(dryR + n, dr);
+			if (with_send)
+			{
+				_mm_storeu_ps(sendL + n, sl);
+				_mm_storeu_ps(sendR + n, sr);
+			}
+		}
+#endif
+
+		for (; n < len; n++)
+		{
+			float32_t dl = 0.0f, dr = 0.0f, sl = 0.0f, sr = 0.0f;
+			for (unsigned i=0; i<count; i++)
+			{
+				float32_t x = inputs[i][n];
+				dl += x * coefficients[i][0];
+				dr += x * coefficients[i][1];
+				if (with_send)
+				{
+					sl += x * coefficients[i][2];
+					sr += x * coefficients[i][3];
+				}
+			}
+			dryL[n] = dl;
+			dryR[n] = dr;
+			if (with_send)
+			{
+				sendL[n] = sl;
+				sendR[n] = sr;
+			}
+		}
 	}
 
-protected:
-	using AudioMixer<NN>::sumbufL;
-	using AudioMixer<NN>::multiplier;
-	using AudioMixer<NN>::buffer_length;
+private:
+	float32_t multiplier[NN];
+	float32_t send_multiplier[NN];
 	float32_t panorama[NN][2];
-	float32_t* sumbufR;
+	float32_t coefficient[NN][4];	// dry L/R, send L/R
+	uint16_t buffer_length;
 };
 
 #endif
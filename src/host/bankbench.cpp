@@ -0,0 +1,324 @@
+//
+// bankbench.cpp
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2024  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+// Benchmark for the voice bank registry on a Linux host. Registers a number
+// of randomly numbered banks, once in fixed arrays over all bank IDs (as the
+// loader did before) and once in the sparse registry. Checks, that both give
+// the same results for lookups and for stepping up and down through the
+// banks, and reports the time per operation and the memory used.
+//
+
+#include "../bankregistry.h"
+#include <chrono>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static const unsigned MaxBankID = 16383;
+static const unsigned SparseBanks = 50;
+
+struct TBank
+{
+	unsigned nBankID;
+};
+
+// The previous implementation: one pointer and one file name per bank ID
+class CDenseBanks
+{
+public:
+	CDenseBanks (void)
+	:	m_nHighest (0)
+	{
+		for (unsigned i = 0; i <= MaxBankID; i++)
+		{
+			m_pBank[i] = nullptr;
+		}
+	}
+
+	void Add (unsigned nBankID, TBank *pBank)
+	{
+		m_pBank[nBankID] = pBank;
+		m_FileName[nBankID] = "bank.syx";
+
+		if (nBankID > m_nHighest)
+		{
+			m_nHighest = nBankID;
+		}
+	}
+
+	bool IsValid (unsigned nBankID) const
+	{
+		return m_pBank[nBankID] != nullptr;
+	}
+
+	unsigned GetNext (unsigned nBankID) const
+	{
+		for (unsigned id = nBankID+1; id <= m_nHighest; id++)
+		{
+			if (IsValid (id))
+			{
+				return id;
+			}
+		}
+
+		for (unsigned id = 0; id < nBankID; id++)
+		{
+			if (IsValid (id))
+			{
+				return id;
+			}
+		}
+
+		return nBankID;
+	}
+
+	unsigned GetPrevious (unsigned nBankID) const
+	{
+		for (int id = (int) nBankID-1; id >= 0; id--)
+		{
+			if (IsValid (id))
+			{
+				return id;
+			}
+		}
+
+		for (unsigned id = m_nHighest; id > nBankID; id--)
+		{
+			if (IsValid (id))
+			{
+				return id;
+			}
+		}
+
+		return nBankID;
+	}
+
+	size_t GetMemory (void) const
+	{
+		return sizeof *this;
+	}
+
+private:
+	TBank *m_pBank[MaxBankID+1];
+	std::string m_FileName[MaxBankID+1];
+	unsigned m_nHighest;
+};
+
+typedef CBankRegistry<TBank *, MaxBankID> CSparseBanks;
+
+static unsigned s_nRandom = 1;
+
+static unsigned Random (unsigned nRange)
+{
+	s_nRandom = s_nRandom * 1103515245 + 12345;
+
+	return (s_nRandom >> 8) % nRange;
+}
+
+template <typename TFunction>
+static double Measure (unsigned nOperations, TFunction Function)
+{
+	auto StartTime = std::chrono::steady_clock::now ();
+
+	Function ();
+
+	auto Duration = std::chrono::steady_clock::now () - StartTime;
+
+	return std::chrono::duration<double, std::nano> (Duration).count () / nOperations;
+}
+
+static void Usage (const char *pProgram)
+{
+	fprintf (stderr, "Usage: %s [options]\n\n"
+		 "  -b NUM   number of banks (default: 10000, %u banks are measured too)\n"
+		 "  -n NUM   number of operations (default: 1000000)\n",
+		 pProgram, SparseBanks);
+}
+
+// returns false, if the results differ
+static bool RunBenchmark (unsigned nBanks, unsigned nOperations)
+{
+	// random distinct bank IDs in random order, as the directory lists them
+	std::vector<unsigned> BankIDs (MaxBankID+1);
+	for (unsigned i = 0; i <= MaxBankID; i++)
+	{
+		BankIDs[i] = i;
+	}
+	for (unsigned i = MaxBankID; i > 0; i--)
+	{
+		std::swap (BankIDs[i], BankIDs[Random (i+1)]);
+	}
+	BankIDs.resize (nBanks);
+
+	std::vector<TBank> Banks (nBanks);
+
+	CDenseBanks *pDense = new CDenseBanks;
+	CSparseBanks *pSparse = new CSparseBanks;
+
+	auto StartTime = std::chrono::steady_clock::now ();
+	for (unsigned i = 0; i < nBanks; i++)
+	{
+		Banks[i].nBankID = BankIDs[i];
+		pSparse->Add (BankIDs[i], &Banks[i]);
+	}
+	pSparse->Finish ();
+	auto BuildDuration = std::chrono::steady_clock::now () - StartTime;
+
+	for (unsigned i = 0; i < nBanks; i++)
+	{
+		pDense->Add (BankIDs[i], &Banks[i]);
+	}
+
+	std::vector<unsigned> Queries (nOperations);
+	for (unsigned &rQuery : Queries)
+	{
+		rQuery = Random (MaxBankID+1);
+	}
+
+	unsigned nMismatches = 0;
+	unsigned nDenseSum = 0;
+	unsigned nSparseSum = 0;
+
+	double fDenseFind = Measure (nOperations, [&] {
+		for (unsigned nQuery : Queries)	nDenseSum += pDense->IsValid (nQuery);
+	});
+	double fSparseFind = Measure (nOperations, [&] {
+		for (unsigned nQuery : Queries)	nSparseSum += pSparse->Find (nQuery) != nullptr;
+	});
+	nMismatches += nDenseSum != nSparseSum;
+
+	// stepping from random banks, as after a bank select
+	double fDenseJump = Measure (nOperations, [&] {
+		for (unsigned nQuery : Queries)	nDenseSum += pDense->GetNext (nQuery) + pDense->GetPrevious (nQuery);
+	});
+	double fSparseJump = Measure (nOperations, [&] {
+		for (unsigned nQuery : Queries)	nSparseSum += pSparse->GetNext (nQuery) + pSparse->GetPrevious (nQuery);
+	});
+	nMismatches += nDenseSum != nSparseSum;
+
+	// stepping from a bank, which has been looked up before
+	double fDenseFindStep = Measure (nOperations, [&] {
+		for (unsigned nQuery : Queries)
+		{
+			nDenseSum += pDense->IsValid (nQuery);
+			nDenseSum += pDense->GetNext (nQuery) + pDense->GetPrevious (nQuery);
+		}
+	});
+	double fSparseFindStep = Measure (nOperations, [&] {
+		for (unsigned nQuery : Queries)
+		{
+			nSparseSum += pSparse->Find (nQuery) != nullptr;
+			nSparseSum += pSparse->GetNext (nQuery) + pSparse->GetPrevious (nQuery);
+		}
+	});
+	nMismatches += nDenseSum != nSparseSum;
+
+	// stepping through all banks, as in the menu
+	unsigned nDenseBank = 0;
+	double fDenseStep = Measure (nOperations, [&] {
+		for (unsigned i = 0; i < nOperations; i++)
+		{
+			nDenseBank = i & 1024 ? pDense->GetPrevious (nDenseBank) : pDense->GetNext (nDenseBank);
+			nDenseSum += nDenseBank;
+		}
+	});
+	unsigned nSparseBank = 0;
+	double fSparseStep = Measure (nOperations, [&] {
+		for (unsigned i = 0; i < nOperations; i++)
+		{
+			nSparseBank = i & 1024 ? pSparse->GetPrevious (nSparseBank) : pSparse->GetNext (nSparseBank);
+			nSparseSum += nSparseBank;
+		}
+	});
+	nMismatches += nDenseSum != nSparseSum;
+
+	size_t nSparseMemory = sizeof *pSparse + pSparse->GetMemory ();
+
+	printf ("%u banks, %u operations\n\n", nBanks, nOperations);
+	printf ("                 Arrays   Registry\n");
+	printf ("Memory         %6zu KB  %6zu KB\n", pDense->GetMemory () / 1024, (nSparseMemory + 1023) / 1024);
+	printf ("Build                    %6.1f us\n",
+		std::chrono::duration<double, std::micro> (BuildDuration).count ());
+	printf ("Find           %6.1f ns  %6.1f ns\n", fDenseFind, fSparseFind);
+	printf ("Jump and step  %6.1f ns  %6.1f ns\n", fDenseJump, fSparseJump);
+	printf ("Find and step  %6.1f ns  %6.1f ns\n", fDenseFindStep, fSparseFindStep);
+	printf ("Step           %6.1f ns  %6.1f ns\n", fDenseStep, fSparseStep);
+
+	delete pDense;
+	delete pSparse;
+
+	if (nMismatches > 0)
+	{
+		printf ("\nResults differ\n");
+
+		return false;
+	}
+
+	return true;
+}
+
+int main (int argc, char **argv)
+{
+	unsigned nBanks = 10000;
+	unsigned nOperations = 1000000;
+
+	int nOption;
+	while ((nOption = getopt (argc, argv, "b:n:h")) != -1)
+	{
+		switch (nOption)
+		{
+		case 'b':	nBanks = atoi (optarg);		break;
+		case 'n':	nOperations = atoi (optarg);	break;
+
+		default:
+			Usage (argv[0]);
+			return 1;
+		}
+	}
+
+	if (nBanks == 0 || nBanks > MaxBankID+1 || nOperations == 0)
+	{
+		Usage (argv[0]);
+		return 1;
+	}
+
+	// a few banks only, as on most SD cards
+	for (unsigned nRun : {nBanks, SparseBanks})
+	{
+		if (nRun != nBanks)
+		{
+			if (nBanks == SparseBanks)
+			{
+				break;
+			}
+
+			printf ("\n");
+		}
+
+		if (!RunBenchmark (nRun, nOperations))
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
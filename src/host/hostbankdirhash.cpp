@@ -0,0 +1,82 @@
+//
+// hostbankdirhash.cpp
+//
+// Host build replacement for bankdirhash.cpp, which uses FatFs. The POSIX
+// directory entries do not have the size and the time of a file, so they
+// are taken with stat().
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2024  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "bankdirhash.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <strings.h>
+#include <assert.h>
+
+bool HashBankDirectory (const std::string &rDirName, unsigned nSubDirs, uint32_t *pHash)
+{
+	assert (pHash);
+
+	DIR *pDirectory = opendir (rDirName.c_str ());
+	if (!pDirectory)
+	{
+		return false;
+	}
+
+	bool bResult = true;
+
+	HashBytes (pHash, rDirName.c_str (), rDirName.length () + 1);
+
+	dirent *pEntry;
+	while ((pEntry = readdir (pDirectory)) != nullptr)
+	{
+		const char *pName = pEntry->d_name;
+		size_t nLen = strlen (pName);
+
+		std::string Path = rDirName + "/" + pName;
+		struct stat Status;
+		if (   strcmp (pName, ".") == 0
+		    || strcmp (pName, "..") == 0
+		    || stat (Path.c_str (), &Status) != 0)
+		{
+			continue;
+		}
+
+		if (S_ISDIR (Status.st_mode))
+		{
+			if (   nSubDirs > 0
+			    && !HashBankDirectory (Path, nSubDirs-1, pHash))
+			{
+				bResult = false;
+				break;
+			}
+		}
+		else if (   nLen >= 5
+			 && strcasecmp (&pName[nLen-4], ".syx") == 0)
+		{
+			HashBytes (pHash, pName, nLen + 1);
+
+			uint32_t Values[2] = {(uint32_t) Status.st_size, (uint32_t) Status.st_mtime};
+			HashBytes (pHash, Values, sizeof Values);
+		}
+	}
+
+	closedir (pDirectory);
+
+	return bResult;
+}
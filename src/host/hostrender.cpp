@@ -0,0 +1,764 @@
+//
+// hostrender.cpp
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2022  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+// Offline renderer for the MiniDexed audio path on a Linux host. Renders a
+// MIDI file with the tone generators, mixers and reverb of a performance
+// into a WAV file as fast as possible and reports the time spent per chunk
+// in each stage of the audio path.
+//
+// The TGs (CDexedAdapter) and the stages after them (MixStereo()) are the
+// code of the Pi. The performance file and the MIDI messages are handled by
+// a reduced copy of CMiniDexed, and the TGs are rendered on one thread. The
+// numbers show the cost of the DSP code, not the timing of the Pi, where
+// idle TGs are skipped, the TGs run on three cores and the voice pool and the
+// polyphony governor may limit the voices.
+//
+#include "hostsounddevice.h"
+#include "midifile.h"
+#include <circle/logger.h>
+#include <circle/timer.h>
+#include <arm_math.h>
+#include "../common.h"
+#include "../dexedadapter.h"
+#include "../audiomixpath.h"
+#include "../sysexfileloader.h"
+#include "../arm_float_to_q23.h"
+#include "../midi.h"
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+
+LOGMODULE ("hostrender");
+
+class COfflineRenderer
+{
+public:
+	static const unsigned MaxToneGenerators = 16;
+	static const unsigned Disabled = 0xFF;
+	static const unsigned OmniMode = 16;
+
+	enum TStage
+	{
+		StageRender,
+		StageMix,
+		StageReverb,
+		StageOutput,
+		StageWrite,
+		StageUnknown
+	};
+
+public:
+	COfflineRenderer (unsigned nSampleRate, unsigned nChunkSize,
+			  unsigned nToneGenerators, unsigned nPolyphony, unsigned nMasterVolume);
+	~COfflineRenderer (void);
+
+	bool LoadPerformance (const char *pFileName, CSysExFileLoader *pSysExFileLoader);
+
+	void MIDIMessage (const u8 *pMessage, unsigned nLength);
+
+	void RenderChunk (CHostSoundDevice *pSoundDevice, unsigned nStartTicks);	// of the first frame
+
+	unsigned GetFramesPerChunk (void) const	{ return m_nFrames; }
+
+	void DumpProfile (void) const;
+
+private:
+	void SetVolume (unsigned nTG);
+	void SetPan (unsigned nPan, unsigned nTG);
+	void SetReverbSend (unsigned nReverbSend, unsigned nTG);
+	int ApplyNoteLimits (int nPitch, unsigned nTG) const;
+
+	void StageStart (void);
+	void StageStop (TStage Stage);
+	void StageStop (TStage Stage, unsigned nTG);
+	static void MixStageHandler (TMixStage Stage, bool bStart, void *pParam);
+
+private:
+	unsigned m_nSampleRate;
+	unsigned m_nFrames;
+	unsigned m_nToneGenerators;
+	float32_t m_fMasterVolume;
+
+	CDexedAdapter *m_pTG[MaxToneGenerators];
+	unsigned m_nMIDIChannel[MaxToneGenerators];
+	unsigned m_nVolume[MaxToneGenerators];
+	unsigned m_nExpression[MaxToneGenerators];
+	unsigned m_nNoteLimitLow[MaxToneGenerators];
+	unsigned m_nNoteLimitHigh[MaxToneGenerators];
+	int m_nNoteShift[MaxToneGenerators];
+	bool m_bRendered[MaxToneGenerators];
+	std::vector<float32_t> m_OutputLevel[MaxToneGenerators];
+
+	AudioStereoSendMixer<MaxToneGenerators> *m_pTGMixer;
+	AudioEffectPlateReverb *m_pReverb;
+	bool m_bReverbEnable;
+	CSpinLock m_ReverbSpinLock;
+
+	std::vector<float32_t> m_SampleBuffer[2];
+	std::vector<float32_t> m_ReverbBuffer[2];
+	std::vector<float32_t> m_ReverbSendBuffer[2];
+	std::vector<int32_t> m_OutputInt;
+
+	// profiling
+	std::chrono::steady_clock::time_point m_StageStart;
+	unsigned m_nChunkNanos;
+	unsigned m_nChunks;
+	unsigned m_nDeadlineMisses;
+	unsigned long long m_nTotalNanos[StageUnknown];
+	unsigned m_nMaximumNanos[StageUnknown];
+	unsigned long long m_nTGTotalNanos[MaxToneGenerators];
+	unsigned m_nMaximumChunkNanos;
+};
+
+COfflineRenderer::COfflineRenderer (unsigned nSampleRate, unsigned nChunkSize,
+				    unsigned nToneGenerators, unsigned nPolyphony, unsigned nMasterVolume)
+:	m_nSampleRate (nSampleRate),
+	m_nFrames (nChunkSize / 2),		// stereo, as on the Pi
+	m_nToneGenerators (nToneGenerators),
+	m_bReverbEnable (true),
+	m_nChunkNanos (0),
+	m_nChunks (0),
+	m_nDeadlineMisses (0),
+	m_nMaximumChunkNanos (0)
+{
+	assert (m_nToneGenerators <= MaxToneGenerators);
+
+	float32_t fVolume = nMasterVolume / 127.0f;
+	m_fMasterVolume = fVolume * fVolume;		// same scaling as CMiniDexed::setMasterVolume()
+
+	for (unsigned nTG = 0; nTG < MaxToneGenerators; nTG++)
+	{
+		m_pTG[nTG] = 0;
+		m_nMIDIChannel[nTG] = nTG == 0 ? OmniMode : Disabled;
+		m_nVolume[nTG] = 100;
+		m_nExpression[nTG] = 127;
+		m_nNoteLimitLow[nTG] = 0;
+		m_nNoteLimitHigh[nTG] = 127;
+		m_nNoteShift[nTG] = 0;
+		m_bRendered[nTG] = false;
+		m_nTGTotalNanos[nTG] = 0;
+	}
+
+	m_pTGMixer = new AudioStereoSendMixer<MaxToneGenerators> (m_nFrames);
+
+	for (unsigned nTG = 0; nTG < m_nToneGenerators; nTG++)
+	{
+		m_pTG[nTG] = new CDexedAdapter (nPolyphony, nSampleRate);
+		assert (m_pTG[nTG]);
+
+		m_pTG[nTG]->activate ();
+		m_pTG[nTG]->setTranspose (24);
+		m_pTG[nTG]->setPBController (2, 0);
+		m_pTG[nTG]->setMWController (99, 1, 0);
+		m_pTG[nTG]->setFCController (99, 1, 0);
+		m_pTG[nTG]->setBCController (99, 1, 0);
+		m_pTG[nTG]->setATController (99, 1, 0);
+		m_pTG[nTG]->setCompressor (true);
+		SetVolume (nTG);
+
+		m_OutputLevel[nTG].assign (m_nFrames, 0.0f);
+
+		SetPan (64, nTG);
+		m_pTGMixer->gain (nTG, 1.0f);
+		SetReverbSend (0, nTG);
+	}
+
+	m_pReverb = new AudioEffectPlateReverb (nSampleRate);
+	m_pReverb->size (70 / 99.0f);
+	m_pReverb->hidamp (50 / 99.0f);
+	m_pReverb->lodamp (50 / 99.0f);
+	m_pReverb->lowpass (30 / 99.0f);
+	m_pReverb->diffusion (65 / 99.0f);
+	m_pReverb->level (99 / 99.0f);
+
+	for (unsigned i = 0; i < 2; i++)
+	{
+		m_SampleBuffer[i].resize (m_nFrames);
+		m_ReverbBuffer[i].resize (m_nFrames);
+		m_ReverbSendBuffer[i].resize (m_nFrames);
+	}
+	m_OutputInt.resize (m_nFrames * 2);
+
+	for (unsigned i = 0; i < StageUnknown; i++)
+	{
+		m_nTotalNanos[i] = 0;
+		m_nMaximumNanos[i] = 0;
+	}
+}
+
+COfflineRenderer::~COfflineRenderer (void)
+{
+	for (unsigned nTG = 0; nTG < m_nToneGenerators; nTG++)
+	{
+		delete m_pTG[nTG];
+	}
+
+	delete m_pTGMixer;
+	delete m_pReverb;
+}
+
+bool COfflineRenderer::LoadPerformance (const char *pFileName, CSysExFileLoader *pSysExFileLoader)
+{
+	assert (pSysExFileLoader);
+
+	FILE *pFile = fopen (pFileName, "r");
+	if (!pFile)
+	{
+		LOGERR ("%s: Cannot open", pFileName);
+
+		return false;
+	}
+
+	std::map<std::string, std::string> Properties;
+
+	char Line[1024];
+	while (fgets (Line, sizeof Line, pFile))
+	{
+		std::string Text (Line);
+		size_t nStart = Text.find_first_not_of (" \t\r\n");
+		if (   nStart == std::string::npos
+		    || Text[nStart] == '#')
+		{
+			continue;
+		}
+
+		size_t nEqual = Text.find ('=');
+		if (nEqual == std::string::npos)
+		{
+			continue;
+		}
+
+		std::string Name = Text.substr (nStart, nEqual - nStart);
+		Name.erase (Name.find_last_not_of (" \t") + 1);
+		std::string Value = Text.substr (nEqual + 1);
+		Value.erase (Value.find_last_not_of (" \t\r\n") + 1);
+
+		Properties[Name] = Value;
+	}
+
+	fclose (pFile);
+
+	auto GetNumber = [&] (const char *pName, unsigned nTG, int nDefault) -> int
+	{
+		char Name[64];
+		snprintf (Name, sizeof Name, "%s%u", pName, nTG+1);
+		if (nTG == MaxToneGenerators)
+		{
+			strcpy (Name, pName);
+		}
+
+		auto Iterator = Properties.find (Name);
+		if (   Iterator == Properties.end ()
+		    || Iterator->second.empty ())
+		{
+			return nDefault;
+		}
+
+		return strtol (Iterator->second.c_str (), 0, 0);
+	};
+
+	for (unsigned nTG = 0; nTG < m_nToneGenerators; nTG++)
+	{
+		CDexedAdapter *pTG = m_pTG[nTG];
+		assert (pTG);
+
+		unsigned nVoice = GetNumber ("VoiceNumber", nTG, 1);
+		uint8_t Voice[CSysExFileLoader::SizeSingleVoice];
+		pSysExFileLoader->GetVoice (GetNumber ("BankNumber", nTG, 0),
+					    nVoice > 0 ? nVoice-1 : 0, Voice);
+
+		char Name[32];
+		snprintf (Name, sizeof Name, "VoiceData%u", nTG+1);
+		const std::string &VoiceData = Properties[Name];
+		if (VoiceData.length () >= CSysExFileLoader::SizeSingleVoice*3 - 1)
+		{
+			for (unsigned i = 0; i < CSysExFileLoader::SizeSingleVoice; i++)
+			{
+				Voice[i] = strtoul (VoiceData.substr (i*3, 2).c_str (), 0, 16);
+			}
+		}
+
+		pTG->loadVoiceParameters (Voice);
+
+		unsigned nMIDIChannel = GetNumber ("MIDIChannel", nTG, 0);
+		m_nMIDIChannel[nTG] =   nMIDIChannel == 0 ? Disabled
+				      : nMIDIChannel <= 16 ? nMIDIChannel-1 : OmniMode;
+
+		m_nVolume[nTG] = constrain (GetNumber ("Volume", nTG, 100), 0, 127);
+		SetVolume (nTG);
+		SetPan (constrain (GetNumber ("Pan", nTG, 64), 0, 127), nTG);
+		pTG->setMasterTune ((int8_t) constrain (GetNumber ("Detune", nTG, 0), -99, 99));
+		pTG->setFilterCutoff (mapfloat (constrain (GetNumber ("Cutoff", nTG, 99), 0, 99), 0, 99, 0.0f, 1.0f));
+		pTG->setFilterResonance (mapfloat (constrain (GetNumber ("Resonance", nTG, 0), 0, 99), 0, 99, 0.0f, 1.0f));
+		m_nNoteLimitLow[nTG] = GetNumber ("NoteLimitLow", nTG, 0);
+		m_nNoteLimitHigh[nTG] = GetNumber ("NoteLimitHigh", nTG, 127);
+		m_nNoteShift[nTG] = GetNumber ("NoteShift", nTG, 0);
+		SetReverbSend (constrain (GetNumber ("ReverbSend", nTG, 50), 0, 99), nTG);
+		pTG->setPitchbendRange (constrain (GetNumber ("PitchBendRange", nTG, 2), 0, 12));
+		pTG->setPitchbendStep (constrain (GetNumber ("PitchBendStep", nTG, 0), 0, 12));
+		pTG->setPortamentoMode (constrain (GetNumber ("PortamentoMode", nTG, 0), 0, 1));
+		pTG->setPortamentoGlissando (constrain (GetNumber ("PortamentoGlissando", nTG, 0), 0, 1));
+		pTG->setPortamentoTime (constrain (GetNumber ("PortamentoTime", nTG, 0), 0, 99));
+		pTG->setMonoMode (GetNumber ("MonoMode", nTG, 0) != 0);
+		pTG->doRefreshVoice ();
+		pTG->ControllersRefresh ();
+	}
+
+	bool bCompressor = GetNumber ("CompressorEnable", MaxToneGenerators, 1) != 0;
+	for (unsigned nTG = 0; nTG < m_nToneGenerators; nTG++)
+	{
+		m_pTG[nTG]->setCompressor (bCompressor);
+	}
+
+	m_bReverbEnable = GetNumber ("ReverbEnable", MaxToneGenerators, 1) != 0;
+	m_pReverb->size (constrain (GetNumber ("ReverbSize", MaxToneGenerators, 70), 0, 99) / 99.0f);
+	m_pReverb->hidamp (constrain (GetNumber ("ReverbHighDamp", MaxToneGenerators, 50), 0, 99) / 99.0f);
+	m_pReverb->lodamp (constrain (GetNumber ("ReverbLowDamp", MaxToneGenerators, 50), 0, 99) / 99.0f);
+	m_pReverb->lowpass (constrain (GetNumber ("ReverbLowPass", MaxToneGenerators, 30), 0, 99) / 99.0f);
+	m_pReverb->diffusion (constrain (GetNumber ("ReverbDiffusion", MaxToneGenerators, 65), 0, 99) / 99.0f);
+	m_pReverb->level (constrain (GetNumber ("ReverbLevel", MaxToneGenerators, 99), 0, 99) / 99.0f);
+
+	return true;
+}
+
+void COfflineRenderer::MIDIMessage (const u8 *pMessage, unsigned nLength)
+{
+	assert (pMessage);
+	if (nLength < 2)
+	{
+		return;
+	}
+
+	u8 ucChannel = pMessage[0] & 0x0F;
+	u8 ucType = pMessage[0] >> 4;
+	u8 ucP1 = pMessage[1];
+	u8 ucP2 = nLength >= 3 ? pMessage[2] : 0;
+
+	for (unsigned nTG = 0; nTG < m_nToneGenerators; nTG++)
+	{
+		if (   m_nMIDIChannel[nTG] != ucChannel
+		    && m_nMIDIChannel[nTG] != OmniMode)
+		{
+			continue;
+		}
+
+		CDexedAdapter *pTG = m_pTG[nTG];
+		assert (pTG);
+
+		int nPitch;
+		switch (ucType)
+		{
+		case MIDI_NOTE_ON:
+		case MIDI_NOTE_OFF:
+			nPitch = ApplyNoteLimits (ucP1, nTG);
+			if (nPitch < 0)
+			{
+				break;
+			}
+
+			if (ucType == MIDI_NOTE_ON && ucP2 > 0)
+			{
+				pTG->keydown (nPitch, ucP2);
+			}
+			else
+			{
+				pTG->keyup (nPitch);
+			}
+			break;
+
+		case MIDI_CHANNEL_AFTERTOUCH:
+			pTG->setAftertouch (ucP1);
+			pTG->ControllersRefresh ();
+			break;
+
+		case MIDI_CONTROL_CHANGE:
+			switch (ucP1)
+			{
+			case MIDI_CC_MODULATION:
+				pTG->setModWheel (ucP2);
+				pTG->ControllersRefresh ();
+				break;
+
+			case MIDI_CC_VOLUME:
+				m_nVolume[nTG] = ucP2;
+				SetVolume (nTG);
+				break;
+
+			case MIDI_CC_PAN_POSITION:
+				SetPan (ucP2, nTG);
+				break;
+
+			case MIDI_CC_EXPRESSION:
+				m_nExpression[nTG] = ucP2;
+				SetVolume (nTG);
+				break;
+
+			case MIDI_CC_BANK_SUSTAIN:
+				pTG->setSustain (ucP2 >= 64);
+				break;
+
+			case MIDI_CC_REVERB_LEVEL:
+				SetReverbSend (maplong (ucP2, 0, 127, 0, 99), nTG);
+				break;
+
+			case MIDI_CC_ALL_SOUND_OFF:
+				if (ucP2 == 0)
+				{
+					pTG->panic ();
+				}
+				break;
+
+			case MIDI_CC_ALL_NOTES_OFF:
+				if (ucP2 == 0)
+				{
+					pTG->notesOff ();
+				}
+				break;
+
+			default:
+				break;
+			}
+			break;
+
+		case MIDI_PITCH_BEND:
+			pTG->setPitchbend ((s16) (ucP1 | (ucP2 << 7)) - 0x2000);
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
+// The TGs are rendered one after another on this thread, the job scheduler,
+// the pipelining, the polyphony governor and the voice pool of the Pi are not
+// used. The stages after the TGs are the same code as on the Pi (MixStereo()).
+void COfflineRenderer::RenderChunk (CHostSoundDevice *pSoundDevice, unsigned nStartTicks)
+{
+	assert (pSoundDevice);
+
+	m_nChunkNanos = 0;
+
+	for (unsigned nTG = 0; nTG < m_nToneGenerators; nTG++)
+	{
+		StageStart ();
+
+		bool bRendered = m_pTG[nTG]->getSamples (m_OutputLevel[nTG].data (), m_nFrames, nStartTicks);
+		if (!bRendered && m_bRendered[nTG])
+		{
+			arm_fill_f32 (0.0f, m_OutputLevel[nTG].data (), m_nFrames);
+		}
+		m_bRendered[nTG] = bRendered;
+
+		StageStop (StageRender, nTG);
+	}
+
+	float32_t *pTGOutput[MaxToneGenerators];
+	for (unsigned nTG = 0; nTG < MaxToneGenerators; nTG++)
+	{
+		pTGOutput[nTG] =    nTG < m_nToneGenerators && m_bRendered[nTG]
+				 ? m_OutputLevel[nTG].data () : 0;
+	}
+
+	TMixBuffers Buffers;
+	for (unsigned i = 0; i < 2; i++)
+	{
+		Buffers.pSample[i] = m_SampleBuffer[i].data ();
+		Buffers.pReverbSend[i] = m_ReverbSendBuffer[i].data ();
+		Buffers.pReverb[i] = m_ReverbBuffer[i].data ();
+	}
+
+	MixStereo (m_pTGMixer, pTGOutput, m_bReverbEnable ? m_pReverb : 0, &m_ReverbSpinLock,
+		   Buffers, false, m_fMasterVolume, m_OutputInt.data (), m_nFrames,
+		   MixStageHandler, this);
+
+	StageStart ();
+
+	size_t nBytes = m_OutputInt.size () * sizeof (int32_t);
+	if (pSoundDevice->Write (m_OutputInt.data (), nBytes) != (int) nBytes)
+	{
+		LOGERR ("Sound data dropped");
+	}
+
+	StageStop (StageWrite);
+
+	if (m_nChunkNanos > m_nMaximumChunkNanos)
+	{
+		m_nMaximumChunkNanos = m_nChunkNanos;
+	}
+
+	if (m_nChunkNanos / 1000 > 1000000U * m_nFrames / m_nSampleRate)
+	{
+		m_nDeadlineMisses++;
+	}
+
+	m_nChunks++;
+}
+
+void COfflineRenderer::DumpProfile (void) const
+{
+	static const char *StageName[StageUnknown] =
+	{
+		"render", "mix", "reverb", "output", "write"
+	};
+
+	if (m_nChunks == 0)
+	{
+		return;
+	}
+
+	unsigned nDeadlineMicros = 1000000U * m_nFrames / m_nSampleRate;
+
+	printf ("%u chunks of %u frames, deadline %u us\n\n", m_nChunks, m_nFrames, nDeadlineMicros);
+	printf ("%-10s %10s %10s\n", "stage", "avg us", "max us");
+
+	unsigned long long nTotalNanos = 0;
+	for (unsigned i = 0; i < StageUnknown; i++)
+	{
+		printf ("%-10s %10.1f %10.1f\n", StageName[i],
+			m_nTotalNanos[i] / 1000.0 / m_nChunks, m_nMaximumNanos[i] / 1000.0);
+
+		nTotalNanos += m_nTotalNanos[i];
+	}
+
+	printf ("%-10s %10.1f %10.1f (%u%% of deadline)\n\n", "total",
+		nTotalNanos / 1000.0 / m_nChunks, m_nMaximumChunkNanos / 1000.0,
+		m_nMaximumChunkNanos / 10 / nDeadlineMicros);
+
+	for (unsigned nTG = 0; nTG < m_nToneGenerators; nTG++)
+	{
+		printf ("TG%-8u %10.1f\n", nTG+1, m_nTGTotalNanos[nTG] / 1000.0 / m_nChunks);
+	}
+
+	printf ("\n%u chunks missed the deadline\n", m_nDeadlineMisses);
+}
+
+void COfflineRenderer::SetVolume (unsigned nTG)
+{
+	assert (m_pTG[nTG]);
+	m_pTG[nTG]->setGain ((m_nVolume[nTG] * m_nExpression[nTG]) / (127.0f * 127.0f));
+}
+
+void COfflineRenderer::SetPan (unsigned nPan, unsigned nTG)
+{
+	m_pTGMixer->pan (nTG, mapfloat (nPan, 0, 127, 0.0f, 1.0f));
+}
+
+void COfflineRenderer::SetReverbSend (unsigned nReverbSend, unsigned nTG)
+{
+	m_pTGMixer->send (nTG, mapfloat (nReverbSend, 0, 99, 0.0f, 1.0f));
+}
+
+int COfflineRenderer::ApplyNoteLimits (int nPitch, unsigned nTG) const
+{
+	if (   nPitch < (int) m_nNoteLimitLow[nTG]
+	    || nPitch > (int) m_nNoteLimitHigh[nTG])
+	{
+		return -1;
+	}
+
+	nPitch += m_nNoteShift[nTG];
+
+	return nPitch < 0 || nPitch > 127 ? -1 : nPitch;
+}
+
+void COfflineRenderer::StageStart (void)
+{
+	m_StageStart = std::chrono::steady_clock::now ();
+}
+
+void COfflineRenderer::StageStop (TStage Stage)
+{
+	auto Duration = std::chrono::steady_clock::now () - m_StageStart;
+	unsigned nNanos = std::chrono::duration_cast<std::chrono::nanoseconds> (Duration).count ();
+
+	m_nTotalNanos[Stage] += nNanos;
+	m_nChunkNanos += nNanos;
+
+	if (   Stage != StageRender		// render is summed up over all TGs below
+	    && nNanos > m_nMaximumNanos[Stage])
+	{
+		m_nMaximumNanos[Stage] = nNanos;
+	}
+}
+
+void COfflineRenderer::MixStageHandler (TMixStage Stage, bool bStart, void *pParam)
+{
+	COfflineRenderer *pThis = static_cast<COfflineRenderer *> (pParam);
+	assert (pThis);
+
+	static const TStage Stages[MixStageUnknown] = {StageMix, StageReverb, StageOutput};
+
+	if (bStart)
+	{
+		pThis->StageStart ();
+	}
+	else
+	{
+		pThis->StageStop (Stages[Stage]);
+	}
+}
+
+void COfflineRenderer::StageStop (TStage Stage, unsigned nTG)
+{
+	unsigned nChunkNanos = m_nChunkNanos;
+
+	StageStop (Stage);
+
+	unsigned nNanos = m_nChunkNanos - nChunkNanos;
+	m_nTGTotalNanos[nTG] += nNanos;
+
+	if (   nTG == m_nToneGenerators-1
+	    && m_nChunkNanos > m_nMaximumNanos[Stage])
+	{
+		m_nMaximumNanos[Stage] = m_nChunkNanos;	// all TGs of this chunk
+	}
+}
+
+static void Usage (const char *pProgram)
+{
+	fprintf (stderr, "Usage: %s [options] file.mid\n\n"
+		 "  -p FILE  performance file (default: none, TG1 in omni mode)\n"
+		 "  -s DIR   directory with voice banks (default: ../sysex)\n"
+		 "  -o FILE  output WAV file (default: out.wav)\n"
+		 "  -r RATE  sample rate (default: 48000)\n"
+		 "  -c SIZE  chunk size, as in minidexed.ini (default: 256)\n"
+		 "  -t NUM   number of tone generators (default: 8)\n"
+		 "  -n NUM   polyphony per tone generator (default: 16)\n"
+		 "  -v VOL   master volume 0..127 (default: 64)\n"
+		 "  -x SECS  render this long after the last MIDI event (default: 2)\n",
+		 pProgram);
+}
+
+int main (int argc, char **argv)
+{
+	const char *pPerformance = 0;
+	const char *pSysExDir = "../sysex";
+	const char *pOutput = "out.wav";
+	unsigned nSampleRate = 48000;
+	unsigned nChunkSize = 256;
+	unsigned nToneGenerators = 8;
+	unsigned nPolyphony = 16;
+	unsigned nMasterVolume = 64;
+	double fTailSeconds = 2.0;
+
+	int nOption;
+	while ((nOption = getopt (argc, argv, "p:s:o:r:c:t:n:v:x:h")) != -1)
+	{
+		switch (nOption)
+		{
+		case 'p':	pPerformance = optarg;			break;
+		case 's':	pSysExDir = optarg;			break;
+		case 'o':	pOutput = optarg;			break;
+		case 'r':	nSampleRate = atoi (optarg);		break;
+		case 'c':	nChunkSize = atoi (optarg);		break;
+		case 't':	nToneGenerators = atoi (optarg);	break;
+		case 'n':	nPolyphony = atoi (optarg);		break;
+		case 'v':	nMasterVolume = atoi (optarg);		break;
+		case 'x':	fTailSeconds = atof (optarg);		break;
+
+		default:
+			Usage (argv[0]);
+			return 1;
+		}
+	}
+
+	if (   optind != argc-1
+	    || nToneGenerators < 1 || nToneGenerators > COfflineRenderer::MaxToneGenerators
+	    || nChunkSize < 2 || nSampleRate == 0)
+	{
+		Usage (argv[0]);
+		return 1;
+	}
+
+	CMIDIFile MIDIFile;
+	if (!MIDIFile.Load (argv[optind]))
+	{
+		return 1;
+	}
+
+	CSysExFileLoader *pSysExFileLoader = new CSysExFileLoader (pSysExDir);
+	pSysExFileLoader->Load ();
+
+	COfflineRenderer Renderer (nSampleRate, nChunkSize, nToneGenerators, nPolyphony,
+				   constrain (nMasterVolume, 0U, 127U));
+	if (   pPerformance
+	    && !Renderer.LoadPerformance (pPerformance, pSysExFileLoader))
+	{
+		return 1;
+	}
+
+	CHostSoundDevice SoundDevice (nSampleRate);
+	SoundDevice.AllocateQueueFrames (nChunkSize);
+	SoundDevice.SetWriteFormat (2);
+	if (!SoundDevice.Open (pOutput))
+	{
+		LOGERR ("%s: Cannot create", pOutput);
+
+		return 1;
+	}
+
+	const std::vector<CMIDIFile::TEvent> &Events = MIDIFile.GetEvents ();
+	size_t nNextEvent = 0;
+
+	unsigned nFrames = Renderer.GetFramesPerChunk ();
+	unsigned long nTotalFrames = (MIDIFile.GetDuration () + fTailSeconds) * nSampleRate;
+
+	auto StartTime = std::chrono::steady_clock::now ();
+
+	for (unsigned long nFrame = 0; nFrame < nTotalFrames; nFrame += nFrames)
+	{
+		// The events are timestamped with the virtual clock and take
+		// effect at their position within the chunk (in steps of _N_
+		// frames), as on the Pi with SampleAccurateMIDI=1, but without
+		// the latency of one chunk.
+		double fChunkEnd = (double) (nFrame + nFrames) / nSampleRate;
+		while (   nNextEvent < Events.size ()
+		       && Events[nNextEvent].fTime < fChunkEnd)
+		{
+			CTimer::SetClockTicks ((unsigned) (u64) (Events[nNextEvent].fTime * CLOCKHZ));
+			Renderer.MIDIMessage (Events[nNextEvent].Message, Events[nNextEvent].nLength);
+			nNextEvent++;
+		}
+
+		Renderer.RenderChunk (&SoundDevice, (unsigned) (nFrame * CLOCKHZ / nSampleRate));
+	}
+
+	auto Duration = std::chrono::steady_clock::now () - StartTime;
+	double fSeconds = std::chrono::duration<double> (Duration).count ();
+
+	SoundDevice.Close ();
+
+	double fAudioSeconds = (double) SoundDevice.GetFramesWritten () / nSampleRate;
+	printf ("Rendered %.1f s of audio in %.2f s (%.1fx real time) to %s\n\n",
+		fAudioSeconds, fSeconds, fSeconds > 0.0 ? fAudioSeconds / fSeconds : 0.0, pOutput);
+
+	Renderer.DumpProfile ();
+
+	delete pSysExFileLoader;
+
+	return 0;
+}
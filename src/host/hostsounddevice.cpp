@@ -0,0 +1,149 @@
+//
+// hostsounddevice.cpp
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2022  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "hostsounddevice.h"
+#include <assert.h>
+
+static const unsigned BytesPerSample = 3;	// 24-bit PCM
+static const unsigned HeaderSize = 44;
+
+CHostSoundDevice::CHostSoundDevice (unsigned nSampleRate)
+:	m_nSampleRate (nSampleRate),
+	m_nChannels (2),
+	m_nQueueSizeFrames (0),
+	m_pFile (0),
+	m_nFramesWritten (0)
+{
+}
+
+CHostSoundDevice::~CHostSoundDevice (void)
+{
+	Close ();
+}
+
+bool CHostSoundDevice::Open (const char *pFileName)
+{
+	assert (!m_pFile);
+
+	m_pFile = fopen (pFileName, "wb");
+	if (!m_pFile)
+	{
+		return false;
+	}
+
+	m_nFramesWritten = 0;
+	WriteHeader ();		// sizes are updated in Close()
+
+	return true;
+}
+
+void CHostSoundDevice::Close (void)
+{
+	if (!m_pFile)
+	{
+		return;
+	}
+
+	fseek (m_pFile, 0, SEEK_SET);
+	WriteHeader ();
+
+	fclose (m_pFile);
+	m_pFile = 0;
+}
+
+bool CHostSoundDevice::AllocateQueueFrames (unsigned nFrames)
+{
+	m_nQueueSizeFrames = nFrames;
+
+	return nFrames > 0;
+}
+
+void CHostSoundDevice::SetWriteFormat (unsigned nChannels)
+{
+	assert (nChannels > 0);
+	m_nChannels = nChannels;
+}
+
+unsigned CHostSoundDevice::GetQueueSizeFrames (void) const
+{
+	return m_nQueueSizeFrames;
+}
+
+unsigned CHostSoundDevice::GetQueueFramesAvail (void) const
+{
+	return 0;			// the file is never full
+}
+
+int CHostSoundDevice::Write (const void *pBuffer, size_t nCount)
+{
+	assert (pBuffer);
+	assert (m_pFile);
+
+	const s32 *pSamples = (const s32 *) pBuffer;
+	size_t nSamples = nCount / sizeof (s32);
+
+	for (size_t i = 0; i < nSamples; i++)
+	{
+		u8 Sample[BytesPerSample] = {(u8) pSamples[i], (u8) (pSamples[i] >> 8), (u8) (pSamples[i] >> 16)};
+
+		if (fwrite (Sample, BytesPerSample, 1, m_pFile) != 1)
+		{
+			return -1;
+		}
+	}
+
+	m_nFramesWritten += nSamples / m_nChannels;
+
+	return (int) nCount;
+}
+
+unsigned CHostSoundDevice::GetFramesWritten (void) const
+{
+	return m_nFramesWritten;
+}
+
+static void PutLE (u8 *pBuffer, u32 nValue, unsigned nBytes)
+{
+	for (unsigned i = 0; i < nBytes; i++)
+	{
+		pBuffer[i] = (u8) (nValue >> (8*i));
+	}
+}
+
+void CHostSoundDevice::WriteHeader (void)
+{
+	assert (m_pFile);
+
+	u32 nDataSize = m_nFramesWritten * m_nChannels * BytesPerSample;
+	unsigned nBlockAlign = m_nChannels * BytesPerSample;
+
+	u8 Header[HeaderSize] = {'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E',
+				 'f', 'm', 't', ' ', 16, 0, 0, 0};
+	PutLE (&Header[4], HeaderSize - 8 + nDataSize, 4);
+	PutLE (&Header[20], 1, 2);				// PCM
+	PutLE (&Header[22], m_nChannels, 2);
+	PutLE (&Header[24], m_nSampleRate, 4);
+	PutLE (&Header[28], m_nSampleRate * nBlockAlign, 4);
+	PutLE (&Header[32], nBlockAlign, 2);
+	PutLE (&Header[34], BytesPerSample * 8, 2);
+	Header[36] = 'd'; Header[37] = 'a'; Header[38] = 't'; Header[39] = 'a';
+	PutLE (&Header[40], nDataSize, 4);
+
+	fwrite (Header, sizeof Header, 1, m_pFile);
+}
@@ -0,0 +1,62 @@
+//
+// hostsounddevice.h
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2022  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _hostsounddevice_h
+#define _hostsounddevice_h
+
+#include <circle/types.h>
+#include <stdio.h>
+
+// Stands in for CSoundBaseDevice in the host build. Accepts the same
+// SoundFormatSigned24_32 interleaved samples, which the audio path writes
+// on the Pi, and stores them as 24-bit PCM into a WAV file. The queue is
+// always empty, so that the renderer runs as fast as possible.
+
+class CHostSoundDevice
+{
+public:
+	CHostSoundDevice (unsigned nSampleRate);
+	~CHostSoundDevice (void);
+
+	bool Open (const char *pFileName);
+	void Close (void);
+
+	bool AllocateQueueFrames (unsigned nFrames);
+	void SetWriteFormat (unsigned nChannels);
+
+	unsigned GetQueueSizeFrames (void) const;
+	unsigned GetQueueFramesAvail (void) const;
+
+	int Write (const void *pBuffer, size_t nCount);
+
+	unsigned GetFramesWritten (void) const;
+
+private:
+	void WriteHeader (void);
+
+private:
+	unsigned m_nSampleRate;
+	unsigned m_nChannels;
+	unsigned m_nQueueSizeFrames;
+
+	FILE *m_pFile;
+	unsigned m_nFramesWritten;
+};
+
+#endif
@@ -0,0 +1,44 @@
+//
+// logger.h
+//
+// Host build replacement for the Circle header of the same name,
+// writes all log messages to stderr
+//
+#ifndef _circle_logger_h
+#define _circle_logger_h
+
+#include <circle/types.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+enum TLogSeverity
+{
+	LogPanic,
+	LogError,
+	LogWarning,
+	LogNotice,
+	LogDebug
+};
+
+static inline void HostLogWrite (const char *pSource, TLogSeverity Severity, const char *pMessage, ...)
+{
+	static const char *Prefix[] = {"!", "E", "W", "N", "D"};
+
+	fprintf (stderr, "%s %s: ", Prefix[Severity], pSource);
+
+	va_list var;
+	va_start (var, pMessage);
+	vfprintf (stderr, pMessage, var);
+	va_end (var);
+
+	fprintf (stderr, "\n");
+}
+
+#define LOGMODULE(name)		static const char From[] = name
+#define LOGPANIC(...)		HostLogWrite (From, LogPanic, __VA_ARGS__)
+#define LOGERR(...)		HostLogWrite (From, LogError, __VA_ARGS__)
+#define LOGWARN(...)		HostLogWrite (From, LogWarning, __VA_ARGS__)
+#define LOGNOTE(...)		HostLogWrite (From, LogNotice, __VA_ARGS__)
+#define LOGDBG(...)		HostLogWrite (From, LogDebug, __VA_ARGS__)
+
+#endif
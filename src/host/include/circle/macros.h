@@ -0,0 +1,13 @@
+//
+// macros.h
+//
+// Host build replacement for the Circle header of the same name
+//
+#ifndef _circle_macros_h
+#define _circle_macros_h
+
+#define PACKED		__attribute__ ((packed))
+#define ALIGN(n)	__attribute__ ((aligned (n)))
+#define MAYBE_UNUSED	__attribute__ ((unused))
+
+#endif
@@ -0,0 +1,19 @@
+//
+// spinlock.h
+//
+// Host build replacement for the Circle header of the same name.
+// The offline renderer runs on a single thread, so there is nothing to lock.
+//
+#ifndef _circle_spinlock_h
+#define _circle_spinlock_h
+
+class CSpinLock
+{
+public:
+	CSpinLock (unsigned nTargetLevel = 0) {}
+
+	void Acquire (void) {}
+	void Release (void) {}
+};
+
+#endif
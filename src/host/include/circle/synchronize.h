@@ -0,0 +1,20 @@
+//
+// synchronize.h
+//
+// Host build replacement for the Circle header of the same name.
+// The offline renderer has no interrupts, all code runs at task level.
+//
+#ifndef _circle_synchronize_h
+#define _circle_synchronize_h
+
+#define TASK_LEVEL	0
+#define IRQ_LEVEL	1
+#define FIQ_LEVEL	2
+
+inline unsigned CurrentExecutionLevel (void)	{ return TASK_LEVEL; }
+
+// there are no other cores to wait for or to wake
+#define WaitForEvent()	((void) 0)
+#define SendEvent()	((void) 0)
+
+#endif
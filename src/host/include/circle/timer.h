@@ -0,0 +1,49 @@
+//
+// timer.h
+//
+// Host build replacement for the Circle header of the same name.
+// The offline renderer does not run in real time, so the clock is virtual
+// and is advanced by the renderer to the time of the MIDI file. Kernel
+// timers are handed out, but never fire.
+//
+#ifndef _circle_timer_h
+#define _circle_timer_h
+
+#include <stdint.h>
+
+#define CLOCKHZ	1000000
+#define HZ	100
+
+#define MSEC2HZ(msecs)	((msecs) * HZ / 1000)
+
+typedef uintptr_t TKernelTimerHandle;
+
+typedef void TKernelTimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext);
+
+class CTimer
+{
+public:
+	static unsigned GetClockTicks (void)		{ return s_nClockTicks; }
+
+	static void SetClockTicks (unsigned nTicks)	{ s_nClockTicks = nTicks; }
+
+	static CTimer *Get (void)			{ return &s_Timer; }
+
+	TKernelTimerHandle StartKernelTimer (unsigned nDelay, TKernelTimerHandler *pHandler,
+					     void *pParam = 0, void *pContext = 0)
+	{
+		return ++m_hNextTimer;
+	}
+
+	void CancelKernelTimer (TKernelTimerHandle hTimer) {}
+
+private:
+	TKernelTimerHandle m_hNextTimer = 0;
+
+	static inline unsigned s_nClockTicks = 0;
+	static CTimer s_Timer;
+};
+
+inline CTimer CTimer::s_Timer;
+
+#endif
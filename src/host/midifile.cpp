@@ -0,0 +1,267 @@
+//
+// midifile.cpp
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2022  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "midifile.h"
+#include <circle/logger.h>
+#include <stdio.h>
+#include <algorithm>
+
+LOGMODULE ("midifile");
+
+static u32 GetBE (const u8 *pData, unsigned nBytes)
+{
+	u32 nValue = 0;
+	for (unsigned i = 0; i < nBytes; i++)
+	{
+		nValue = (nValue << 8) | pData[i];
+	}
+
+	return nValue;
+}
+
+CMIDIFile::CMIDIFile (void)
+:	m_nDivision (480)
+{
+}
+
+bool CMIDIFile::Load (const char *pFileName)
+{
+	FILE *pFile = fopen (pFileName, "rb");
+	if (!pFile)
+	{
+		LOGERR ("%s: Cannot open", pFileName);
+
+		return false;
+	}
+
+	std::vector<u8> Data;
+	u8 Buffer[4096];
+	size_t nRead;
+	while ((nRead = fread (Buffer, 1, sizeof Buffer, pFile)) > 0)
+	{
+		Data.insert (Data.end (), Buffer, Buffer + nRead);
+	}
+	fclose (pFile);
+
+	if (   Data.size () < 14
+	    || GetBE (&Data[0], 4) != 0x4D546864)	// "MThd"
+	{
+		LOGERR ("%s: Not a MIDI file", pFileName);
+
+		return false;
+	}
+
+	unsigned nTracks = GetBE (&Data[10], 2);
+	m_nDivision = GetBE (&Data[12], 2);
+
+	double fTicksPerSecond = 0.0;		// for SMPTE time division only
+	if (m_nDivision & 0x8000)
+	{
+		unsigned nFPS = 256 - (m_nDivision >> 8);
+		fTicksPerSecond = nFPS * (m_nDivision & 0xFF);
+	}
+	else if (m_nDivision == 0)
+	{
+		LOGERR ("%s: Invalid time division", pFileName);
+
+		return false;
+	}
+
+	std::vector<TTrackEvent> Events;
+	size_t nOffset = 8 + GetBE (&Data[4], 4);
+	for (unsigned nTrack = 0; nTrack < nTracks && nOffset + 8 <= Data.size (); nTrack++)
+	{
+		u32 nChunkSize = GetBE (&Data[nOffset+4], 4);
+		if (nOffset + 8 + nChunkSize > Data.size ())
+		{
+			LOGWARN ("%s: Track %u truncated", pFileName, nTrack);
+
+			nChunkSize = Data.size () - nOffset - 8;
+		}
+
+		if (GetBE (&Data[nOffset], 4) == 0x4D54726B)	// "MTrk"
+		{
+			ParseTrack (&Data[nOffset+8], nChunkSize, Events);
+		}
+
+		nOffset += 8 + nChunkSize;
+	}
+
+	std::stable_sort (Events.begin (), Events.end (),
+			  [] (const TTrackEvent &A, const TTrackEvent &B)
+			  {
+				return A.nTick < B.nTick;
+			  });
+
+	// convert ticks to seconds along the tempo map
+	m_Events.clear ();
+	u32 nLastTick = 0;
+	double fTime = 0.0;
+	double fSecondsPerTick = fTicksPerSecond > 0.0 ? 1.0 / fTicksPerSecond
+						       : 500000.0 / 1000000.0 / m_nDivision;
+	for (auto &Event : Events)
+	{
+		fTime += (Event.nTick - nLastTick) * fSecondsPerTick;
+		nLastTick = Event.nTick;
+
+		if (Event.bTempo)
+		{
+			if (fTicksPerSecond == 0.0)
+			{
+				fSecondsPerTick = Event.nTempo / 1000000.0 / m_nDivision;
+			}
+
+			continue;
+		}
+
+		Event.Event.fTime = fTime;
+		m_Events.push_back (Event.Event);
+	}
+
+	LOGNOTE ("%s: %u events, %.1f seconds", pFileName, (unsigned) m_Events.size (), GetDuration ());
+
+	return true;
+}
+
+const std::vector<CMIDIFile::TEvent> &CMIDIFile::GetEvents (void) const
+{
+	return m_Events;
+}
+
+double CMIDIFile::GetDuration (void) const
+{
+	return m_Events.empty () ? 0.0 : m_Events.back ().fTime;
+}
+
+bool CMIDIFile::ParseTrack (const u8 *pData, size_t nSize, std::vector<TTrackEvent> &rEvents)
+{
+	static const unsigned DataBytes[8] = {2, 2, 2, 2, 1, 1, 2, 0};	// 0x80 .. 0xF0
+
+	size_t nPos = 0;
+	u32 nTick = 0;
+	u8 ucRunningStatus = 0;
+
+	auto ReadVLQ = [&] (u32 &rValue) -> bool
+	{
+		rValue = 0;
+		for (unsigned i = 0; i < 4; i++)
+		{
+			if (nPos >= nSize)
+			{
+				return false;
+			}
+
+			u8 ucByte = pData[nPos++];
+			rValue = (rValue << 7) | (ucByte & 0x7F);
+			if (!(ucByte & 0x80))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	};
+
+	while (nPos < nSize)
+	{
+		u32 nDelta;
+		if (!ReadVLQ (nDelta) || nPos >= nSize)
+		{
+			return false;
+		}
+		nTick += nDelta;
+
+		TTrackEvent Event {};
+		Event.nTick = nTick;
+
+		u8 ucStatus = pData[nPos];
+		if (ucStatus == 0xFF)				// meta event
+		{
+			if (nPos + 2 > nSize)
+			{
+				return false;
+			}
+
+			u8 ucType = pData[nPos+1];
+			nPos += 2;
+
+			u32 nLength;
+			if (!ReadVLQ (nLength) || nPos + nLength > nSize)
+			{
+				return false;
+			}
+
+			if (ucType == 0x51 && nLength == 3)	// set tempo
+			{
+				Event.bTempo = true;
+				Event.nTempo = GetBE (&pData[nPos], 3);
+				rEvents.push_back (Event);
+			}
+			else if (ucType == 0x2F)		// end of track
+			{
+				return true;
+			}
+
+			nPos += nLength;
+
+			continue;
+		}
+
+		if (ucStatus == 0xF0 || ucStatus == 0xF7)	// SysEx is ignored
+		{
+			nPos++;
+
+			u32 nLength;
+			if (!ReadVLQ (nLength) || nPos + nLength > nSize)
+			{
+				return false;
+			}
+			nPos += nLength;
+
+			continue;
+		}
+
+		if (ucStatus & 0x80)
+		{
+			ucRunningStatus = ucStatus;
+			nPos++;
+		}
+		else if (!ucRunningStatus)
+		{
+			return false;
+		}
+
+		unsigned nDataBytes = DataBytes[(ucRunningStatus >> 4) & 7];
+		if (nPos + nDataBytes > nSize)
+		{
+			return false;
+		}
+
+		Event.Event.Message[0] = ucRunningStatus;
+		for (unsigned i = 0; i < nDataBytes; i++)
+		{
+			Event.Event.Message[1+i] = pData[nPos++];
+		}
+		Event.Event.nLength = 1 + nDataBytes;
+
+		rEvents.push_back (Event);
+	}
+
+	return true;
+}
@@ -0,0 +1,63 @@
+//
+// midifile.h
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2022  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _midifile_h
+#define _midifile_h
+
+#include <circle/types.h>
+#include <vector>
+
+// Loader for Standard MIDI Files (format 0 and 1). All tracks are merged
+// into one list of channel messages, sorted by their time in seconds.
+
+class CMIDIFile
+{
+public:
+	struct TEvent
+	{
+		double fTime;		// seconds from start
+		u8 Message[3];
+		unsigned nLength;
+	};
+
+public:
+	CMIDIFile (void);
+
+	bool Load (const char *pFileName);
+
+	const std::vector<TEvent> &GetEvents (void) const;
+	double GetDuration (void) const;	// seconds
+
+private:
+	struct TTrackEvent
+	{
+		u32 nTick;
+		bool bTempo;
+		u32 nTempo;			// us per quarter note
+		TEvent Event;
+	};
+
+	bool ParseTrack (const u8 *pData, size_t nSize, std::vector<TTrackEvent> &rEvents);
+
+private:
+	unsigned m_nDivision;
+	std::vector<TEvent> m_Events;
+};
+
+#endif
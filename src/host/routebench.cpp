@@ -0,0 +1,250 @@
+//
+// routebench.cpp
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2024  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+// Benchmark for the MIDI route map on a Linux host. Routes a stream of
+// random MIDI messages through a DAW controller like route map (with groups,
+// toggles, timers and range operators), once by scanning the route map and
+// once with the compiled index. Checks, that both paths route each message
+// the same way, and reports the time per message.
+//
+
+#include "../midiroute.h"
+#include "../midi.h"
+#include <chrono>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define ROUTE_DEST_DAW	0xF		// stands in for MIDI_DAW_CHANGE
+
+struct TMessage
+{
+	u8 ucCable;
+	u8 ucChannel;
+	u8 ucType;
+	u8 ucP1;
+	u8 ucP2;
+	bool bSkip;
+};
+
+static unsigned s_nRandom = 1;
+
+static unsigned Random (unsigned nRange)
+{
+	s_nRandom = s_nRandom * 1103515245 + 12345;
+
+	return (s_nRandom >> 16) % nRange;
+}
+
+static void TimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext)
+{
+}
+
+// nRoutes routes (at least the fixed part), terminated with ucSCable == 0xFF
+static TMIDIRoute *CreateRouteMap (unsigned nRoutes)
+{
+	static const TMIDIRoute FixedRoutes[] =
+	{
+		{0, 0, MIDI_CONTROL_CHANGE, 14, 0xFF, 0, ROUTE_DEST_DAW, 0, 0xFF},	// faders
+		{0, 0, MIDI_CONTROL_CHANGE, 15, 0xFF, 0, ROUTE_DEST_DAW, 1, 0xFF},
+
+		{0, 0, MIDI_CONTROL_CHANGE, 118, 0x7F, .ucTimerTarget=2, .usTimerExpire=500, .bSkip=true},	// knob click
+		{0, 0, MIDI_CONTROL_CHANGE, 118, 0x00, 0, ROUTE_DEST_DAW, 2, 0, .bGroup=true},
+		{0, 0, MIDI_CONTROL_CHANGE, 118, 0x00, 0, ROUTE_DEST_DAW, 3, 0, .bGroup=true},
+		{0, 0, MIDI_CONTROL_CHANGE, 28, TMIDIRoute::LtCenter, 0, ROUTE_DEST_DAW, 4, 0xFF, .bGroup=true, .bGroupHold=true},
+		{0, 0, MIDI_CONTROL_CHANGE, 28, TMIDIRoute::GtCenter, 0, ROUTE_DEST_DAW, 5, 0xFF, .bGroup=true, .bGroupHold=true},
+
+		{0, 0, MIDI_CONTROL_CHANGE, 28, TMIDIRoute::LtCenter, 0, ROUTE_DEST_DAW, 6, 0xFF},	// knob
+		{0, 0, MIDI_CONTROL_CHANGE, 28, TMIDIRoute::GtCenter, 0, ROUTE_DEST_DAW, 7, 0xFF},
+
+		{0, 9, MIDI_NOTE_ON, 37, 0xFF, .bSkip=true, .bGroupHead=true},			// pads
+		{0, 9, MIDI_NOTE_OFF, 37, 0xFF, 0, MIDI_CONTROL_CHANGE, MIDI_CC_PORTAMENTO, 0x7F, .bToggle=true, .bGroup=true},
+		{0, 9, MIDI_AFTERTOUCH, 37, 0xFF, 0, ROUTE_DEST_DAW, 8, 0x7F, .bGroup=true},
+		{0, 9, MIDI_NOTE_OFF, 43, 0xFF, 0, MIDI_CHANNEL_AFTERTOUCH, 0x00, 0xFF},
+		{0, 9, MIDI_AFTERTOUCH, 43, 0xFF, 0, MIDI_CHANNEL_AFTERTOUCH, TMIDIRoute::P2, 0xFF},
+
+		{1, 0, MIDI_NOTE_ON, TMIDIRoute::Betw08n15, 0x00, 0, ROUTE_DEST_DAW, 9, 0x7F},		// buttons
+		{1, 0, MIDI_NOTE_ON, TMIDIRoute::Betw16n23, 0x7F, .ucTimerTarget=2, .usTimerExpire=500, .bSkip=true},
+		{1, 0, MIDI_NOTE_ON, TMIDIRoute::Betw16n23, 0x00, 0, MIDI_CONTROL_CHANGE, MIDI_CC_PORTAMENTO, 0x7F, .bToggle=true, .bGroup=true},
+		{1, 0, MIDI_NOTE_ON, TMIDIRoute::Betw16n23, 0x00, 0, ROUTE_DEST_DAW, 10, 0x7F, .bGroup=true},
+		{1, 16, MIDI_PITCH_BEND, 0xFF, 0xFF, 0, ROUTE_DEST_DAW, 11, 0xFF},
+	};
+	const unsigned nFixedRoutes = sizeof FixedRoutes / sizeof FixedRoutes[0];
+
+	if (nRoutes < nFixedRoutes)
+	{
+		nRoutes = nFixedRoutes;
+	}
+
+	TMIDIRoute *pRouteMap = new TMIDIRoute[nRoutes+1] ();
+
+	for (unsigned i = 0; i < nFixedRoutes; i++)
+	{
+		pRouteMap[i] = FixedRoutes[i];
+	}
+
+	// more controls on other channels, mostly CCs
+	for (unsigned i = nFixedRoutes; i < nRoutes; i++)
+	{
+		TMIDIRoute *r = &pRouteMap[i];
+
+		r->ucSCable = Random (2);
+		r->ucSCh = 1 + Random (15);
+		r->ucSType = Random (4) ? MIDI_CONTROL_CHANGE : MIDI_NOTE_ON;
+		r->ucSP1 = Random (128);
+		r->ucSP2 = Random (4) ? 0xFF : 0x7F;
+		r->ucDCh = 0;
+		r->ucDType = ROUTE_DEST_DAW;
+		r->ucDP1 = Random (128);
+		r->ucDP2 = 0xFF;
+		r->bToggle = Random (8) == 0;
+	}
+
+	pRouteMap[nRoutes].ucSCable = 0xFF;
+
+	return pRouteMap;
+}
+
+static std::vector<TMessage> CreateMessages (unsigned nMessages)
+{
+	static const u8 Types[] = {MIDI_NOTE_ON, MIDI_NOTE_OFF, MIDI_AFTERTOUCH,
+				   MIDI_CONTROL_CHANGE, MIDI_CONTROL_CHANGE, MIDI_PITCH_BEND};
+
+	std::vector<TMessage> Messages (nMessages);
+	for (TMessage &rMessage : Messages)
+	{
+		rMessage.ucCable = Random (2);
+		rMessage.ucChannel = Random (2) ? Random (16) : (Random (2) ? 0 : 9);
+		rMessage.ucType = Types[Random (sizeof Types)];
+		rMessage.ucP1 = Random (128);
+		rMessage.ucP2 = Random (2) ? Random (128) : (Random (2) ? 0x00 : 0x7F);
+		rMessage.bSkip = false;
+	}
+
+	return Messages;
+}
+
+// routes the messages in place, returns the nanoseconds per message
+static double Route (TMIDIRoute *pRouteMap, const CMIDIRouteIndex *pIndex, std::vector<TMessage> &rMessages)
+{
+	auto StartTime = std::chrono::steady_clock::now ();
+
+	for (TMessage &rMessage : rMessages)
+	{
+		GetRoutedMIDI (pRouteMap, pIndex, TimerHandler, 0,
+			       &rMessage.ucCable, &rMessage.ucChannel, &rMessage.ucType,
+			       &rMessage.ucP1, &rMessage.ucP2, &rMessage.bSkip);
+	}
+
+	auto Duration = std::chrono::steady_clock::now () - StartTime;
+
+	return std::chrono::duration<double, std::nano> (Duration).count () / rMessages.size ();
+}
+
+static void Usage (const char *pProgram)
+{
+	fprintf (stderr, "Usage: %s [options]\n\n"
+		 "  -r NUM   number of routes (default: 75)\n"
+		 "  -m NUM   number of messages (default: 1000000)\n",
+		 pProgram);
+}
+
+int main (int argc, char **argv)
+{
+	unsigned nRoutes = 75;			// as for the MiniLab 3
+	unsigned nMessages = 1000000;
+
+	int nOption;
+	while ((nOption = getopt (argc, argv, "r:m:h")) != -1)
+	{
+		switch (nOption)
+		{
+		case 'r':	nRoutes = atoi (optarg);	break;
+		case 'm':	nMessages = atoi (optarg);	break;
+
+		default:
+			Usage (argv[0]);
+			return 1;
+		}
+	}
+
+	if (nMessages == 0)
+	{
+		Usage (argv[0]);
+		return 1;
+	}
+
+	// both paths work on a route map of their own, because routing changes
+	// the toggle and group state
+	TMIDIRoute *pScanRouteMap = CreateRouteMap (nRoutes);
+	s_nRandom = 1;
+	TMIDIRoute *pIndexRouteMap = CreateRouteMap (nRoutes);
+
+	auto StartTime = std::chrono::steady_clock::now ();
+	CMIDIRouteIndex Index;
+	Index.Build (pIndexRouteMap);
+	auto BuildDuration = std::chrono::steady_clock::now () - StartTime;
+
+	std::vector<TMessage> ScanMessages = CreateMessages (nMessages);
+	std::vector<TMessage> IndexMessages = ScanMessages;
+
+	double fScanNanos = Route (pScanRouteMap, 0, ScanMessages);
+	double fIndexNanos = Route (pIndexRouteMap, &Index, IndexMessages);
+
+	unsigned nRouted = 0;
+	unsigned nMismatches = 0;
+	for (unsigned i = 0; i < nMessages; i++)
+	{
+		const TMessage &rScan = ScanMessages[i];
+		const TMessage &rIndex = IndexMessages[i];
+
+		if (   rScan.ucCable != rIndex.ucCable || rScan.ucChannel != rIndex.ucChannel
+		    || rScan.ucType != rIndex.ucType || rScan.ucP1 != rIndex.ucP1
+		    || rScan.ucP2 != rIndex.ucP2 || rScan.bSkip != rIndex.bSkip)
+		{
+			nMismatches++;
+		}
+
+		if (rScan.ucType == ROUTE_DEST_DAW || rScan.bSkip)
+		{
+			nRouted++;
+		}
+	}
+
+	printf ("%u routes, %u messages (%u routed or skipped)\n\n", nRoutes, nMessages, nRouted);
+	printf ("Index build   %8.1f us\n",
+		std::chrono::duration<double, std::micro> (BuildDuration).count ());
+	printf ("Index memory  %8.1f KB\n", Index.GetMemory () / 1024.0);
+	printf ("Scan          %8.1f ns/message\n", fScanNanos);
+	printf ("Index         %8.1f ns/message\n", fIndexNanos);
+
+	delete [] pScanRouteMap;
+	delete [] pIndexRouteMap;
+
+	if (nMismatches > 0)
+	{
+		printf ("\n%u messages routed differently\n", nMismatches);
+
+		return 1;
+	}
+
+	return 0;
+}
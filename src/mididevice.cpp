@@ -51,6 +51,7 @@ const unsigned MIDISystemCCMap[NUM_MIDI_CC_MAPS][8] = {
 
 #define MIDI_SYSTEM_EXCLUSIVE_BEGIN	0xF0
 #define MIDI_SYSTEM_EXCLUSIVE_END	0xF7
+#define MIDI_SYSEX_NON_COMMERCIAL	0x7D
 #define MIDI_TIMING_CLOCK	0xF8
 #define MIDI_ACTIVE_SENSING	0xFE
 
@@ -60,12 +61,18 @@ CMIDIDevice::CMIDIDevice (CMiniDexed *pSynthesizer, CConfig *pConfig, CUserInter
 :	m_pSynthesizer (pSynthesizer),
 	m_pConfig (pConfig),
 	m_pUI (pUI),
-	m_pRouteMap ()
+	m_nSysExCable (0),
+	m_pRouteMap (),
+	m_pRouteIndex (0),
+	m_pOldRouteIndex (0),
+	m_nRouteMapSerial (0),
+	m_nRouteIndexSerial (0)
 {
 	for (unsigned nTG = 0; nTG < CConfig::AllToneGenerators; nTG++)
 	{
 		m_ChannelMap[nTG] = Disabled;
 	}
+	UpdateChannelTGMasks ();
 
 	m_nMIDISystemCCVol = m_pConfig->GetMIDISystemCCVol();
 	m_nMIDISystemCCPan = m_pConfig->GetMIDISystemCCPan();
@@ -107,6 +114,11 @@ CMIDIDevice::CMIDIDevice (CMiniDexed *pSynthesizer, CConfig *pConfig, CUserInter
 
 CMIDIDevice::~CMIDIDevice (void)
 {
+	delete m_pRouteIndex;
+	m_pRouteIndex = 0;
+	delete m_pOldRouteIndex;
+	m_pOldRouteIndex = 0;
+
 	m_pSynthesizer = 0;
 }
 
@@ -114,6 +126,8 @@ void CMIDIDevice::SetChannel (u8 ucChannel, unsigned nTG)
 {
 	assert (nTG < CConfig::AllToneGenerators);
 	m_ChannelMap[nTG] = ucChannel;
+
+	UpdateChannelTGMasks ();
 }
 
 u8 CMIDIDevice::GetChannel (unsigned nTG) const
@@ -122,6 +136,34 @@ u8 CMIDIDevice::GetChannel (unsigned nTG) const
 	return m_ChannelMap[nTG];
 }
 
+// The dispatch table is rebuilt, when the channel of a TG changes (also on
+// performance load), so that the MIDI handler does not have to check the
+// channel of each TG for each message.
+void CMIDIDevice::UpdateChannelTGMasks (void)
+{
+	u32 ChannelTGMask[Channels] = {0};
+	for (unsigned nTG = 0; nTG < m_pConfig->GetToneGenerators (); nTG++)
+	{
+		u8 ucChannel = m_ChannelMap[nTG];
+		if (ucChannel < Channels)
+		{
+			ChannelTGMask[ucChannel] |= 1U << nTG;
+		}
+		else if (ucChannel == OmniMode)
+		{
+			for (unsigned i = 0; i < Channels; i++)
+			{
+				ChannelTGMask[i] |= 1U << nTG;
+			}
+		}
+	}
+
+	for (unsigned i = 0; i < Channels; i++)
+	{
+		m_ChannelTGMask[i] = ChannelTGMask[i];
+	}
+}
+
 void CMIDIDevice::MIDIMessageHandler (const u8 *pMessage, size_t nLength, unsigned nCable)
 {
 	// The packet contents are just normal MIDI data - see
@@ -185,17 +227,7 @@ void CMIDIDevice::MIDIMessageHandler (const u8 *pMessage, size_t nLength, unsign
 	}
 */
 
-	// Handle MIDI Thru
-	if (m_DeviceName.compare (m_pConfig->GetMIDIThruIn ()) == 0)
-	{
-		TDeviceMap::const_iterator Iterator;
-
-		Iterator = s_DeviceMap.find (m_pConfig->GetMIDIThruOut ());
-		if (Iterator != s_DeviceMap.end ())
-		{
-			Iterator->second->Send (pMessage, nLength, nCable);
-		}
-	}
+	SendThru (pMessage, nLength, nCable);
 
 	if (nLength < 2)
 	{
@@ -214,7 +246,8 @@ void CMIDIDevice::MIDIMessageHandler (const u8 *pMessage, size_t nLength, unsign
 	bool bSkip    = false;
 
 	if (m_pRouteMap)
-		GetRoutedMIDI (m_pRouteMap, this, &ucCable, &ucChannel, &ucType, &ucP1, &ucP2, &bSkip);
+		GetRoutedMIDI (m_pRouteMap, m_pRouteIndex, s_HandleTimerTimeout, this,
+			       &ucCable, &ucChannel, &ucType, &ucP1, &ucP2, &bSkip);
 
 	if (bSkip)
 	{
@@ -255,6 +288,30 @@ void CMIDIDevice::MIDIMessageHandler (const u8 *pMessage, size_t nLength, unsign
 		//printf("Master volume: %f (%d)\n",fMasterVolume, nMasterVolume);
 		m_pSynthesizer->setMasterVolume(fMasterVolume);
 	}
+	// MINIDEXED PROFILING SYSEX
+	//
+	//   F0 7D 01 SS F7  Request profiling data of stage SS
+	//                   (CMiniDexed::TProfileStage, TGs start at 6,
+	//                   program changes are stage 22)
+	//   F0 7D 02 F7     Reset profiling data
+	//
+	//  The reply is sent by SendProfileData().
+	else if (nLength == 5 &&
+		 pMessage[0] == MIDI_SYSTEM_EXCLUSIVE_BEGIN &&
+		 pMessage[1] == MIDI_SYSEX_NON_COMMERCIAL &&
+		 pMessage[2] == 0x01 &&
+		 pMessage[4] == MIDI_SYSTEM_EXCLUSIVE_END)
+	{
+		SendProfileData (pMessage[3], nCable);
+	}
+	else if (nLength == 4 &&
+		 pMessage[0] == MIDI_SYSTEM_EXCLUSIVE_BEGIN &&
+		 pMessage[1] == MIDI_SYSEX_NON_COMMERCIAL &&
+		 pMessage[2] == 0x02 &&
+		 pMessage[3] == MIDI_SYSTEM_EXCLUSIVE_END)
+	{
+		m_pSynthesizer->ResetProfile ();
+	}
 	else
 	{
 		// Perform any MiniDexed level MIDI handling before specific Tone Generators
@@ -323,207 +380,207 @@ void CMIDIDevice::MIDIMessageHandler (const u8 *pMessage, size_t nLength, unsign
 			break;
 		}
 
-		// Process MIDI for each active Tone Generator
+		// Process MIDI for each active Tone Generator, which listens on the channel
+		u32 nTGMask = m_ChannelTGMask[ucChannel];
+		if (ucStatus == MIDI_SYSTEM_EXCLUSIVE_BEGIN)
+		{
+			// MIDI SYSEX per MIDI channel
+			nTGMask = nLength > 2 ? m_ChannelTGMask[pMessage[2] & 0x0F] : 0;
+		}
+
 		bool bSystemCCHandled = false;
 		bool bSystemCCChecked = false;
-		for (unsigned nTG = 0; nTG < m_pConfig->GetToneGenerators() && !bSystemCCHandled; nTG++)
+		for (; nTGMask != 0 && !bSystemCCHandled; nTGMask &= nTGMask - 1)
 		{
+			unsigned nTG = __builtin_ctz (nTGMask);		// lowest TG first
+
 			if (m_pSynthesizer->GetTGParameter (CMiniDexed::TGParameterEnabled, nTG) == 0)
 				continue;
 
 			if (ucStatus == MIDI_SYSTEM_EXCLUSIVE_BEGIN)
 			{
-				// MIDI SYSEX per MIDI channel
-				uint8_t ucSysExChannel = (pMessage[2] & 0x0F);
-				if (m_ChannelMap[nTG] == ucSysExChannel || m_ChannelMap[nTG] == OmniMode)
-				{
-					LOGNOTE("MIDI-SYSEX: channel: %u, len: %u, TG: %u",m_ChannelMap[nTG],nLength,nTG);
-					HandleSystemExclusive(pMessage, nLength, nCable, nTG);
-				}
+				LOGNOTE("MIDI-SYSEX: channel: %u, len: %u, TG: %u",m_ChannelMap[nTG],nLength,nTG);
+				HandleSystemExclusive(pMessage, nLength, nCable, nTG);
 			}
 			else
 			{
-				if (   m_ChannelMap[nTG] == ucChannel
-				    || m_ChannelMap[nTG] == OmniMode)
+				switch (ucType)
 				{
-					switch (ucType)
+				case MIDI_NOTE_ON:
+					if (nLength < 3)
 					{
-					case MIDI_NOTE_ON:
-						if (nLength < 3)
-						{
-							break;
-						}
-		
-						if (ucP2 > 0)
-						{
-							if (ucP2 <= 127)
-							{
-								m_pSynthesizer->keydown (ucP1,
-											 ucP2, nTG);
-							}
-						}
-						else
-						{
-							m_pSynthesizer->keyup (ucP1, nTG);
-						}
 						break;
-		
-					case MIDI_NOTE_OFF:
-						if (nLength < 3)
+					}
+	
+					if (ucP2 > 0)
+					{
+						if (ucP2 <= 127)
 						{
-							break;
+							m_pSynthesizer->keydown (ucP1,
+										 ucP2, nTG);
 						}
-		
+					}
+					else
+					{
 						m_pSynthesizer->keyup (ucP1, nTG);
+					}
+					break;
+	
+				case MIDI_NOTE_OFF:
+					if (nLength < 3)
+					{
 						break;
-		
-					case MIDI_CHANNEL_AFTERTOUCH:
+					}
+	
+					m_pSynthesizer->keyup (ucP1, nTG);
+					break;
+	
+				case MIDI_CHANNEL_AFTERTOUCH:
+					
+					m_pSynthesizer->setAftertouch (ucP1, nTG);
+					m_pSynthesizer->ControllersRefresh (nTG);
+					break;
 						
-						m_pSynthesizer->setAftertouch (ucP1, nTG);
+				case MIDI_CONTROL_CHANGE:
+					if (nLength < 3)
+					{
+						break;
+					}
+	
+					switch (ucP1)
+					{
+					case MIDI_CC_MODULATION:
+						m_pSynthesizer->setModWheel (ucP2, nTG);
 						m_pSynthesizer->ControllersRefresh (nTG);
 						break;
 							
-					case MIDI_CONTROL_CHANGE:
-						if (nLength < 3)
+					case MIDI_CC_FOOT_PEDAL:
+						m_pSynthesizer->setFootController (ucP2, nTG);
+						m_pSynthesizer->ControllersRefresh (nTG);
+						break;
+
+					case MIDI_CC_PORTAMENTO_TIME:
+						m_pSynthesizer->setPortamentoTime (maplong (ucP2, 0, 127, 0, 99), nTG);
+						break;
+
+					case MIDI_CC_BREATH_CONTROLLER:
+						m_pSynthesizer->setBreathController (ucP2, nTG);
+						m_pSynthesizer->ControllersRefresh (nTG);
+						break;
+							
+					case MIDI_CC_VOLUME:
+						m_pSynthesizer->SetVolume (ucP2, nTG);
+						break;
+	
+					case MIDI_CC_PAN_POSITION:
+						m_pSynthesizer->SetPan (ucP2, nTG);
+						break;
+	
+					case MIDI_CC_EXPRESSION:
+						if (m_nMIDIGlobalExpression == Disabled) {
+							// Expression is per channel only
+							m_pSynthesizer->SetExpression (pMessage[2], nTG);
+						}
+						break;
+	
+					case MIDI_CC_BANK_SELECT_MSB:
+						m_pSynthesizer->BankSelectMSB (ucP2, nTG);
+						break;
+	
+					case MIDI_CC_BANK_SELECT_LSB:
+						m_pSynthesizer->BankSelectLSB (ucP2, nTG);
+						break;
+	
+					case MIDI_CC_BANK_SUSTAIN:
+						m_pSynthesizer->setSustain (ucP2 >= 64, nTG);
+						break;
+
+					case MIDI_CC_SOSTENUTO:
+						m_pSynthesizer->setSostenuto (ucP2 >= 64, nTG);
+						break;
+	
+					case MIDI_CC_PORTAMENTO:
+						m_pSynthesizer->setPortamentoMode (ucP2 >= 64, nTG);
+						break;
+
+					case MIDI_CC_HOLD2:
+						m_pSynthesizer->setHoldMode (ucP2 >= 64, nTG);
+						break;
+	
+					case MIDI_CC_RESONANCE:
+						m_pSynthesizer->SetResonance (maplong (ucP2, 0, 127, 0, 99), nTG);
+						break;
+						
+					case MIDI_CC_FREQUENCY_CUTOFF:
+						m_pSynthesizer->SetCutoff (maplong (ucP2, 0, 127, 0, 99), nTG);
+						break;
+	
+					case MIDI_CC_REVERB_LEVEL:
+						m_pSynthesizer->SetReverbSend (maplong (ucP2, 0, 127, 0, 99), nTG);
+						break;
+	
+					case MIDI_CC_DETUNE_LEVEL:
+						if (ucP2 == 0)
 						{
-							break;
+							// "0 to 127, with 0 being no celeste (detune) effect applied at all."
+							m_pSynthesizer->SetMasterTune (0, nTG);
 						}
-		
-						switch (ucP1)
+						else
 						{
-						case MIDI_CC_MODULATION:
-							m_pSynthesizer->setModWheel (ucP2, nTG);
-							m_pSynthesizer->ControllersRefresh (nTG);
-							break;
-								
-						case MIDI_CC_FOOT_PEDAL:
-							m_pSynthesizer->setFootController (ucP2, nTG);
-							m_pSynthesizer->ControllersRefresh (nTG);
-							break;
-
-						case MIDI_CC_PORTAMENTO_TIME:
-							m_pSynthesizer->setPortamentoTime (maplong (ucP2, 0, 127, 0, 99), nTG);
-							break;
-
-						case MIDI_CC_BREATH_CONTROLLER:
-							m_pSynthesizer->setBreathController (ucP2, nTG);
-							m_pSynthesizer->ControllersRefresh (nTG);
-							break;
-								
-						case MIDI_CC_VOLUME:
-							m_pSynthesizer->SetVolume (ucP2, nTG);
-							break;
-		
-						case MIDI_CC_PAN_POSITION:
-							m_pSynthesizer->SetPan (ucP2, nTG);
-							break;
-		
-						case MIDI_CC_EXPRESSION:
-							if (m_nMIDIGlobalExpression == Disabled) {
-								// Expression is per channel only
-								m_pSynthesizer->SetExpression (pMessage[2], nTG);
-							}
-							break;
-		
-						case MIDI_CC_BANK_SELECT_MSB:
-							m_pSynthesizer->BankSelectMSB (ucP2, nTG);
-							break;
-		
-						case MIDI_CC_BANK_SELECT_LSB:
-							m_pSynthesizer->BankSelectLSB (ucP2, nTG);
-							break;
-		
-						case MIDI_CC_BANK_SUSTAIN:
-							m_pSynthesizer->setSustain (ucP2 >= 64, nTG);
-							break;
-
-						case MIDI_CC_SOSTENUTO:
-							m_pSynthesizer->setSostenuto (ucP2 >= 64, nTG);
-							break;
-		
-						case MIDI_CC_PORTAMENTO:
-							m_pSynthesizer->setPortamentoMode (ucP2 >= 64, nTG);
-							break;
-
-						case MIDI_CC_HOLD2:
-							m_pSynthesizer->setHoldMode (ucP2 >= 64, nTG);
-							break;
-		
-						case MIDI_CC_RESONANCE:
-							m_pSynthesizer->SetResonance (maplong (ucP2, 0, 127, 0, 99), nTG);
-							break;
-							
-						case MIDI_CC_FREQUENCY_CUTOFF:
-							m_pSynthesizer->SetCutoff (maplong (ucP2, 0, 127, 0, 99), nTG);
-							break;
-		
-						case MIDI_CC_REVERB_LEVEL:
-							m_pSynthesizer->SetReverbSend (maplong (ucP2, 0, 127, 0, 99), nTG);
-							break;
-		
-						case MIDI_CC_DETUNE_LEVEL:
-							if (ucP2 == 0)
-							{
-								// "0 to 127, with 0 being no celeste (detune) effect applied at all."
-								m_pSynthesizer->SetMasterTune (0, nTG);
-							}
-							else
-							{
-								m_pSynthesizer->SetMasterTune (maplong (ucP2, 1, 127, -99, 99), nTG);
-							}
-							break;
-		
-						case MIDI_CC_ALL_SOUND_OFF:
-							m_pSynthesizer->panic (ucP2, nTG);
-							break;
-		
-						case MIDI_CC_ALL_NOTES_OFF:
-							// As per "MIDI 1.0 Detailed Specification" v4.2
-							// From "ALL NOTES OFF" states:
-							// "Receivers should ignore an All Notes Off message while Omni is on (Modes 1 & 2)"
-							if (!m_pConfig->GetIgnoreAllNotesOff () && m_ChannelMap[nTG] != OmniMode)
-							{
-								m_pSynthesizer->notesOff (ucP2, nTG);
-							}
-							break;
-
-						default:
-							// Check for system-level, cross-TG MIDI Controls, but only do it once.
-							// Also, if successfully handled, then no need to process other TGs,
-							// so it is possible to break out of the main TG loop too.
-							// Note: We handle this here so we get the TG MIDI channel checking.
-							if (!bSystemCCChecked) {
-								bSystemCCHandled = HandleMIDISystemCC(ucP1, ucP2);
-								bSystemCCChecked = true;
-							}
-							break;
+							m_pSynthesizer->SetMasterTune (maplong (ucP2, 1, 127, -99, 99), nTG);
 						}
 						break;
-		
-					case MIDI_PROGRAM_CHANGE:
-						// do program change only if enabled in config and not in "Performance Select Channel" mode
-						if( m_pConfig->GetMIDIRXProgramChange() && ( m_pSynthesizer->GetPerformanceSelectChannel() == Disabled) ) {
-							//printf("Program Change to %d (%d)\n", ucChannel, m_pSynthesizer->GetPerformanceSelectChannel());
-							m_pSynthesizer->ProgramChange (ucP1, nTG);
-						}
+	
+					case MIDI_CC_ALL_SOUND_OFF:
+						m_pSynthesizer->panic (ucP2, nTG);
 						break;
-		
-					case MIDI_PITCH_BEND: {
-						if (nLength < 3)
+	
+					case MIDI_CC_ALL_NOTES_OFF:
+						// As per "MIDI 1.0 Detailed Specification" v4.2
+						// From "ALL NOTES OFF" states:
+						// "Receivers should ignore an All Notes Off message while Omni is on (Modes 1 & 2)"
+						if (!m_pConfig->GetIgnoreAllNotesOff () && m_ChannelMap[nTG] != OmniMode)
 						{
-							break;
+							m_pSynthesizer->notesOff (ucP2, nTG);
 						}
-		
-						s16 nValue = ucP1;
-						nValue |= (s16) ucP2 << 7;
-						nValue -= 0x2000;
-		
-						m_pSynthesizer->setPitchbend (nValue, nTG);
-						} break;
-		
+						break;
+
 					default:
+						// Check for system-level, cross-TG MIDI Controls, but only do it once.
+						// Also, if successfully handled, then no need to process other TGs,
+						// so it is possible to break out of the main TG loop too.
+						// Note: We handle this here so we get the TG MIDI channel checking.
+						if (!bSystemCCChecked) {
+							bSystemCCHandled = HandleMIDISystemCC(ucP1, ucP2);
+							bSystemCCChecked = true;
+						}
+						break;
+					}
+					break;
+	
+				case MIDI_PROGRAM_CHANGE:
+					// do program change only if enabled in config and not in "Performance Select Channel" mode
+					if( m_pConfig->GetMIDIRXProgramChange() && ( m_pSynthesizer->GetPerformanceSelectChannel() == Disabled) ) {
+						//printf("Program Change to %d (%d)\n", ucChannel, m_pSynthesizer->GetPerformanceSelectChannel());
+						m_pSynthesizer->ProgramChange (ucP1, nTG);
+					}
+					break;
+	
+				case MIDI_PITCH_BEND: {
+					if (nLength < 3)
+					{
 						break;
 					}
+	
+					s16 nValue = ucP1;
+					nValue |= (s16) ucP2 << 7;
+					nValue -= 0x2000;
+	
+					m_pSynthesizer->setPitchbend (nValue, nTG);
+					} break;
+	
+				default:
+					break;
 				}
 			}
 		}
@@ -591,9 +648,66 @@ bool CMIDIDevice::HandleMIDISystemCC(const u8 ucCC, const u8 ucCCval)
 	return false;
 }
 
+// Called from the DAW connections, also in interrupt context. Building the
+// index takes too long there, so it is built by UpdateRouteIndex() from the
+// main loop. Until then the route map is scanned.
 void CMIDIDevice::SetRouteMap (TMIDIRoute *pRouteMap)
 {
+	m_MIDISpinLock.Acquire ();
+
+	if (m_pRouteIndex)
+	{
+		assert (!m_pOldRouteIndex);
+		m_pOldRouteIndex = m_pRouteIndex;
+		m_pRouteIndex = 0;
+	}
+
 	m_pRouteMap = pRouteMap;
+	m_nRouteMapSerial++;
+
+	m_MIDISpinLock.Release ();
+}
+
+void CMIDIDevice::UpdateRouteIndex (void)
+{
+	if (m_nRouteIndexSerial == m_nRouteMapSerial)
+	{
+		return;
+	}
+
+	m_MIDISpinLock.Acquire ();
+
+	TMIDIRoute *pRouteMap = m_pRouteMap;
+	unsigned nSerial = m_nRouteMapSerial;
+	CMIDIRouteIndex *pOldRouteIndex = m_pOldRouteIndex;
+	m_pOldRouteIndex = 0;
+
+	m_MIDISpinLock.Release ();
+
+	delete pOldRouteIndex;
+
+	// the route maps are freed on the main loop only, so that pRouteMap
+	// stays valid, even if it is replaced meanwhile
+	CMIDIRouteIndex *pRouteIndex = 0;
+	if (pRouteMap)
+	{
+		pRouteIndex = new CMIDIRouteIndex;
+		pRouteIndex->Build (pRouteMap);
+	}
+
+	m_MIDISpinLock.Acquire ();
+
+	if (nSerial == m_nRouteMapSerial)
+	{
+		assert (!m_pRouteIndex);
+		m_pRouteIndex = pRouteIndex;
+		pRouteIndex = 0;
+	}
+	m_nRouteIndexSerial = nSerial;		// retried with the next call otherwise
+
+	m_MIDISpinLock.Release ();
+
+	delete pRouteIndex;			// outdated
 }
 
 void CMIDIDevice::HandleSystemExclusive(const uint8_t* pMessage, const size_t nLength, const unsigned nCable, const uint8_t nTG)
@@ -724,6 +838,43 @@ void CMIDIDevice::HandleSystemExclusive(const uint8_t* pMessage, const size_t nL
   }
 }
 
+// DX7 bank dumps are streamed through the SysEx parser and not buffered,
+// the checksum has been verified already.
+void CMIDIDevice::BankDumpHandler (const u8 *pHeader, unsigned nCable)
+{
+	u8 ucChannel = pHeader[2] & 0x0F;
+	if (m_ChannelTGMask[ucChannel] == 0)
+	{
+		return;
+	}
+
+	// banks are loaded from the SD card only, a received bank is not stored
+	LOGNOTE("Bank bulk upload ignored");
+}
+
+// Handle MIDI Thru
+void CMIDIDevice::SendThru (const u8 *pMessage, size_t nLength, unsigned nCable)
+{
+	if (m_DeviceName.compare (m_pConfig->GetMIDIThruIn ()) == 0)
+	{
+		TDeviceMap::const_iterator Iterator;
+
+		Iterator = s_DeviceMap.find (m_pConfig->GetMIDIThruOut ());
+		if (Iterator != s_DeviceMap.end ())
+		{
+			Iterator->second->Send (pMessage, nLength, nCable);
+		}
+	}
+}
+
+void CMIDIDevice::SysExThruHandler (const u8 *pData, unsigned nLength, void *pParam)
+{
+	CMIDIDevice *pThis = static_cast<CMIDIDevice *> (pParam);
+	assert (pThis != 0);
+
+	pThis->SendThru (pData, nLength, pThis->m_nSysExCable);
+}
+
 void CMIDIDevice::MIDIListener (u8 ucCable, u8 ucChannel, u8 ucType, u8 ucP1, u8 ucP2)
 {
 }
@@ -746,97 +897,72 @@ void CMIDIDevice::SendSystemExclusiveVoice(uint8_t nVoice, const unsigned nCable
   }
 } 
 
-void CMIDIDevice::s_HandleTimerTimeout(TKernelTimerHandle hTimer, void *pParam, void *pContext)
-{
-	CMIDIDevice *pDevice = static_cast<CMIDIDevice*>(pParam);
-	TMIDIRoute *pRoute = static_cast<TMIDIRoute*>(pContext);
-	TMIDIRoute *pTarget = pRoute + pRoute->ucTimerTarget;
-
-	pRoute->hTimer = 0;
-	pRoute->bGroupActive = false;
-	pRoute->bGroupHold = false;
-	if (!pTarget->bSkip)
-		pDevice->MIDIListener (pTarget->ucSCable, pTarget->ucDCh, pTarget->ucDType, pTarget->ucDP1, pTarget->ucDP2);
-}
-
-static bool RouteMatch (u8 ucSP, u8 ucP)
-{
-	return ucSP == ucP ||
-		ucSP == 0xFF ||
-		ucSP == TMIDIRoute::LtCenter && ucP < 64 ||
-		ucSP == TMIDIRoute::GtCenter && ucP > 64 ||
-		ucSP == TMIDIRoute::Betw00n07 && ucP >= 0 && ucP <= 7 ||
-		ucSP == TMIDIRoute::Betw08n15 && ucP >= 8 && ucP <= 15 ||
-		ucSP == TMIDIRoute::Betw16n23 && ucP >= 16 && ucP <= 23;
-}
-
-void GetRoutedMIDI (TMIDIRoute *pRouteMap, CMIDIDevice *pDevice, u8 *pCable, u8 *pCh, u8 *pType, u8 *pP1, u8 *pP2, bool *bSkip)
+// Reply to a profiling data request:
+//   F0 7D 03 SS  Profiling data of stage SS follows
+//   P0 P1 P2     50th percentile in us (7 bits per byte, LSB first)
+//   Q0 Q1 Q2     99th percentile in us
+//   M0 M1 M2     Maximum in us
+//   D0 D1 D2     Deadline in us
+//   X0 X1 X2 X3  Deadline misses
+//   N0 N1 N2 N3  Number of samples
+//   F7
+// All values are 0, if profiling is disabled (ProfileEnabled=0).
+void CMIDIDevice::SendProfileData (u8 ucStage, unsigned nCable)
 {
-	assert (pRouteMap);
-	for (TMIDIRoute *r = pRouteMap; r->ucSCable != 0xFF ; r++)
+	if (ucStage >= CMiniDexed::ProfileStageUnknown)
 	{
-		if (r->ucSCable == *pCable &&
-			(r->ucSCh == *pCh || r->ucSCh >= 16) &&
-			(r->ucSType == *pType || r->ucSType >= 16) &&
-			RouteMatch (r->ucSP1, *pP1) &&
-			RouteMatch (r->ucSP2, *pP2)
-			)
-		{
-			if (r->usTimerExpire)
-				r->hTimer = CTimer::Get ()->StartKernelTimer (MSEC2HZ(r->usTimerExpire), CMIDIDevice::s_HandleTimerTimeout, pDevice, r);
-				
-			if (r->usTimerExpire || r->bGroupHead)
-				r->bGroupActive = true;
-
-			if (r->bSkip) {
-				*bSkip = true;
-				return;
-			}
-
-			if (r->bGroup) {
-				TMIDIRoute *parent = r - 1;
-				for (; parent > pRouteMap && parent->bGroup; parent--);
-
-				if (parent->hTimer) {
-					CTimer::Get ()->CancelKernelTimer (parent->hTimer);
-					parent->hTimer = 0;
-				}
-				
-				if (!r->bGroupHold)
-					parent->bGroupHold = false;
+		return;
+	}
 
-				if (!parent->bGroupActive && !parent->bGroupHold) {
-					// skip at the end if not captured by other routes
-					*bSkip = true;
-					continue;
-				}	
+	unsigned Values[6] = {0};
+	if (m_pSynthesizer->GetProfileEnabled ())
+	{
+		const CPerformanceTimer *pTimer =
+			m_pSynthesizer->GetProfileTimer ((CMiniDexed::TProfileStage) ucStage);
+		assert (pTimer);
+
+		Values[0] = pTimer->GetPercentile (50);
+		Values[1] = pTimer->GetPercentile (99);
+		Values[2] = pTimer->GetMaximum ();
+		Values[3] = pTimer->GetDeadline ();
+		Values[4] = pTimer->GetDeadlineMisses ();
+		Values[5] = pTimer->GetCount ();
+	}
 
-				// hold the group for bGroupHold routes
-				if (r->bGroupHold)
-					parent->bGroupHold = true;
+	u8 Reply[4 + 4*3 + 2*4 + 1];
+	unsigned nLength = 0;
+	Reply[nLength++] = MIDI_SYSTEM_EXCLUSIVE_BEGIN;
+	Reply[nLength++] = MIDI_SYSEX_NON_COMMERCIAL;
+	Reply[nLength++] = 0x03;
+	Reply[nLength++] = ucStage;
 
-				parent->bGroupActive = false;
-			}
+	for (unsigned i = 0; i < 6; i++)
+	{
+		unsigned nBytes = i < 4 ? 3 : 4;
+		unsigned nMaxValue = (1U << (7*nBytes)) - 1;
+		unsigned nValue = Values[i] < nMaxValue ? Values[i] : nMaxValue;
 
-			*pCh = r->ucDCh;
-			*pType = r->ucDType;
-			if (r->ucDP1 <= 127)
-				*pP1 = r->ucDP1;
-			if (r->ucDP1 == TMIDIRoute::P2)
-				*pP1 = *pP2;
-			if (r->ucDP2 <= 127)
-				*pP2 = r->ucDP2;
-			if (r->bToggle)
-				r->ucDP2 = r->ucDP2 ? 0x0 : 0x7F;
-			*bSkip = false;
-			return;
+		for (unsigned j = 0; j < nBytes; j++)
+		{
+			Reply[nLength++] = (nValue >> (7*j)) & 0x7F;
 		}
 	}
+
+	Reply[nLength++] = MIDI_SYSTEM_EXCLUSIVE_END;
+	assert (nLength == sizeof Reply);
+
+	Send (Reply, nLength, nCable);
 }
 
-TMIDIRoute::~TMIDIRoute ()
+void CMIDIDevice::s_HandleTimerTimeout(TKernelTimerHandle hTimer, void *pParam, void *pContext)
 {
-	if (hTimer)
-		CTimer::Get ()->CancelKernelTimer (hTimer);
-	hTimer = 0;
+	CMIDIDevice *pDevice = static_cast<CMIDIDevice*>(pParam);
+	TMIDIRoute *pRoute = static_cast<TMIDIRoute*>(pContext);
+	TMIDIRoute *pTarget = pRoute + pRoute->ucTimerTarget;
+
+	pRoute->hTimer = 0;
+	pRoute->bGroupActive = false;
+	pRoute->bGroupHold = false;
+	if (!pTarget->bSkip)
+		pDevice->MIDIListener (pTarget->ucSCable, pTarget->ucDCh, pTarget->ucDType, pTarget->ucDP1, pTarget->ucDP2);
 }
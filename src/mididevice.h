@@ -29,48 +29,13 @@
 #include <circle/types.h>
 #include <circle/spinlock.h>
 #include "userinterface.h"
+#include "midiroute.h"
+#include "sysexparser.h"
 
 #define MAX_DX7_SYSEX_LENGTH 4104
 #define MAX_MIDI_MESSAGE MAX_DX7_SYSEX_LENGTH
 
 class CMiniDexed;
-class CMIDIDevice;
-
-struct TMIDIRoute
-{
-	~TMIDIRoute ();
-
-	enum TRouteOP
-	{
-		P2 = 0x82,
-		LtCenter = 0x90,
-		GtCenter = 0x91,
-		Betw00n07 = 0x92,
-		Betw08n15 = 0x93,
-		Betw16n23 = 0x94
-	};
-
-	u8 ucSCable;
-	u8 ucSCh;
-	u8 ucSType;
-	u8 ucSP1;
-	u8 ucSP2;
-	u8 ucDCh;
-	u8 ucDType;
-	u8 ucDP1;
-	u8 ucDP2;
-	u8 ucTimerTarget;
-	unsigned usTimerExpire;
-	TKernelTimerHandle hTimer;
-	bool bSkip;
-	bool bToggle;
-	bool bGroup;
-	bool bGroupHead;
-	bool bGroupActive;
-	bool bGroupHold; // hold flag for GroupHeads, or set hold the group
-};
-
-void GetRoutedMIDI (TMIDIRoute *pRouteMap, CMIDIDevice *pDevice, u8 *pCable, u8 *pChannel, u8 *pType, u8 *pP1, u8 *pP2, bool *bSkip);
 
 class CMIDIDevice
 {
@@ -90,7 +55,7 @@ public:
 	void SetChannel (u8 ucChannel, unsigned nTG);
 	u8 GetChannel (unsigned nTG) const;
 
-	void SetRouteMap (TMIDIRoute *pRouteMap);
+	void SetRouteMap (TMIDIRoute *pRouteMap);	// also from interrupt
 
 	virtual void Send (const u8 *pMessage, size_t nLength, unsigned nCable = 0) {}
 	virtual void SendSystemExclusiveVoice(uint8_t nVoice, const unsigned nCable, uint8_t nTG);
@@ -101,11 +66,21 @@ protected:
 	void MIDIMessageHandler (const u8 *pMessage, size_t nLength, unsigned nCable = 0);
 	void AddDevice (const char *pDeviceName);
 	void HandleSystemExclusive(const uint8_t* pMessage, const size_t nLength, const unsigned nCable, const uint8_t nTG);
+	void BankDumpHandler (const u8 *pHeader, unsigned nCable);	// from CSysExParser
+	void SendThru (const u8 *pMessage, size_t nLength, unsigned nCable = 0);
+	// MIDI thru for the SysEx fragments from CSysExParser, pParam is this
+	static void SysExThruHandler (const u8 *pData, unsigned nLength, void *pParam);
+	void SendProfileData (u8 ucStage, unsigned nCable);
+	void UpdateRouteIndex (void);			// from the main loop only
 
 	virtual void MIDIListener (u8 ucCable, u8 ucChannel, u8 ucType, u8 ucP1, u8 ucP2);
 
+protected:
+	unsigned m_nSysExCable;			// of the SysEx message being parsed
+
 private:
 	bool HandleMIDISystemCC(const u8 ucCC, const u8 ucCCval);
+	void UpdateChannelTGMasks (void);
 
 private:
 	CMiniDexed *m_pSynthesizer;
@@ -113,6 +88,8 @@ private:
 	CUserInterface *m_pUI;
 
 	u8 m_ChannelMap[CConfig::AllToneGenerators];
+	u32 m_ChannelTGMask[Channels];		// TGs listening on a channel (incl. omni)
+	static_assert (CConfig::AllToneGenerators <= 32, "TG mask too small");
 	
 	unsigned m_nMIDISystemCCVol;
 	unsigned m_nMIDISystemCCPan;
@@ -123,6 +100,10 @@ private:
 	std::string m_DeviceName;
 
 	TMIDIRoute *m_pRouteMap;
+	CMIDIRouteIndex *m_pRouteIndex;		// of m_pRouteMap, 0 until built
+	CMIDIRouteIndex *m_pOldRouteIndex;	// to be deleted from the main loop
+	volatile unsigned m_nRouteMapSerial;	// incremented by SetRouteMap()
+	unsigned m_nRouteIndexSerial;		// of the route map, which has been indexed
 
 	typedef std::unordered_map<std::string, CMIDIDevice *> TDeviceMap;
 	static TDeviceMap s_DeviceMap;
@@ -22,22 +22,27 @@
 //
 #include "midikeyboard.h"
 #include <circle/devicenameservice.h>
+#include <circle/logger.h>
 #include <cstring>
 #include <assert.h>
 
 #define DISPLAY_REFRESH_RATE_US 25000
 
+LOGMODULE ("midikeyboard");
+
 CMIDIKeyboard::CMIDIKeyboard (CMiniDexed *pSynthesizer, CConfig *pConfig, CUserInterface *pUI, unsigned nInstance)
 :	CMIDIDevice (pSynthesizer, pConfig, pUI),
-	m_nSysExIdx (0),
 	m_nInstance (nInstance),
 	m_pMIDIDevice (0),
+	m_nReportedSendDropped (0),
 	m_pDAWController (0)
 {
 	m_DeviceName.Format ("umidi%u", nInstance+1);
 
 	AddDevice (m_DeviceName);
 
+	m_SysExParser.SetThruHandler (SysExThruHandler, this);
+
 	if (pConfig->GetDAWControllerEnabled ())
 		m_pDAWController = new CDAWController (pSynthesizer, this, pConfig, pUI);
 }
@@ -49,17 +54,26 @@ CMIDIKeyboard::~CMIDIKeyboard (void)
 
 void CMIDIKeyboard::Process (boolean bPlugAndPlayUpdated)
 {
-	while (!m_SendQueue.empty ())
-	{
-		TSendQueueEntry Entry = m_SendQueue.front ();
-		m_SendQueue.pop ();
+	UpdateRouteIndex ();
 
+	u8 Message[CMIDISendQueue::MaxMessageLength];
+	unsigned nCable;
+	size_t nLength;
+	while ((nLength = m_SendQueue.Get (Message, &nCable)) != 0)
+	{
 		if (m_pMIDIDevice)
 		{
-			m_pMIDIDevice->SendPlainMIDI (Entry.nCable, Entry.pMessage, Entry.nLength);
+			m_pMIDIDevice->SendPlainMIDI (nCable, Message, nLength);
 		}
+	}
 
-		delete [] Entry.pMessage;
+	unsigned nSendDropped = m_SendQueue.GetDropped ();
+	if (nSendDropped != m_nReportedSendDropped)
+	{
+		LOGWARN ("%s: %u messages not sent (high water %u)", (const char *) m_DeviceName,
+			 nSendDropped - m_nReportedSendDropped, m_SendQueue.GetHighWater ());
+
+		m_nReportedSendDropped = nSendDropped;
 	}
 
 	unsigned time = CTimer::GetClockTicks ();
@@ -94,14 +108,13 @@ void CMIDIKeyboard::Process (boolean bPlugAndPlayUpdated)
 
 void CMIDIKeyboard::Send (const u8 *pMessage, size_t nLength, unsigned nCable)
 {
-	TSendQueueEntry Entry;
-	Entry.pMessage = new u8[nLength];
-	Entry.nLength = nLength;
-	Entry.nCable = nCable;
-
-	memcpy (Entry.pMessage, pMessage, nLength);
+	m_SendQueue.Put (pMessage, nLength, nCable,
+			 CMIDISendQueue::GetChannelKeyLength (pMessage, nLength));
+}
 
-	m_SendQueue.push (Entry);
+void CMIDIKeyboard::SendState (const u8 *pMessage, size_t nLength, unsigned nKeyLength, unsigned nCable)
+{
+	m_SendQueue.Put (pMessage, nLength, nCable, nKeyLength);
 }
 
 void CMIDIKeyboard::SendDisplay (const u8 *pMessage, size_t nLength, unsigned nCable)
@@ -114,67 +127,58 @@ void CMIDIKeyboard::SendDisplay (const u8 *pMessage, size_t nLength, unsigned nC
 }
 
 // Most packets will be passed straight onto the main MIDI message handler
-// but SysEx messages are multiple USB packets and so will need building up
-// before parsing.
+// but SysEx messages are multiple USB packets and so will be parsed while
+// they arrive.
 void CMIDIKeyboard::USBMIDIMessageHandler (u8 *pPacket, unsigned nLength, unsigned nCable, unsigned nDevice)
 {
 	assert (nDevice == m_nInstance + 1);
 
-	if ((pPacket[0] == 0xF0) && (m_nSysExIdx == 0))
+	if (   pPacket[0] != 0xF0
+	    && !m_SysExParser.IsActive ())
 	{
-		// Start of SysEx message
-		//printf("SysEx Start  Idx=%d, (%d)\n", m_nSysExIdx, nLength);
-		for (unsigned i=0; i<USB_SYSEX_BUFFER_SIZE; i++) {
-			m_SysEx[i] = 0;
-		}
-		for (unsigned i=0; i<nLength; i++) {
-			m_SysEx[m_nSysExIdx++] = pPacket[i];
-		}
+		// Assume it is a standard message
+		MIDIMessageHandler (pPacket, nLength, nCable);
+
+		return;
 	}
-	else if (m_nSysExIdx != 0)
+
+	m_nSysExCable = nCable;
+
+	for (unsigned i = 0; i < nLength; i++)
 	{
-		// Continue processing SysEx message
-		//printf("SysEx Packet Idx=%d, (%d)\n", m_nSysExIdx, nLength);
-		for (unsigned i=0; i<nLength; i++) {
-			if (pPacket[i] == 0xF8 || pPacket[i] == 0xFA || pPacket[i] == 0xFB || pPacket[i] == 0xFC || pPacket[i] == 0xFE || pPacket[i] == 0xFF) {
-				// Singe-byte System Realtime Messages can happen at any time!
-				MIDIMessageHandler (&pPacket[i], 1, nCable);
-			}
-			else if (m_nSysExIdx >= USB_SYSEX_BUFFER_SIZE) {
-				// Run out of space, so reset and ignore rest of the message
-				m_nSysExIdx = 0;
-				break;
-			}
-			else if (pPacket[i] == 0xF7) {
-				// End of SysEx message
-				m_SysEx[m_nSysExIdx++] = pPacket[i];
-				//printf ("SysEx End    Idx=%d\n", m_nSysExIdx);
-				MIDIMessageHandler (m_SysEx, m_nSysExIdx, nCable);
+		switch (m_SysExParser.Put (pPacket[i]))
+		{
+		case CSysExParser::StatusMessage:
+			MIDIMessageHandler (m_SysExParser.GetMessage (), m_SysExParser.GetLength (), nCable);
 
-				if (m_pDAWController)
-					m_pDAWController->MIDISysexHandler (m_SysEx, m_nSysExIdx, nCable);
+			if (m_pDAWController)
+				m_pDAWController->MIDISysexHandler (m_SysExParser.GetMessage (),
+								    m_SysExParser.GetLength (), nCable);
+			break;
 
-				// Reset ready for next time
-				m_nSysExIdx = 0;
-			}
-			else if ((pPacket[i] & 0x80) != 0) {
-				// Received another command, so reset processing as something has gone wrong
-				//printf ("SysEx Reset\n");
-				m_nSysExIdx = 0;
-				break;
+		case CSysExParser::StatusBankDump:
+			BankDumpHandler (m_SysExParser.GetMessage (), nCable);
+			break;
+
+		case CSysExParser::StatusIgnored:
+			if (CSysExParser::IsRealtime (pPacket[i]))
+			{
+				// Singe-byte System Realtime Messages can happen at any time!
+				MIDIMessageHandler (&pPacket[i], 1, nCable);
 			}
 			else
 			{
-				// Store the byte
-				m_SysEx[m_nSysExIdx++] = pPacket[i];
+				// Received another command, which has ended the SysEx message
+				MIDIMessageHandler (&pPacket[i], nLength - i, nCable);
+
+				return;
 			}
+			break;
+
+		default:
+			break;
 		}
 	}
-	else
-	{
-		// Assume it is a standard message
-		MIDIMessageHandler (pPacket, nLength, nCable);
-	}
 }
 
 void CMIDIKeyboard::MIDIPacketHandler (unsigned nCable, u8 *pPacket, unsigned nLength, unsigned nDevice, void *pParam)
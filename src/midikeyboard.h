@@ -24,20 +24,18 @@
 #define _midikeyboard_h
 
 #include "mididevice.h"
+#include "midisendqueue.h"
 #include "config.h"
 #include <circle/usb/usbmidi.h>
 #include <circle/device.h>
 #include <circle/types.h>
 #include "../circle-stdlib/libs/circle/include/circle/string.h"
 #include "../circle-stdlib/libs/fatfs/ff.h"
-#include <queue>
 
 // Forward declarations
 class CDAWController;
 class CUIMenu;
 
-#define USB_SYSEX_BUFFER_SIZE (MAX_DX7_SYSEX_LENGTH+128) // Allow a bit spare to handle unexpected SysEx messages
-
 class CMiniDexed;
 
 class CMIDIKeyboard : public CMIDIDevice
@@ -49,8 +47,13 @@ public:
 	void Process (boolean bPlugAndPlayUpdated);
 
 	void Send (const u8 *pMessage, size_t nLength, unsigned nCable = 0) override;
+	// sends a state update, which replaces a pending message with the same
+	// length and the same first nKeyLength bytes (e.g. a pad colour)
+	void SendState (const u8 *pMessage, size_t nLength, unsigned nKeyLength, unsigned nCable = 0);
 	void SendDisplay (const u8 *pMessage, size_t nLength, unsigned nCable = 0);
 
+	unsigned GetSendHighWater (void) const	{ return m_SendQueue.GetHighWater (); }
+
 	void DisplayWrite (const char *pMenu, const char *pParam, const char *pValue,
 			   bool bArrowDown, bool bArrowUp);
 	
@@ -74,8 +77,7 @@ private:
 		size_t	 nLength;
 		unsigned nCable;
 	};
-	uint8_t m_SysEx[USB_SYSEX_BUFFER_SIZE];
-	unsigned m_nSysExIdx;
+	CSysExParser m_SysExParser;
 
 private:
 	unsigned m_nInstance;
@@ -83,7 +85,8 @@ private:
 
 	CUSBMIDIDevice * volatile m_pMIDIDevice;
 
-	std::queue<TSendQueueEntry> m_SendQueue;
+	CMIDISendQueue m_SendQueue;
+	unsigned m_nReportedSendDropped;
 	u8 m_LastMessage[256];
 	TSendQueueEntry m_LastDisplayEntry = {m_LastMessage, 0, 0};
 	unsigned m_LastDisplayRefreshTime = 0;
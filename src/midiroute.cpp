@@ -0,0 +1,284 @@
+//
+// midiroute.cpp
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2024  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "midiroute.h"
+#include <string.h>
+#include <assert.h>
+
+static bool RouteMatch (u8 ucSP, u8 ucP)
+{
+	return ucSP == ucP ||
+		ucSP == 0xFF ||
+		(ucSP == TMIDIRoute::LtCenter && ucP < 64) ||
+		(ucSP == TMIDIRoute::GtCenter && ucP > 64) ||
+		(ucSP == TMIDIRoute::Betw00n07 && ucP <= 7) ||
+		(ucSP == TMIDIRoute::Betw08n15 && ucP >= 8 && ucP <= 15) ||
+		(ucSP == TMIDIRoute::Betw16n23 && ucP >= 16 && ucP <= 23);
+}
+
+CMIDIRouteIndex::CMIDIRouteIndex (void)
+:	m_bValid (false)
+{
+	memset (m_nFirstSegment, 0, sizeof m_nFirstSegment);
+}
+
+void CMIDIRouteIndex::Build (const TMIDIRoute *pRouteMap)
+{
+	assert (pRouteMap);
+
+	m_bValid = false;
+	memset (m_nFirstSegment, 0, sizeof m_nFirstSegment);
+	m_Segments.clear ();
+	m_Routes.clear ();
+
+	unsigned nRoutes = 0;
+	for (const TMIDIRoute *r = pRouteMap; r->ucSCable != 0xFF; r++, nRoutes++)
+	{
+		if (r->ucSCable >= Cables)
+		{
+			return;
+		}
+	}
+
+	if (nRoutes > 0xFFFF)
+	{
+		return;
+	}
+
+	std::vector<u16> Matching;
+	for (unsigned nKey = 0; nKey < Keys; nKey++)
+	{
+		m_nFirstSegment[nKey] = m_Segments.size ();
+
+		unsigned nCable = nKey / (Channels * Types);
+		unsigned nChannel = nKey / Types % Channels;
+		unsigned nType = nKey % Types;
+
+		Matching.clear ();
+		for (unsigned i = 0; i < nRoutes; i++)
+		{
+			const TMIDIRoute *r = &pRouteMap[i];
+			if (   r->ucSCable == nCable
+			    && (r->ucSCh == nChannel || r->ucSCh >= 16)
+			    && (r->ucSType == nType || r->ucSType >= 16))
+			{
+				Matching.push_back (i);
+			}
+		}
+
+		if (Matching.empty ())
+		{
+			continue;
+		}
+
+		// a new segment starts, where a route starts or stops to match
+		for (unsigned nP1 = 0; nP1 < Values; nP1++)
+		{
+			bool bChange = nP1 == 0;
+			for (unsigned i = 0; !bChange && i < Matching.size (); i++)
+			{
+				u8 ucSP1 = pRouteMap[Matching[i]].ucSP1;
+				bChange = RouteMatch (ucSP1, nP1) != RouteMatch (ucSP1, nP1-1);
+			}
+
+			if (!bChange)
+			{
+				continue;
+			}
+
+			unsigned nOffset = m_Routes.size ();
+			for (u16 nRoute : Matching)
+			{
+				if (RouteMatch (pRouteMap[nRoute].ucSP1, nP1))
+				{
+					m_Routes.push_back (nRoute);
+				}
+			}
+
+			unsigned nCount = m_Routes.size () - nOffset;
+			if (   nCount > 0xFF
+			    || m_Routes.size () > 0xFFFF
+			    || m_Segments.size () >= 0xFFFF)
+			{
+				return;
+			}
+
+			m_Segments.push_back ({(u16) nOffset, (u8) nP1, (u8) nCount});
+		}
+	}
+
+	m_nFirstSegment[Keys] = m_Segments.size ();
+
+	m_bValid = true;
+}
+
+bool CMIDIRouteIndex::Lookup (u8 ucCable, u8 ucChannel, u8 ucType, u8 ucP1,
+			      const u16 **ppRoutes, unsigned *pCount) const
+{
+	assert (ppRoutes);
+	assert (pCount);
+
+	if (   !m_bValid
+	    || ucChannel >= Channels
+	    || ucType >= Types
+	    || ucP1 >= Values)
+	{
+		return false;
+	}
+
+	*ppRoutes = 0;
+	*pCount = 0;
+
+	if (ucCable >= Cables)
+	{
+		return true;			// there is no route for this cable
+	}
+
+	unsigned nKey = (ucCable * Channels + ucChannel) * Types + ucType;
+	unsigned nFirst = m_nFirstSegment[nKey];
+	unsigned nEnd = m_nFirstSegment[nKey+1];
+	if (nFirst == nEnd)
+	{
+		return true;
+	}
+
+	// the last segment, which starts at or below P1 (the first starts at 0)
+	while (   nFirst+1 < nEnd
+	       && m_Segments[nFirst+1].ucFirstP1 <= ucP1)
+	{
+		nFirst++;
+	}
+
+	const TSegment &rSegment = m_Segments[nFirst];
+	if (rSegment.ucCount > 0)
+	{
+		*ppRoutes = &m_Routes[rSegment.nOffset];
+		*pCount = rSegment.ucCount;
+	}
+
+	return true;
+}
+
+size_t CMIDIRouteIndex::GetMemory (void) const
+{
+	return   sizeof *this
+	       + m_Segments.capacity () * sizeof (TSegment)
+	       + m_Routes.capacity () * sizeof (u16);
+}
+
+// returns true, if the route has been applied, false to continue with the next route
+static bool ApplyRoute (TMIDIRoute *pRouteMap, TMIDIRoute *r,
+			TKernelTimerHandler *pTimerHandler, void *pTimerParam,
+			u8 *pCh, u8 *pType, u8 *pP1, u8 *pP2, bool *bSkip)
+{
+	if (r->usTimerExpire)
+		r->hTimer = CTimer::Get ()->StartKernelTimer (MSEC2HZ(r->usTimerExpire), pTimerHandler, pTimerParam, r);
+
+	if (r->usTimerExpire || r->bGroupHead)
+		r->bGroupActive = true;
+
+	if (r->bSkip) {
+		*bSkip = true;
+		return true;
+	}
+
+	if (r->bGroup) {
+		TMIDIRoute *parent = r - 1;
+		for (; parent > pRouteMap && parent->bGroup; parent--);
+
+		if (parent->hTimer) {
+			CTimer::Get ()->CancelKernelTimer (parent->hTimer);
+			parent->hTimer = 0;
+		}
+
+		if (!r->bGroupHold)
+			parent->bGroupHold = false;
+
+		if (!parent->bGroupActive && !parent->bGroupHold) {
+			// skip at the end if not captured by other routes
+			*bSkip = true;
+			return false;
+		}
+
+		// hold the group for bGroupHold routes
+		if (r->bGroupHold)
+			parent->bGroupHold = true;
+
+		parent->bGroupActive = false;
+	}
+
+	*pCh = r->ucDCh;
+	*pType = r->ucDType;
+	if (r->ucDP1 <= 127)
+		*pP1 = r->ucDP1;
+	if (r->ucDP1 == TMIDIRoute::P2)
+		*pP1 = *pP2;
+	if (r->ucDP2 <= 127)
+		*pP2 = r->ucDP2;
+	if (r->bToggle)
+		r->ucDP2 = r->ucDP2 ? 0x0 : 0x7F;
+	*bSkip = false;
+	return true;
+}
+
+void GetRoutedMIDI (TMIDIRoute *pRouteMap, const CMIDIRouteIndex *pIndex,
+		    TKernelTimerHandler *pTimerHandler, void *pTimerParam,
+		    u8 *pCable, u8 *pCh, u8 *pType, u8 *pP1, u8 *pP2, bool *bSkip)
+{
+	assert (pRouteMap);
+
+	const u16 *pRoutes;
+	unsigned nCount;
+	if (pIndex && pIndex->Lookup (*pCable, *pCh, *pType, *pP1, &pRoutes, &nCount))
+	{
+		// the candidates match cable, channel, type and P1 already
+		for (unsigned i = 0; i < nCount; i++)
+		{
+			TMIDIRoute *r = pRouteMap + pRoutes[i];
+			if (RouteMatch (r->ucSP2, *pP2) &&
+			    ApplyRoute (pRouteMap, r, pTimerHandler, pTimerParam, pCh, pType, pP1, pP2, bSkip))
+			{
+				return;
+			}
+		}
+
+		return;
+	}
+
+	for (TMIDIRoute *r = pRouteMap; r->ucSCable != 0xFF ; r++)
+	{
+		if (r->ucSCable == *pCable &&
+			(r->ucSCh == *pCh || r->ucSCh >= 16) &&
+			(r->ucSType == *pType || r->ucSType >= 16) &&
+			RouteMatch (r->ucSP1, *pP1) &&
+			RouteMatch (r->ucSP2, *pP2) &&
+			ApplyRoute (pRouteMap, r, pTimerHandler, pTimerParam, pCh, pType, pP1, pP2, bSkip)
+			)
+		{
+			return;
+		}
+	}
+}
+
+TMIDIRoute::~TMIDIRoute ()
+{
+	if (hTimer)
+		CTimer::Get ()->CancelKernelTimer (hTimer);
+	hTimer = 0;
+}
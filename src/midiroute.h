@@ -0,0 +1,118 @@
+//
+// midiroute.h
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2024  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _midiroute_h
+#define _midiroute_h
+
+#include <circle/types.h>
+#include <circle/timer.h>
+#include <vector>
+
+struct TMIDIRoute
+{
+	~TMIDIRoute ();
+
+	enum TRouteOP
+	{
+		P2 = 0x82,
+		LtCenter = 0x90,
+		GtCenter = 0x91,
+		Betw00n07 = 0x92,
+		Betw08n15 = 0x93,
+		Betw16n23 = 0x94
+	};
+
+	u8 ucSCable;
+	u8 ucSCh;
+	u8 ucSType;
+	u8 ucSP1;
+	u8 ucSP2;
+	u8 ucDCh;
+	u8 ucDType;
+	u8 ucDP1;
+	u8 ucDP2;
+	u8 ucTimerTarget;
+	unsigned usTimerExpire;
+	TKernelTimerHandle hTimer;
+	bool bSkip;
+	bool bToggle;
+	bool bGroup;
+	bool bGroupHead;
+	bool bGroupActive;
+	bool bGroupHold; // hold flag for GroupHeads, or set hold the group
+};
+
+// Index of a route map, which is terminated with ucSCable == 0xFF. For each
+// cable, channel, type and P1 it holds the routes, which match these, in the
+// order of the route map. The channel and type wildcards are expanded. The
+// P1 values of a cable, channel and type are split into segments, in which
+// the same routes match (the P1 wildcard and the range operators LtCenter,
+// GtCenter and BetwNNnNN give one segment each), so that a lookup is a table
+// access and a short search of the segments. Only P2 is left to be matched
+// by the caller. The source fields of the routes must not change after
+// Build(), the destination fields and flags may.
+
+class CMIDIRouteIndex
+{
+public:
+	static const unsigned Cables = 16;
+	static const unsigned Channels = 16;
+	static const unsigned Types = 16;
+	static const unsigned Values = 128;
+
+public:
+	CMIDIRouteIndex (void);
+
+	void Build (const TMIDIRoute *pRouteMap);
+
+	// returns false, if the message cannot be looked up (the route map has
+	// to be scanned), otherwise the indices of the matching routes
+	bool Lookup (u8 ucCable, u8 ucChannel, u8 ucType, u8 ucP1,
+		     const u16 **ppRoutes, unsigned *pCount) const;
+
+	size_t GetMemory (void) const;		// in bytes
+
+private:
+	static const unsigned Keys = Cables * Channels * Types;
+
+	struct TSegment
+	{
+		u16 nOffset;			// into m_Routes
+		u8 ucFirstP1;			// up to ucFirstP1 of the next segment
+		u8 ucCount;
+	};
+
+private:
+	bool m_bValid;			// all cables, routes and segments are in range
+
+	// the segments of key k are m_Segments[m_nFirstSegment[k]] up to
+	// m_Segments[m_nFirstSegment[k+1]-1], none, if there is no route
+	u16 m_nFirstSegment[Keys+1];
+	std::vector<TSegment> m_Segments;	// by key and P1
+	std::vector<u16> m_Routes;
+};
+
+// Applies the first matching route to the message. Routes with a timer call
+// pTimerHandler with pTimerParam and the route as context. With pIndex the
+// route map is not scanned.
+void GetRoutedMIDI (TMIDIRoute *pRouteMap, const CMIDIRouteIndex *pIndex,
+		    TKernelTimerHandler *pTimerHandler, void *pTimerParam,
+		    u8 *pCable, u8 *pChannel, u8 *pType, u8 *pP1, u8 *pP2, bool *bSkip);
+
+#endif
@@ -0,0 +1,223 @@
+//
+// midisendqueue.cpp
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2024  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "midisendqueue.h"
+#include <string.h>
+#include <assert.h>
+
+static_assert (CMIDISendQueue::BufferSize <= 0x10000, "Offsets must fit into u16");
+
+CMIDISendQueue::CMIDISendQueue (void)
+:	m_nHead (0),
+	m_nCount (0),
+	m_nWrite (0),
+	m_nHighWater (0),
+	m_nCoalesced (0),
+	m_nDropped (0)
+{
+}
+
+bool CMIDISendQueue::Put (const u8 *pMessage, size_t nLength, unsigned nCable, unsigned nKeyLength)
+{
+	assert (pMessage);
+	assert (nKeyLength <= nLength);
+
+	if (nLength == 0)
+	{
+		return true;
+	}
+
+	m_SpinLock.Acquire ();
+
+	if (nKeyLength > 0 && Coalesce (pMessage, nLength, nCable, nKeyLength))
+	{
+		m_nCoalesced++;
+
+		m_SpinLock.Release ();
+
+		return true;
+	}
+
+	unsigned nOffset;
+	if (   nLength > MaxMessageLength
+	    || m_nCount == MaxEntries
+	    || (nOffset = Allocate (nLength)) == BufferSize)
+	{
+		m_nDropped++;
+
+		m_SpinLock.Release ();
+
+		return false;
+	}
+
+	memcpy (&m_Buffer[nOffset], pMessage, nLength);
+	m_nWrite = nOffset + nLength;
+
+	TEntry *pEntry = &m_Entries[(m_nHead + m_nCount) % MaxEntries];
+	pEntry->nOffset = nOffset;
+	pEntry->nLength = nLength;
+	pEntry->nCable = nCable;
+	pEntry->nKeyLength = nKeyLength;
+
+	if (++m_nCount > m_nHighWater)
+	{
+		m_nHighWater = m_nCount;
+	}
+
+	m_SpinLock.Release ();
+
+	return true;
+}
+
+size_t CMIDISendQueue::Get (u8 *pBuffer, unsigned *pCable)
+{
+	assert (pBuffer);
+	assert (pCable);
+
+	m_SpinLock.Acquire ();
+
+	if (m_nCount == 0)
+	{
+		m_SpinLock.Release ();
+
+		return 0;
+	}
+
+	const TEntry *pEntry = &m_Entries[m_nHead];
+	size_t nLength = pEntry->nLength;
+	memcpy (pBuffer, &m_Buffer[pEntry->nOffset], nLength);
+	*pCable = pEntry->nCable;
+
+	m_nHead = (m_nHead + 1) % MaxEntries;
+	if (--m_nCount == 0)
+	{
+		m_nHead = 0;
+		m_nWrite = 0;
+	}
+
+	m_SpinLock.Release ();
+
+	return nLength;
+}
+
+unsigned CMIDISendQueue::GetChannelKeyLength (const u8 *pMessage, size_t nLength)
+{
+	assert (pMessage);
+
+	if (nLength == 0)
+	{
+		return 0;
+	}
+
+	switch (pMessage[0] & 0xF0)
+	{
+	case 0xA0:				// poly pressure: note
+		return nLength == 3 ? 2 : 0;
+
+	case 0xB0:				// control change: controller
+		if (nLength != 3)
+		{
+			return 0;
+		}
+
+		// bank select, data entry and (N)RPN numbers take effect
+		// in combination with other messages, mode messages are events
+		switch (pMessage[1])
+		{
+		case 0: case 32:
+		case 6: case 38:
+		case 96: case 97: case 98: case 99: case 100: case 101:
+			return 0;
+
+		default:
+			return pMessage[1] < 120 ? 2 : 0;
+		}
+
+	case 0xD0:				// channel pressure
+		return nLength == 2 ? 1 : 0;
+
+	case 0xE0:				// pitch bend
+		return nLength == 3 ? 1 : 0;
+
+	default:
+		return 0;
+	}
+}
+
+// called with the spin lock acquired, searches from the newest message back
+// to the last event on the cable
+bool CMIDISendQueue::Coalesce (const u8 *pMessage, size_t nLength, unsigned nCable, unsigned nKeyLength)
+{
+	for (unsigned i = m_nCount; i-- > 0; )
+	{
+		const TEntry *pEntry = &m_Entries[(m_nHead + i) % MaxEntries];
+
+		if (pEntry->nCable != nCable)
+		{
+			continue;
+		}
+
+		if (pEntry->nKeyLength == 0)
+		{
+			return false;
+		}
+
+		if (   pEntry->nKeyLength == nKeyLength
+		    && pEntry->nLength == nLength
+		    && memcmp (&m_Buffer[pEntry->nOffset], pMessage, nKeyLength) == 0)
+		{
+			memcpy (&m_Buffer[pEntry->nOffset], pMessage, nLength);
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// called with the spin lock acquired, the messages are kept contiguous
+// and the space at the end of the buffer is skipped, if it is too small
+unsigned CMIDISendQueue::Allocate (size_t nLength)
+{
+	if (m_nCount == 0)
+	{
+		return 0;
+	}
+
+	unsigned nRead = m_Entries[m_nHead].nOffset;
+
+	if (m_nWrite > nRead)
+	{
+		if (m_nWrite + nLength <= BufferSize)
+		{
+			return m_nWrite;
+		}
+
+		if (nLength <= nRead)
+		{
+			return 0;
+		}
+	}
+	else if (m_nWrite + nLength <= nRead)
+	{
+		return m_nWrite;
+	}
+
+	return BufferSize;
+}
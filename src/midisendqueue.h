@@ -0,0 +1,94 @@
+//
+// midisendqueue.h
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2024  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _midisendqueue_h
+#define _midisendqueue_h
+
+#include <circle/spinlock.h>
+#include <circle/types.h>
+#include <stddef.h>
+
+// Queue of outgoing MIDI messages, which does not use the heap. The message
+// bytes are kept in a ring buffer, the messages are described by a ring of
+// entries.
+//
+// A message may carry a key length. If a message with the same cable,
+// length and first nKeyLength bytes is still pending, it is overwritten in
+// place instead of queuing another one, so that only the latest state is
+// sent (e.g. for a controller value or a pad colour). This is only done, if
+// no message with key length 0 (an event like a note on) has been queued
+// on the same cable after it, so that the state does not move ahead of the
+// event. Messages with key length 0 are never coalesced.
+//
+// Put() may be called from interrupt context.
+
+class CMIDISendQueue
+{
+public:
+	static const unsigned MaxEntries = 256;
+	static const unsigned BufferSize = 8192;
+	static const unsigned MaxMessageLength = 512;
+
+public:
+	CMIDISendQueue (void);
+
+	// returns false, if the queue is full and the message has been dropped
+	bool Put (const u8 *pMessage, size_t nLength, unsigned nCable, unsigned nKeyLength = 0);
+
+	// copies the oldest message to pBuffer (MaxMessageLength bytes),
+	// returns its length or 0, if the queue is empty
+	size_t Get (u8 *pBuffer, unsigned *pCable);
+
+	unsigned GetHighWater (void) const	{ return m_nHighWater; }	// entries
+	unsigned GetCoalesced (void) const	{ return m_nCoalesced; }
+	unsigned GetDropped (void) const	{ return m_nDropped; }
+
+	// key length for channel messages, which only transport a state
+	// (controller, pitch bend, pressure), 0 for all others
+	static unsigned GetChannelKeyLength (const u8 *pMessage, size_t nLength);
+
+private:
+	bool Coalesce (const u8 *pMessage, size_t nLength, unsigned nCable, unsigned nKeyLength);
+
+	unsigned Allocate (size_t nLength);		// returns offset or BufferSize
+
+private:
+	struct TEntry
+	{
+		u16 nOffset;
+		u16 nLength;
+		u8 nCable;
+		u8 nKeyLength;
+	};
+
+	TEntry m_Entries[MaxEntries];
+	unsigned m_nHead;			// oldest entry
+	unsigned m_nCount;
+
+	u8 m_Buffer[BufferSize];
+	unsigned m_nWrite;			// next free byte
+
+	unsigned m_nHighWater;
+	unsigned m_nCoalesced;
+	unsigned m_nDropped;
+
+	CSpinLock m_SpinLock;
+};
+
+#endif
@@ -24,14 +24,19 @@
 #include <circle/sound/i2ssoundbasedevice.h>
 #include <circle/sound/hdmisoundbasedevice.h>
 #include <circle/gpiopin.h>
+#include <circle/synchronize.h>
 #include <string.h>
 #include <stdio.h>
 #include <assert.h>
+#include <iostream>
+#include <sstream>
 
 #include "arm_float_to_q23.h"
 
 LOGMODULE ("minidexed");
 
+static_assert (CConfig::AllToneGenerators <= CVoicePool::MaxToneGenerators, "Voice pool too small");
+
 CMiniDexed::CMiniDexed (CConfig *pConfig, CInterruptSystem *pInterrupt,
 			CGPIOManager *pGPIOManager, CI2CMaster *pI2CMaster, CSPIMaster *pSPIMaster, FATFS *pFileSystem)
 :
@@ -40,19 +45,21 @@ CMiniDexed::CMiniDexed (CConfig *pConfig, CInterruptSystem *pInterrupt,
 #endif
 	m_pConfig (pConfig),
 	m_UI (this, pGPIOManager, pI2CMaster, pSPIMaster, pConfig),
+	m_VoiceCache (&m_SysExFileLoader),
 	m_PerformanceConfig (pFileSystem),
 	m_PCKeyboard (this, pConfig, &m_UI),
 	m_SerialMIDI (this, pInterrupt, pConfig, &m_UI),
 	m_bUseSerial (false),
 	m_bQuadDAC8Chan (false),
 	m_pSoundDevice (0),
+	m_pDirectSoundDevice (0),
+	m_pOutputBuffer (0),
 	m_bChannelsSwapped (pConfig->GetChannelsSwapped ()),
 #ifdef ARM_ALLOW_MULTI_CORE
 //	m_nActiveTGsLog2 (0),
 #endif
-	m_GetChunkTimer ("GetChunk",
-			 1000000U * pConfig->GetChunkSize ()/2 / pConfig->GetSampleRate ()),
 	m_bProfileEnabled (m_pConfig->GetProfileEnabled ()),
+	m_nLastProfileDumpTicks (0),
 	m_bSavePerformance (false),
 	m_bSavePerformanceNewFile (false),
 	m_bSetNewPerformance (false),
@@ -67,12 +74,21 @@ CMiniDexed::CMiniDexed (CConfig *pConfig, CInterruptSystem *pInterrupt,
 	m_nToneGenerators = m_pConfig->GetToneGenerators();
 	m_nPolyphony = m_pConfig->GetPolyphony();
 	LOGNOTE("Tone Generators=%d, Polyphony=%d", m_nToneGenerators, m_nPolyphony);
+	m_VoicePool.Initialize (m_pConfig->GetVoicePool ());
+	if (m_VoicePool.IsEnabled ())
+	{
+		LOGNOTE ("Voice pool with %u voices", m_VoicePool.GetSize ());
+	}
+
+	m_PolyphonyGovernor.Initialize (m_VoicePool.IsEnabled () ? m_VoicePool.GetSize () : m_nPolyphony,
+					m_pConfig->GetPolyphonyGovernor ());
 
 	for (unsigned i = 0; i < CConfig::AllToneGenerators; i++)
 	{
 		m_nVoiceBankID[i] = 0;
 		m_nVoiceBankIDMSB[i] = 0;
 		m_nProgram[i] = 0;
+		m_nPendingProgram[i] = NoPendingProgram;
 		m_nVolume[i] = 100;
 		m_nExpression[i] = 127;
 		m_nPan[i] = 64;
@@ -89,6 +105,10 @@ CMiniDexed::CMiniDexed (CConfig *pConfig, CInterruptSystem *pInterrupt,
 		m_nNoteLimitLow[i] = 0;
 		m_nNoteLimitHigh[i] = 127;
 		m_nNoteShift[i] = 0;
+		m_nMinVoices[i] = 0;
+		m_nMaxVoices[i] = 0;
+		m_nTGVoices[i] = 0;
+		m_nDroppedEvents[i] = 0;
 		
 		m_nModulationWheelRange[i]=99;
 		m_nModulationWheelTarget[i]=7;
@@ -108,9 +128,18 @@ CMiniDexed::CMiniDexed (CConfig *pConfig, CInterruptSystem *pInterrupt,
 		{
 			m_uchOPMask[i] = 0b111111;	// All operators on
 
-			m_pTG[i] = new CDexedAdapter (m_nPolyphony, pConfig->GetSampleRate ());
+			// with the voice pool, each TG starts with Polyphony voices
+			// and grows on demand up to the whole pool
+			m_nTGVoices[i] = m_VoicePool.IsEnabled () ? GetInitialTGVoices (i) : m_nPolyphony;
+
+			m_pTG[i] = new CDexedAdapter (m_nTGVoices[i], pConfig->GetSampleRate ());
 			assert (m_pTG[i]);
 
+			if (m_VoicePool.IsEnabled ())
+			{
+				m_pTG[i]->setVoicePool (&m_VoicePool, i);
+			}
+
 			m_pTG[i]->setEngineType(pConfig->GetEngineType ());
 			m_pTG[i]->activate ();
 		}
@@ -177,6 +206,18 @@ CMiniDexed::CMiniDexed (CConfig *pConfig, CInterruptSystem *pInterrupt,
 		}
 		if (m_bQuadDAC8Chan) {
 			LOGNOTE ("Configured for Quad DAC 8-channel Mono audio");
+		}
+		if (pConfig->GetDirectSoundOutput ())
+		{
+			LOGNOTE ("Direct sound output enabled");
+
+			m_pDirectSoundDevice = new CDirectI2SSoundDevice (pInterrupt, pConfig->GetSampleRate (),
+									  pConfig->GetChunkSize (),
+									  pI2CMaster, pConfig->GetDACI2CAddress (),
+									  m_bQuadDAC8Chan ? 8 : 2);
+			m_pSoundDevice = m_pDirectSoundDevice;
+		}
+		else if (m_bQuadDAC8Chan) {
 			m_pSoundDevice = new CI2SSoundBaseDevice (pInterrupt, pConfig->GetSampleRate (),
 								  pConfig->GetChunkSize (), false,
 								  pI2CMaster, pConfig->GetDACI2CAddress (),
@@ -218,19 +259,61 @@ CMiniDexed::CMiniDexed (CConfig *pConfig, CInterruptSystem *pInterrupt,
 #ifdef ARM_ALLOW_MULTI_CORE
 	for (unsigned nCore = 0; nCore < CORES; nCore++)
 	{
-		m_CoreStatus[nCore] = CoreStatusInit;
+		m_CoreStatus[nCore].Status = CoreStatusInit;
+	}
+
+	m_bInitialized = false;
+
+	for (unsigned nTG = 0; nTG < CConfig::AllToneGenerators; nTG++)
+	{
+		m_nTGJobOrder[nTG] = nTG;
+		m_TGJobState[nTG].nRenderTicks = 0;
+		m_TGJobState[nTG].bRendered[0] = false;
+		m_TGJobState[nTG].bRendered[1] = false;
+		m_pOutputLevel[0][nTG] = 0;
+		m_pOutputLevel[1][nTG] = 0;
+	}
+	m_nNextTGJob = 0;
+
+	m_bPipelinedRender = pConfig->GetPipelinedRender ();
+	m_nRenderBuffer = 0;
+	m_nMixFrames = 0;
+	if (m_bPipelinedRender)
+	{
+		LOGNOTE ("Pipelined rendering enabled");
 	}
 #endif
 
+	m_bSampleAccurateMIDI = pConfig->GetSampleAccurateMIDI ();
+	m_nNextChunkStartTicks = 0;
+	m_nChunkStartTicks = 0;
+	if (m_bSampleAccurateMIDI)
+	{
+		LOGNOTE ("Sample accurate MIDI enabled");
+	}
+
+	static const char *ProfileStageName[ProfileStageTG1] =
+		{"GetChunk", "RenderWait", "Mix", "Reverb", "Output", "Write"};
+	unsigned nDeadlineMicros = 1000000U * pConfig->GetChunkSize ()/2 / pConfig->GetSampleRate ();
+	for (unsigned i = 0; i < ProfileStageUnknown; i++)
+	{
+		std::string Name = i < ProfileStageTG1 ? ProfileStageName[i]
+				 : i == ProfileStageProgramChange ? "ProgramChange"
+				 : "TG" + std::to_string (i - ProfileStageTG1 + 1);
+		// only the whole chunk has to meet the deadline
+		m_pProfileTimer[i] = new CPerformanceTimer (Name.c_str (),
+							    i == ProfileStageChunk ? nDeadlineMicros : 0);
+		assert (m_pProfileTimer[i]);
+	}
+
 	float masterVolNorm = (float)(pConfig->GetMasterVolume()) / 127.0f;
 	setMasterVolume(masterVolNorm);
 
 	// BEGIN setup tg_mixer
-	tg_mixer = new AudioStereoMixer<CConfig::AllToneGenerators>(pConfig->GetChunkSize()/2);
+	tg_mixer = new AudioStereoSendMixer<CConfig::AllToneGenerators>(CConfig::MaxChunkSize);	// max. queue frames
 	// END setup tgmixer
 
 	// BEGIN setup reverb
-	reverb_send_mixer = new AudioStereoMixer<CConfig::AllToneGenerators>(pConfig->GetChunkSize()/2);
 	reverb = new AudioEffectPlateReverb(pConfig->GetSampleRate());
 	SetParameter (ParameterReverbEnable, 1);
 	SetParameter (ParameterReverbSize, 70);
@@ -258,6 +341,14 @@ bool CMiniDexed::Initialize (void)
 		return false;
 	}
 
+#ifdef ARM_ALLOW_MULTI_CORE
+	// start secondary cores, they help parsing the voice banks first
+	if (!CMultiCoreSupport::Initialize ())
+	{
+		return false;
+	}
+#endif
+
 	m_SysExFileLoader.Load (m_pConfig->GetHeaderlessSysExVoices ());
 
 	if (m_SerialMIDI.Initialize ())
@@ -300,8 +391,7 @@ bool CMiniDexed::Initialize (void)
 		
 		tg_mixer->pan(i,mapfloat(m_nPan[i],0,127,0.0f,1.0f));
 		tg_mixer->gain(i,1.0f);
-		reverb_send_mixer->pan(i,mapfloat(m_nPan[i],0,127,0.0f,1.0f));
-		reverb_send_mixer->gain(i,mapfloat(m_nReverbSend[i],0,99,0.0f,1.0f));
+		tg_mixer->send(i,mapfloat(m_nReverbSend[i],0,99,0.0f,1.0f));
 	}
 
 	m_PerformanceConfig.Init(m_nToneGenerators);
@@ -331,30 +421,110 @@ bool CMiniDexed::Initialize (void)
 	// contains a sample for each of all the channels.
 	//
 	// See discussion here: https://github.com/rsta2/circle/discussions/453
-	if (!m_pSoundDevice->AllocateQueueFrames (2 * m_pConfig->GetChunkSize () / Channels))
+	if (m_pDirectSoundDevice)
 	{
-		LOGERR ("Cannot allocate sound queue");
-
-		return false;
+		// No queue, the audio path writes into the two DMA sized blocks
+		// of the device directly (Q23 is the native I2S format).
+		m_nQueueSizeFrames = CDirectI2SSoundDevice::Blocks * m_pDirectSoundDevice->GetBlockFrames ();
+		assert (m_nQueueSizeFrames == 2 * m_pConfig->GetChunkSize () / Channels);
 	}
+	else
+	{
+		// With adaptive chunk size the queue is allocated for the maximum
+		// chunk size, but filled up to two working chunks only.
+		unsigned nChunkSize =   m_pConfig->GetAdaptiveChunkSize ()
+				      ? CConfig::MaxChunkSize : m_pConfig->GetChunkSize ();
+		if (!m_pSoundDevice->AllocateQueueFrames (2 * nChunkSize / Channels))
+		{
+			LOGERR ("Cannot allocate sound queue");
 
-	m_pSoundDevice->SetWriteFormat (SoundFormatSigned24_32, Channels);
+			return false;
+		}
 
-	m_nQueueSizeFrames = m_pSoundDevice->GetQueueSizeFrames ();
+		m_pSoundDevice->SetWriteFormat (SoundFormatSigned24_32, Channels);
 
-	m_pSoundDevice->Start ();
+		m_nQueueSizeFrames = m_pSoundDevice->GetQueueSizeFrames ();
+	}
+
+	bool bAdaptiveChunkSize = m_pConfig->GetAdaptiveChunkSize ();
+	if (m_pDirectSoundDevice && bAdaptiveChunkSize)
+	{
+		LOGWARN ("Adaptive chunk size is not supported with direct sound output");
 
+		bAdaptiveChunkSize = false;
+	}
+
+	m_XRunMonitor.Initialize (m_pConfig->GetSampleRate (),
+				    bAdaptiveChunkSize
+				  ? m_pConfig->GetChunkSize () / Channels : m_nQueueSizeFrames / 2,
+				  m_nQueueSizeFrames / 2, bAdaptiveChunkSize);
 #ifdef ARM_ALLOW_MULTI_CORE
-	// start secondary cores
-	if (!CMultiCoreSupport::Initialize ())
+	m_nMixFrames = m_XRunMonitor.GetChunkFrames ();
+#endif
+
+	if (!AllocateAudioBuffers (Channels))
 	{
 		return false;
 	}
+
+	m_pSoundDevice->Start ();
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	// let core 1 start rendering
+	m_bInitialized = true;
+	SendIPI (1, IPI_USER);
 #endif
 	
 	return true;
 }
 
+// Allocates all buffers of the audio path for the maximum number of frames
+// per chunk (the whole queue) from the arena, instead of using the stack.
+bool CMiniDexed::AllocateAudioBuffers (unsigned nChannels)
+{
+	size_t nFloatSize = CAudioBufferArena::GetAlignedSize (m_nQueueSizeFrames * sizeof (float32_t));
+	size_t nOutputSize = CAudioBufferArena::GetAlignedSize (m_nQueueSizeFrames * nChannels * sizeof (int32_t));
+
+	size_t nArenaSize = 6*nFloatSize + nOutputSize;
+#ifdef ARM_ALLOW_MULTI_CORE
+	// TG output rows, the second set is only used by the pipelined render
+	unsigned nRowSets = m_bPipelinedRender ? 2 : 1;
+	nArenaSize += nRowSets * m_nToneGenerators * nFloatSize;
+#endif
+
+	if (!m_BufferArena.Initialize (nArenaSize))
+	{
+		return false;
+	}
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	// The arena is cleared, so that the output of a TG, which has not
+	// been rendered, is silent. Each row starts on a cache line.
+	for (unsigned nTG = 0; nTG < m_nToneGenerators; nTG++)
+	{
+		for (unsigned i = 0; i < nRowSets; i++)
+		{
+			m_pOutputLevel[i][nTG] = m_BufferArena.Allocate<float32_t> (m_nQueueSizeFrames);
+			if (!m_pOutputLevel[i][nTG])
+			{
+				return false;
+			}
+		}
+	}
+#endif
+
+	for (unsigned i = 0; i < 2; i++)
+	{
+		m_pSampleBuffer[i] = m_BufferArena.Allocate<float32_t> (m_nQueueSizeFrames);
+		m_pReverbSendBuffer[i] = m_BufferArena.Allocate<float32_t> (m_nQueueSizeFrames);
+		m_pReverbBuffer[i] = m_BufferArena.Allocate<float32_t> (m_nQueueSizeFrames);
+	}
+
+	m_pOutputBuffer = m_BufferArena.Allocate<int32_t> (m_nQueueSizeFrames * nChannels);
+
+	return m_pOutputBuffer != 0;
+}
+
 void CMiniDexed::Process (bool bPlugAndPlayUpdated)
 {
 #ifndef ARM_ALLOW_MULTI_CORE
@@ -421,9 +591,33 @@ void CMiniDexed::Process (bool bPlugAndPlayUpdated)
 		m_bDeletePerformance = false;
 	}
 		
+	m_SysExFileLoader.Process ();
+	ProcessPendingPrograms ();
+	UpdateVoiceCache ();
+
+	m_XRunMonitor.Report ();
+	m_PolyphonyGovernor.Report ();
+
+	if (m_VoicePool.IsEnabled ())
+	{
+		GrowTGVoices ();
+	}
+
+	for (unsigned nTG = 0; nTG < m_nToneGenerators; nTG++)
+	{
+		assert (m_pTG[nTG]);
+		unsigned nDroppedEvents = m_pTG[nTG]->getDroppedEvents ();
+		if (nDroppedEvents != m_nDroppedEvents[nTG])
+		{
+			LOGWARN ("TG%u: %u events dropped", nTG+1, nDroppedEvents - m_nDroppedEvents[nTG]);
+
+			m_nDroppedEvents[nTG] = nDroppedEvents;
+		}
+	}
+
 	if (m_bProfileEnabled)
 	{
-		m_GetChunkTimer.Dump ();
+		DumpProfile ();
 	}
 }
 
@@ -433,20 +627,29 @@ void CMiniDexed::Run (unsigned nCore)
 {
 	assert (1 <= nCore && nCore < CORES);
 
+	// help core 0 to parse the voice banks, while it loads them
+	m_SysExFileLoader.HelpLoad ();
+
 	if (nCore == 1)
 	{
-		m_CoreStatus[nCore] = CoreStatusIdle;			// core 1 ready
+		// wait for core 0 to complete the initialization
+		while (!m_bInitialized)
+		{
+			WaitForEvent ();
+		}
+
+		m_CoreStatus[nCore].Status = CoreStatusIdle;			// core 1 ready
 
 		// wait for cores 2 and 3 to be ready
 		for (unsigned nCore = 2; nCore < CORES; nCore++)
 		{
-			while (m_CoreStatus[nCore] != CoreStatusIdle)
+			while (m_CoreStatus[nCore].Status != CoreStatusIdle)
 			{
 				WaitForEvent ();
 			}
 		}
 
-		while (m_CoreStatus[nCore] != CoreStatusExit)
+		while (m_CoreStatus[nCore].Status != CoreStatusExit)
 		{
 			ProcessSound ();
 		}
@@ -455,38 +658,99 @@ void CMiniDexed::Run (unsigned nCore)
 	{
 		while (1)
 		{
-			m_CoreStatus[nCore] = CoreStatusIdle;		// ready to be kicked
+			m_CoreStatus[nCore].Status = CoreStatusIdle;		// ready to be kicked
 			SendIPI (1, IPI_USER);
 
-			while (m_CoreStatus[nCore] == CoreStatusIdle)
+			while (m_CoreStatus[nCore].Status == CoreStatusIdle)
 			{
 				WaitForEvent ();
 			}
 
 			// now kicked from core 1
 
-			if (m_CoreStatus[nCore] == CoreStatusExit)
+			if (m_CoreStatus[nCore].Status == CoreStatusExit)
 			{
-				m_CoreStatus[nCore] = CoreStatusUnknown;
+				m_CoreStatus[nCore].Status = CoreStatusUnknown;
 
 				break;
 			}
 
-			assert (m_CoreStatus[nCore] == CoreStatusBusy);
+			assert (m_CoreStatus[nCore].Status == CoreStatusBusy);
 
-			// process the TGs, assigned to this core (2 or 3)
+			// help core 1 to process the TGs of this chunk
 
-			assert (m_nFramesToProcess <= m_pConfig->MaxChunkSize);
-			unsigned nTG = m_pConfig->GetTGsCore1() + (nCore-2)*m_pConfig->GetTGsCore23();
-			for (unsigned i = 0; i < m_pConfig->GetTGsCore23(); i++, nTG++)
-			{
-				assert (nTG < CConfig::AllToneGenerators);
-				if (nTG < m_pConfig->GetToneGenerators())
-				{
-					assert (m_pTG[nTG]);
-					m_pTG[nTG]->getSamples (m_OutputLevel[nTG],m_nFramesToProcess);
-				}
-			}
+			assert (m_nFramesToProcess <= m_nQueueSizeFrames);
+			ProcessTGJobs (m_nRenderBuffer, m_nFramesToProcess);
+		}
+	}
+}
+
+// Sort the active TGs by their render cost in the last chunk (most expensive
+// first), so that the cores pulling jobs from the queue start with the
+// long-running TGs and the cheap ones fill up the gaps at the end.
+void CMiniDexed::ScheduleTGJobs (void)
+{
+	for (unsigned i = 0; i < m_nToneGenerators; i++)
+	{
+		unsigned nTG = m_nTGJobOrder[i];
+
+		unsigned j = i;
+		for (; j > 0 && m_TGJobState[m_nTGJobOrder[j-1]].nRenderTicks < m_TGJobState[nTG].nRenderTicks; j--)
+		{
+			m_nTGJobOrder[j] = m_nTGJobOrder[j-1];
+		}
+
+		m_nTGJobOrder[j] = nTG;
+	}
+
+	m_nNextTGJob = 0;
+}
+
+// Called on cores 1, 2 and 3. Each core pulls the next TG from the queue,
+// until all TGs of this chunk have been taken.
+void CMiniDexed::ProcessTGJobs (unsigned nBuffer, unsigned nFrames)
+{
+	assert (nBuffer < 2);
+
+	unsigned nJob;
+	while ((nJob = m_nNextTGJob.fetch_add (1)) < m_nToneGenerators)
+	{
+		unsigned nTG = m_nTGJobOrder[nJob];
+		assert (nTG < CConfig::AllToneGenerators);
+		assert (m_pTG[nTG]);
+
+		unsigned nStartTicks = CTimer::GetClockTicks ();
+
+		TTGJobState &rState = m_TGJobState[nTG];
+		float32_t *pOutputLevel = m_pOutputLevel[nBuffer][nTG];
+		assert (pOutputLevel);
+
+		// disabled and idle TGs are neither rendered nor mixed
+		bool bRendered = false;
+		if (m_bEnabled[nTG])
+		{
+			bRendered = m_pTG[nTG]->getSamples (pOutputLevel, nFrames, m_nChunkStartTicks);
+		}
+		else
+		{
+			m_pTG[nTG]->processEvents ();	// drain the event ring anyway
+		}
+
+		if (!bRendered && rState.bRendered[nBuffer])
+		{
+			// clear the whole row once, so that it is silent while idle,
+			// also if a later chunk is larger (read in the 8-channel path)
+			arm_fill_f32 (0.0f, pOutputLevel, m_nQueueSizeFrames);
+		}
+		rState.bRendered[nBuffer] = bRendered;
+
+		rState.nRenderTicks = CTimer::GetClockTicks () - nStartTicks;
+
+		if (   m_bProfileEnabled
+		    && bRendered)
+		{
+			m_pProfileTimer[ProfileStageTG1 + nTG]->AddSample (
+				rState.nRenderTicks / (CLOCKHZ / 1000000));
 		}
 	}
 }
@@ -615,12 +879,77 @@ void CMiniDexed::ProgramChange (unsigned nProgram, unsigned nTG)
 
 	m_nProgram[nTG] = nProgram;
 
+	ProfileStart (ProfileStageProgramChange);
+
 	uint8_t Buffer[156];
-	m_SysExFileLoader.GetVoice (m_nVoiceBankID[nTG]+nBankOffset, nProgram, Buffer);
+	unsigned nBankID = m_nVoiceBankID[nTG]+nBankOffset;
+	if (!m_VoiceCache.GetVoice (nBankID, nProgram, Buffer))
+	{
+		if (CurrentExecutionLevel () != TASK_LEVEL)
+		{
+			// The bank is not cached yet (e.g. it has been selected just
+			// before). The loader may read the SD card, which must not be
+			// done from the MIDI interrupt handler.
+			m_nPendingProgram[nTG] = nBankID * CSysExFileLoader::VoicesPerBank + nProgram;
+
+			ProfileStop (ProfileStageProgramChange);
+
+			return;
+		}
+
+		m_SysExFileLoader.GetVoice (nBankID, nProgram, Buffer);
+	}
+
+	m_nPendingProgram[nTG] = NoPendingProgram;	// replaced by this one
 
 	assert (m_pTG[nTG]);
 	m_pTG[nTG]->loadVoiceParameters (Buffer);
 
+	ProfileStop (ProfileStageProgramChange);
+
+	ProgramLoaded (nProgram, nTG);
+}
+
+// Loads the voices of the program changes, which have been deferred by the
+// MIDI interrupt handler. The program is only applied, if no other program
+// change has arrived, while the voice was read.
+void CMiniDexed::ProcessPendingPrograms (void)
+{
+	for (unsigned nTG = 0; nTG < m_nToneGenerators; nTG++)
+	{
+		unsigned nPending = m_nPendingProgram[nTG];
+		if (nPending == NoPendingProgram)
+		{
+			continue;
+		}
+
+		unsigned nProgram = nPending % CSysExFileLoader::VoicesPerBank;
+
+		uint8_t Buffer[156];
+		m_SysExFileLoader.GetVoice (nPending / CSysExFileLoader::VoicesPerBank, nProgram, Buffer);
+
+		m_PendingProgramSpinLock.Acquire ();
+
+		bool bCurrent = m_nPendingProgram[nTG] == nPending;
+		if (bCurrent)
+		{
+			m_nPendingProgram[nTG] = NoPendingProgram;
+
+			assert (m_pTG[nTG]);
+			m_pTG[nTG]->loadVoiceParameters (Buffer);
+		}
+
+		m_PendingProgramSpinLock.Release ();
+
+		if (bCurrent)
+		{
+			ProgramLoaded (nProgram, nTG);
+		}
+	}
+}
+
+void CMiniDexed::ProgramLoaded (unsigned nProgram, unsigned nTG)
+{
 	if (m_pConfig->GetMIDIAutoVoiceDumpOnPC())
 	{
 		// Only do the voice dump back out over MIDI if we have a specific
@@ -689,7 +1018,6 @@ void CMiniDexed::SetPan (unsigned nPan, unsigned nTG)
 	m_nPan[nTG] = nPan;
 	
 	tg_mixer->pan(nTG,mapfloat(nPan,0,127,0.0f,1.0f));
-	reverb_send_mixer->pan(nTG,mapfloat(nPan,0,127,0.0f,1.0f));
 
 	m_UI.ParameterChanged ();
 }
@@ -703,7 +1031,7 @@ void CMiniDexed::SetReverbSend (unsigned nReverbSend, unsigned nTG)
 
 	m_nReverbSend[nTG] = nReverbSend;
 
-	reverb_send_mixer->gain(nTG,mapfloat(nReverbSend,0,99,0.0f,1.0f));
+	tg_mixer->send(nTG,mapfloat(nReverbSend,0,99,0.0f,1.0f));
 	
 	m_UI.ParameterChanged ();
 }
@@ -753,6 +1081,88 @@ void CMiniDexed::SetResonance (int nResonance, unsigned nTG)
 	m_UI.ParameterChanged ();
 }
 
+// The pool limits the voices of the TG with CVoicePool::CanAllocate(), without
+// MaxVoices the TG may use the whole pool. The TG does not allocate all of
+// them, but starts with Polyphony voices (at least MinVoices) and is grown by
+// GrowTGVoices(), when it needs more. Call from the main loop only, the
+// voices are reallocated on this core.
+void CMiniDexed::SetVoiceLimits (unsigned nMinVoices, unsigned nMaxVoices, unsigned nTG)
+{
+	assert (nTG < CConfig::AllToneGenerators);
+	m_nMinVoices[nTG] = nMinVoices;
+	m_nMaxVoices[nTG] = nMaxVoices;
+
+	if (   nTG >= m_nToneGenerators  // Not an active TG
+	    || !m_VoicePool.IsEnabled ())
+	{
+		return;
+	}
+
+	m_VoicePool.SetLimits (nMinVoices, nMaxVoices ? nMaxVoices : m_VoicePool.GetSize (), nTG);
+
+	assert (m_pTG[nTG]);
+	unsigned nVoices = GetInitialTGVoices (nTG);
+	if (m_nTGVoices[nTG] > m_VoicePool.GetMaxVoices (nTG))
+	{
+		// fewer voices are allowed now, the notes are cut anyway
+		m_nTGVoices[nTG] = nVoices;
+
+		m_pTG[nTG]->setMaxNotes (nVoices);
+	}
+	else if (m_nTGVoices[nTG] < m_VoicePool.GetMinVoices (nTG))
+	{
+		m_nTGVoices[nTG] = nVoices;
+
+		m_pTG[nTG]->growMaxNotes (nVoices);
+	}
+}
+
+unsigned CMiniDexed::GetInitialTGVoices (unsigned nTG) const
+{
+	unsigned nVoices = m_nPolyphony;
+	if (nVoices < m_VoicePool.GetMinVoices (nTG))
+	{
+		nVoices = m_VoicePool.GetMinVoices (nTG);
+	}
+
+	if (nVoices > m_VoicePool.GetMaxVoices (nTG))
+	{
+		nVoices = m_VoicePool.GetMaxVoices (nTG);
+	}
+
+	return nVoices > 0 ? nVoices : 1;	// Dexed needs one voice at least,
+						// the pool blocks it
+}
+
+// A TG, which has played all of its voices, gets twice as many, as long as
+// its maximum in the pool allows it. The voices, which are playing, are kept.
+void CMiniDexed::GrowTGVoices (void)
+{
+	for (unsigned nTG = 0; nTG < m_nToneGenerators; nTG++)
+	{
+		assert (m_pTG[nTG]);
+		if (!m_pTG[nTG]->hasVoiceShortage ())
+		{
+			continue;
+		}
+
+		unsigned nVoices = m_nTGVoices[nTG] * 2;
+		if (nVoices > m_VoicePool.GetMaxVoices (nTG))
+		{
+			nVoices = m_VoicePool.GetMaxVoices (nTG);
+		}
+
+		if (nVoices > m_nTGVoices[nTG])
+		{
+			LOGDBG ("TG%u: %u voices", nTG+1, nVoices);
+
+			m_nTGVoices[nTG] = nVoices;
+
+			m_pTG[nTG]->growMaxNotes (nVoices);
+		}
+	}
+}
+
 
 
 void CMiniDexed::SetMIDIChannel (uint8_t uchChannel, unsigned nTG)
@@ -1237,30 +1647,62 @@ void CMiniDexed::ProcessSound (void)
 {
 	assert (m_pSoundDevice);
 
-	unsigned nFrames = m_nQueueSizeFrames - m_pSoundDevice->GetQueueFramesAvail ();
-	if (nFrames >= m_nQueueSizeFrames/2)
+	// keep two working chunks in the queue
+	unsigned nChunkFrames = m_XRunMonitor.GetChunkFrames ();
+	unsigned nQueuedFrames = m_pSoundDevice->GetQueueFramesAvail ();
+	if (nQueuedFrames <= nChunkFrames)
 	{
-		if (m_bProfileEnabled)
+		if (m_XRunMonitor.Update (nQueuedFrames))
 		{
-			m_GetChunkTimer.Start ();
+			UpdateProfileDeadline ();
 		}
 
-		float32_t SampleBuffer[nFrames];
-		m_pTG[0]->getSamples (SampleBuffer, nFrames);
+		unsigned nFrames = 2*nChunkFrames - nQueuedFrames;
+		assert (nFrames <= m_nQueueSizeFrames);
+
+		unsigned nStartTicks = CTimer::GetClockTicks ();
+		ProfileStart (ProfileStageChunk);
+
+		ProfileStart (ProfileStageTG1);
+
+		float32_t *SampleBuffer = m_pSampleBuffer[0];
+		bool bRendered = false;
+		if (m_bEnabled[0])
+		{
+			bRendered = m_pTG[0]->getSamples (SampleBuffer, nFrames, GetChunkStartTicks (nFrames));
+		}
+		else
+		{
+			m_pTG[0]->processEvents ();
+		}
+
+		if (!bRendered)
+		{
+			arm_fill_f32 (0.0f, SampleBuffer, nFrames);
+		}
+
+		ProfileStop (ProfileStageTG1);
+		ProfileStart (ProfileStageOutput);
 
 		// Convert single float array (mono) to int16 array
-		int32_t tmp_int[nFrames];
+		int32_t *tmp_int = m_pOutputBuffer;
 		arm_float_to_q23(SampleBuffer,tmp_int,nFrames);
 
-		if (m_pSoundDevice->Write (tmp_int, sizeof(tmp_int)) != (int) sizeof(tmp_int))
+		ProfileStop (ProfileStageOutput);
+		ProfileStart (ProfileStageWrite);
+
+		int nBytes = nFrames * sizeof (int32_t);
+		if (m_pSoundDevice->Write (tmp_int, nBytes) != nBytes)
 		{
 			LOGERR ("Sound data dropped");
 		}
 
-		if (m_bProfileEnabled)
-		{
-			m_GetChunkTimer.Stop ();
-		}
+		ProfileStop (ProfileStageWrite);
+
+		ProfileStop (ProfileStageChunk);
+		unsigned nRenderTicks = CTimer::GetClockTicks () - nStartTicks;
+		m_XRunMonitor.ChunkRendered (nRenderTicks);
+		UpdateVoiceLimit (nRenderTicks, nFrames);
 	}
 }
 
@@ -1271,193 +1713,249 @@ void CMiniDexed::ProcessSound (void)
 	assert (m_pSoundDevice);
 	assert (m_pConfig);
 
-	unsigned nFrames = m_nQueueSizeFrames - m_pSoundDevice->GetQueueFramesAvail ();
-	if (nFrames >= m_nQueueSizeFrames/2)
+	// keep two working chunks in the queue
+	unsigned nChunkFrames = m_XRunMonitor.GetChunkFrames ();
+	unsigned nQueuedFrames;
+	unsigned nUnderruns = 0;
+	if (m_pDirectSoundDevice)
 	{
-		if (m_bProfileEnabled)
+		// one block is played, while the other one is free
+		if (!m_pDirectSoundDevice->GetWriteBlock ())
 		{
-			m_GetChunkTimer.Start ();
+			return;
 		}
 
-		m_nFramesToProcess = nFrames;
-
-		// kick secondary cores
-		for (unsigned nCore = 2; nCore < CORES; nCore++)
+		nQueuedFrames = nChunkFrames;
+		nUnderruns = m_pDirectSoundDevice->GetUnderruns ();
+	}
+	else
+	{
+		nQueuedFrames = m_pSoundDevice->GetQueueFramesAvail ();
+	}
+	if (nQueuedFrames <= nChunkFrames)
+	{
+		if (m_XRunMonitor.Update (nQueuedFrames, nUnderruns))
 		{
-			assert (m_CoreStatus[nCore] == CoreStatusIdle);
-			m_CoreStatus[nCore] = CoreStatusBusy;
-			SendIPI (nCore, IPI_USER);
+			UpdateProfileDeadline ();
 		}
 
-		// process the TGs assigned to core 1
-		assert (nFrames <= CConfig::MaxChunkSize);
-		for (unsigned i = 0; i < m_pConfig->GetTGsCore1(); i++)
+		unsigned nFrames = 2*nChunkFrames - nQueuedFrames;
+		assert (nFrames <= m_nQueueSizeFrames);
+
+		unsigned nStartTicks = CTimer::GetClockTicks ();
+		ProfileStart (ProfileStageChunk);
+
+		if (m_bPipelinedRender)
 		{
-			assert (m_pTG[i]);
-			m_pTG[i]->getSamples (m_OutputLevel[i], nFrames);
+			// Cores 2 and 3 render the next chunk into one buffer, while
+			// core 1 mixes the chunk, which has been rendered in the last
+			// round, from the other buffer. This adds one chunk of latency.
+			// The mixed chunk keeps the length it has been rendered with,
+			// when the working chunk size changes.
+			nFrames = nChunkFrames;
+
+			unsigned nMixBuffer = m_nRenderBuffer;
+			m_nRenderBuffer ^= 1;
+
+			StartTGJobs (nFrames);
+
+			ProcessAudioPath (nMixBuffer, m_nMixFrames);
+			m_nMixFrames = nFrames;
+
+			// help cores 2 and 3 with the remaining TGs
+			ProcessTGJobs (m_nRenderBuffer, nFrames);
+
+			WaitTGJobs ();
 		}
+		else
+		{
+			StartTGJobs (nFrames);
 
-		// wait for cores 2 and 3 to complete their work
-		for (unsigned nCore = 2; nCore < CORES; nCore++)
+			// process TGs from the queue together with cores 2 and 3
+			ProcessTGJobs (m_nRenderBuffer, nFrames);
+
+			WaitTGJobs ();
+
+			ProcessAudioPath (m_nRenderBuffer, nFrames);
+		}
+
+		ProfileStop (ProfileStageChunk);
+		unsigned nRenderTicks = CTimer::GetClockTicks () - nStartTicks;
+		m_XRunMonitor.ChunkRendered (nRenderTicks);
+		UpdateVoiceLimit (nRenderTicks, nFrames);
+	}
+}
+
+void CMiniDexed::StartTGJobs (unsigned nFrames)
+{
+	assert (nFrames <= m_nQueueSizeFrames);
+	m_nFramesToProcess = nFrames;
+	m_nChunkStartTicks = GetChunkStartTicks (nFrames);
+
+	// fill the TG job queue for this chunk
+	ScheduleTGJobs ();
+
+	// kick secondary cores
+	for (unsigned nCore = 2; nCore < CORES; nCore++)
+	{
+		assert (m_CoreStatus[nCore].Status == CoreStatusIdle);
+		m_CoreStatus[nCore].Status = CoreStatusBusy;
+		SendIPI (nCore, IPI_USER);
+	}
+}
+
+void CMiniDexed::WaitTGJobs (void)
+{
+	ProfileStart (ProfileStageRenderWait);
+
+	// wait for cores 2 and 3 to complete their work
+	for (unsigned nCore = 2; nCore < CORES; nCore++)
+	{
+		while (m_CoreStatus[nCore].Status != CoreStatusIdle)
 		{
-			while (m_CoreStatus[nCore] != CoreStatusIdle)
-			{
-				WaitForEvent ();
-			}
+			WaitForEvent ();
 		}
+	}
 
-		//
-		// Audio signal path after tone generators starts here
-		//
+	ProfileStop (ProfileStageRenderWait);
+}
 
-		if (m_bQuadDAC8Chan) {
-			// This is only supported when there are 8 TGs
-			assert (m_nToneGenerators == 8);
+//
+// Audio signal path after tone generators starts here
+//
+void CMiniDexed::ProcessAudioPath (unsigned nBuffer, unsigned nFrames)
+{
+	assert (nBuffer < 2);
+
+	if (m_bQuadDAC8Chan) {
+		// This is only supported when there are 8 TGs
+		assert (m_nToneGenerators == 8);
 
-			// No mixing is performed by MiniDexed, sound is output in 8 channels.
-			// Note: one TG per audio channel; output=mono; no processing.
-			const int Channels = 8;  // One TG per channel
-			float32_t tmp_float[nFrames*Channels];
-			int32_t tmp_int[nFrames*Channels];
+		// No mixing is performed by MiniDexed, sound is output in 8 channels.
+		// Note: one TG per audio channel; output=mono; no processing.
+		const int Channels = 8;  // One TG per channel
+		int32_t *pOutput = m_pDirectSoundDevice ? m_pDirectSoundDevice->GetWriteBlock () : m_pOutputBuffer;
+		assert (pOutput);
 
-			if(nMasterVolume > 0.0)
+		ProfileStart (ProfileStageOutput);
+
+		if(nMasterVolume > 0.0)
+		{
+			// Convert the TG OutputLevel buffers to a single interleaved
+			// q23 array (8 chan) in one pass. TGs will alternate on L/R
+			// channels for each output, with no additional processing.
+			const float32_t *pChannel[Channels];
+			for (uint8_t tg = 0; tg < Channels; tg++)
 			{
-				// Convert dual float array (8 chan) to single int16 array (8 chan)
-				for(uint16_t i=0; i<nFrames;i++)
-				{
-					// TGs will alternate on L/R channels for each output
-					// reading directly from the TG OutputLevel buffer with
-					// no additional processing.
-					for (uint8_t tg = 0; tg < Channels; tg++)
-					{
-						if(nMasterVolume >0.0 && nMasterVolume <1.0)
-						{
-							tmp_float[(i*Channels)+tg]=m_OutputLevel[tg][i] * nMasterVolume;
-						}
-						else if(nMasterVolume == 1.0)
-						{
-							tmp_float[(i*Channels)+tg]=m_OutputLevel[tg][i];
-						}
-					}
-				}
-				arm_float_to_q23(tmp_float,tmp_int,nFrames*Channels);
+				pChannel[tg] = m_pOutputLevel[nBuffer][tg];
 			}
-			else
+			arm_scale_interleave8_f32_to_q23(pChannel, nMasterVolume, pOutput, nFrames);
+		}
+		else
+		{
+			arm_fill_q31(0, pOutput, nFrames*Channels);
+		}
+
+		// Prevent PCM510x analog mute from kicking in
+		for (uint8_t tg = 0; tg < Channels; tg++) 
+		{
+			if (pOutput[(nFrames - 1) * Channels + tg] == 0)
 			{
-				arm_fill_q31(0, tmp_int, nFrames*Channels);
+				pOutput[(nFrames - 1) * Channels + tg]++;
 			}
+		}
+
+		ProfileStop (ProfileStageOutput);
+		
+		WriteSoundData (pOutput, nFrames*Channels);
+	}
+	else
+	{
+		// Mix everything down to stereo
+		int32_t *pOutput = m_pDirectSoundDevice ? m_pDirectSoundDevice->GetWriteBlock () : m_pOutputBuffer;
+		assert (pOutput);
 
-			// Prevent PCM510x analog mute from kicking in
-			for (uint8_t tg = 0; tg < Channels; tg++) 
+		if(nMasterVolume > 0.0)
+		{
+			float32_t *pTGOutput[CConfig::AllToneGenerators];
+			for (unsigned i = 0; i < CConfig::AllToneGenerators; i++)
 			{
-				if (tmp_int[(nFrames - 1) * Channels + tg] == 0)
-				{
-					tmp_int[(nFrames - 1) * Channels + tg]++;
-				}
+				// silent TGs are not mixed at all
+				pTGOutput[i] =    i < m_nToneGenerators && m_TGJobState[i].bRendered[nBuffer]
+					       ? m_pOutputLevel[nBuffer][i] : 0;
 			}
-			
-			if (m_pSoundDevice->Write (tmp_int, sizeof(tmp_int)) != (int) sizeof(tmp_int))
+
+			TMixBuffers Buffers;
+			for (unsigned i = 0; i < 2; i++)
 			{
-				LOGERR ("Sound data dropped");
+				Buffers.pSample[i] = m_pSampleBuffer[i];
+				Buffers.pReverbSend[i] = m_pReverbSendBuffer[i];
+				Buffers.pReverb[i] = m_pReverbBuffer[i];
 			}
+
+			MixStereo (tg_mixer, pTGOutput,
+				   m_nParameter[ParameterReverbEnable] ? reverb : 0, &m_ReverbSpinLock,
+				   Buffers, m_bChannelsSwapped, nMasterVolume, pOutput, nFrames,
+				   MixStageHandler, this);
 		}
 		else
 		{
-			// Mix everything down to stereo		
-			uint8_t indexL=0, indexR=1;
+			ProfileStart (ProfileStageOutput);
 
-			// BEGIN TG mixing
-			float32_t tmp_float[nFrames*2];
-			int32_t tmp_int[nFrames*2];
+			arm_fill_q31(0, pOutput, nFrames * 2);
 
-			if(nMasterVolume > 0.0)
-			{
-				for (uint8_t i = 0; i < m_nToneGenerators; i++)
-				{
-					tg_mixer->doAddMix(i,m_OutputLevel[i]);
-					reverb_send_mixer->doAddMix(i,m_OutputLevel[i]);
-				}
-				// END TG mixing
-
-				// BEGIN create SampleBuffer for holding audio data
-				float32_t SampleBuffer[2][nFrames];
-				// END create SampleBuffer for holding audio data
-
-				// get the mix of all TGs
-				tg_mixer->getMix(SampleBuffer[indexL], SampleBuffer[indexR]);
-
-				// BEGIN adding reverb
-				if (m_nParameter[ParameterReverbEnable])
-				{
-					float32_t ReverbBuffer[2][nFrames];
-					float32_t ReverbSendBuffer[2][nFrames];
-
-					arm_fill_f32(0.0f, ReverbBuffer[indexL], nFrames);
-					arm_fill_f32(0.0f, ReverbBuffer[indexR], nFrames);
-					arm_fill_f32(0.0f, ReverbSendBuffer[indexR], nFrames);
-					arm_fill_f32(0.0f, ReverbSendBuffer[indexL], nFrames);
-
-					m_ReverbSpinLock.Acquire ();
-
-					reverb_send_mixer->getMix(ReverbSendBuffer[indexL], ReverbSendBuffer[indexR]);
-					reverb->doReverb(ReverbSendBuffer[indexL],ReverbSendBuffer[indexR],ReverbBuffer[indexL], ReverbBuffer[indexR],nFrames);
-
-					// scale down and add left reverb buffer by reverb level 
-					arm_scale_f32(ReverbBuffer[indexL], reverb->get_level(), ReverbBuffer[indexL], nFrames);
-					arm_add_f32(SampleBuffer[indexL], ReverbBuffer[indexL], SampleBuffer[indexL], nFrames);
-					// scale down and add right reverb buffer by reverb level 
-					arm_scale_f32(ReverbBuffer[indexR], reverb->get_level(), ReverbBuffer[indexR], nFrames);
-					arm_add_f32(SampleBuffer[indexR], ReverbBuffer[indexR], SampleBuffer[indexR], nFrames);
-
-					m_ReverbSpinLock.Release ();
-				}
-				// END adding reverb
-
-				// swap stereo channels if needed prior to writing back out
-				if (m_bChannelsSwapped)
-				{
-					indexL=1;
-					indexR=0;
-				}
-
-				// Convert dual float array (left, right) to single int16 array (left/right)
-				for(uint16_t i=0; i<nFrames;i++)
-				{
-					if(nMasterVolume >0.0 && nMasterVolume <1.0)
-					{
-						tmp_float[i*2]=SampleBuffer[indexL][i] * nMasterVolume;
-						tmp_float[(i*2)+1]=SampleBuffer[indexR][i] * nMasterVolume;
-					}
-					else if(nMasterVolume == 1.0)
-					{
-						tmp_float[i*2]=SampleBuffer[indexL][i];
-						tmp_float[(i*2)+1]=SampleBuffer[indexR][i];
-					}
-				}
-				arm_float_to_q23(tmp_float,tmp_int,nFrames*2);
-			}
-			else
-			{
-				arm_fill_q31(0, tmp_int, nFrames * 2);
-			}
+			ProfileStop (ProfileStageOutput);
+		}
 
-			// Prevent PCM510x analog mute from kicking in
-			if (tmp_int[nFrames * 2 - 1] == 0)
-			{
-				tmp_int[nFrames * 2 - 1]++;
-			}
-			
-			if (m_pSoundDevice->Write (tmp_int, sizeof(tmp_int)) != (int) sizeof(tmp_int))
-			{
-				LOGERR ("Sound data dropped");
-			}
-		} // End of Stereo mixing
+		// Prevent PCM510x analog mute from kicking in
+		if (pOutput[nFrames * 2 - 1] == 0)
+		{
+			pOutput[nFrames * 2 - 1]++;
+		}
+
+		WriteSoundData (pOutput, nFrames*2);
+	} // End of Stereo mixing
+}
+
+void CMiniDexed::MixStageHandler (TMixStage Stage, bool bStart, void *pParam)
+{
+	CMiniDexed *pThis = static_cast<CMiniDexed *> (pParam);
+	assert (pThis);
+
+	static const TProfileStage ProfileStage[MixStageUnknown] =
+		{ProfileStageMix, ProfileStageReverb, ProfileStageOutput};
 
-		if (m_bProfileEnabled)
+	if (bStart)
+	{
+		pThis->ProfileStart (ProfileStage[Stage]);
+	}
+	else
+	{
+		pThis->ProfileStop (ProfileStage[Stage]);
+	}
+}
+
+void CMiniDexed::WriteSoundData (const int32_t *pBuffer, unsigned nSamples)
+{
+	ProfileStart (ProfileStageWrite);
+
+	if (m_pDirectSoundDevice)
+	{
+		// the data has been written into the DMA block already
+		assert (pBuffer == m_pDirectSoundDevice->GetWriteBlock ());
+
+		m_pDirectSoundDevice->CommitWriteBlock ();
+	}
+	else
+	{
+		int nBytes = nSamples * sizeof (int32_t);
+		if (m_pSoundDevice->Write (pBuffer, nBytes) != nBytes)
 		{
-			m_GetChunkTimer.Stop ();
+			LOGERR ("Sound data dropped");
 		}
 	}
+
+	ProfileStop (ProfileStageWrite);
 }
 
 #endif
@@ -1522,6 +2020,8 @@ bool CMiniDexed::DoSavePerformance (void)
 		m_PerformanceConfig.SetNoteLimitLow (m_nNoteLimitLow[nTG], nTG);
 		m_PerformanceConfig.SetNoteLimitHigh (m_nNoteLimitHigh[nTG], nTG);
 		m_PerformanceConfig.SetNoteShift (m_nNoteShift[nTG], nTG);
+		m_PerformanceConfig.SetMinVoices (m_nMinVoices[nTG], nTG);
+		m_PerformanceConfig.SetMaxVoices (m_nMaxVoices[nTG], nTG);
 		if (nTG < m_pConfig->GetToneGenerators())
 		{
 			m_pTG[nTG]->getVoiceData(m_nRawVoiceData);
@@ -1862,6 +2362,151 @@ void CMiniDexed::setMasterVolume(float32_t vol)
     nMasterVolume = vol;
 }
 
+bool CMiniDexed::GetProfileEnabled (void) const
+{
+	return m_bProfileEnabled;
+}
+
+const CPerformanceTimer *CMiniDexed::GetProfileTimer (TProfileStage Stage) const
+{
+	assert (Stage < ProfileStageUnknown);
+	return m_pProfileTimer[Stage];
+}
+
+void CMiniDexed::ResetProfile (void)
+{
+	for (unsigned i = 0; i < ProfileStageUnknown; i++)
+	{
+		m_pProfileTimer[i]->Reset ();
+	}
+}
+
+// The voice cache holds the selected bank of each active TG and with
+// ExpandPCAcrossBanks the three banks after it, which a program change
+// may select too.
+void CMiniDexed::UpdateVoiceCache (void)
+{
+	static_assert (CConfig::AllToneGenerators * 4 <= CVoiceCache::MaxBanks,
+		       "Voice cache too small");
+
+	unsigned nBanksPerTG = m_pConfig->GetExpandPCAcrossBanks () ? 4 : 1;
+
+	unsigned BankIDs[CVoiceCache::MaxBanks];
+	unsigned nBanks = 0;
+	for (unsigned nTG = 0; nTG < m_nToneGenerators; nTG++)
+	{
+		for (unsigned i = 0; i < nBanksPerTG; i++)
+		{
+			BankIDs[nBanks++] = m_nVoiceBankID[nTG] + i;
+		}
+	}
+
+	m_VoiceCache.Update (BankIDs, nBanks);
+}
+
+void CMiniDexed::ProfileStart (TProfileStage Stage)
+{
+	if (m_bProfileEnabled)
+	{
+		m_pProfileTimer[Stage]->Start ();
+	}
+}
+
+void CMiniDexed::ProfileStop (TProfileStage Stage)
+{
+	if (m_bProfileEnabled)
+	{
+		m_pProfileTimer[Stage]->Stop ();
+	}
+}
+
+// Called after each chunk on the audio core
+void CMiniDexed::UpdateVoiceLimit (unsigned nRenderTicks, unsigned nFrames)
+{
+	if (!m_PolyphonyGovernor.IsEnabled ())
+	{
+		return;
+	}
+
+	unsigned nVoices[CConfig::AllToneGenerators];
+	for (unsigned nTG = 0; nTG < m_nToneGenerators; nTG++)
+	{
+		assert (m_pTG[nTG]);
+		nVoices[nTG] = m_pTG[nTG]->getLiveVoices ();
+	}
+
+	unsigned nChunkTicks = (u64) nFrames * CLOCKHZ / m_pConfig->GetSampleRate ();
+	if (m_PolyphonyGovernor.Update (nRenderTicks, nChunkTicks, nVoices, m_nToneGenerators))
+	{
+		unsigned nLimit = m_PolyphonyGovernor.GetVoiceLimit ();
+		for (unsigned nTG = 0; nTG < m_nToneGenerators; nTG++)
+		{
+			m_pTG[nTG]->setVoiceLimit (nLimit);
+		}
+	}
+}
+
+// Returns the clock ticks, to which the first frame of the next chunk is
+// mapped for the event timestamps. With SampleAccurateMIDI the chunk covers
+// the events of the last chunk period, so that consecutive chunks cover
+// consecutive periods. The timeline is resynchronized, when the render has
+// drifted off by more than a chunk period (e.g. after an xrun). Otherwise
+// all pending events are applied at the start of the chunk.
+unsigned CMiniDexed::GetChunkStartTicks (unsigned nFrames)
+{
+	unsigned nTicks = CTimer::GetClockTicks ();
+	if (!m_bSampleAccurateMIDI)
+	{
+		return nTicks;
+	}
+
+	unsigned nPeriodTicks = (u64) nFrames * CLOCKHZ / m_pConfig->GetSampleRate ();
+	unsigned nStartTicks = m_nNextChunkStartTicks;
+
+	int nDriftTicks = (int) (nTicks - nPeriodTicks - nStartTicks);
+	if (   nDriftTicks > (int) nPeriodTicks
+	    || nDriftTicks < -(int) nPeriodTicks)
+	{
+		nStartTicks = nTicks - nPeriodTicks;
+	}
+
+	m_nNextChunkStartTicks = nStartTicks + nPeriodTicks;
+
+	return nStartTicks;
+}
+
+// the deadline follows the working chunk size
+void CMiniDexed::UpdateProfileDeadline (void)
+{
+	m_pProfileTimer[ProfileStageChunk]->SetDeadline (m_XRunMonitor.GetChunkMicros ());
+}
+
+// one line per second with the stages, which had samples since the last line
+void CMiniDexed::DumpProfile (void)
+{
+	unsigned nTicks = CTimer::GetClockTicks ();
+	if (nTicks - m_nLastProfileDumpTicks < CLOCKHZ)
+	{
+		return;
+	}
+	m_nLastProfileDumpTicks = nTicks;
+
+	std::ostringstream Line;
+	for (unsigned i = 0; i < ProfileStageUnknown; i++)
+	{
+		std::ostringstream Stage;
+		if (m_pProfileTimer[i]->Dump (Stage))
+		{
+			Line << (Line.tellp () > 0 ? ", " : "") << Stage.str ();
+		}
+	}
+
+	if (Line.tellp () > 0)
+	{
+		std::cout << "p50/p99/max " << Line.str () << std::endl;
+	}
+}
+
 void CMiniDexed::DisplayWrite (const char *pMenu, const char *pParam, const char *pValue,
 			       bool bArrowDown, bool bArrowUp)
 {
@@ -2045,6 +2690,7 @@ void CMiniDexed::LoadPerformanceParameters(void)
 			m_nNoteLimitLow[nTG] = m_PerformanceConfig.GetNoteLimitLow (nTG);
 			m_nNoteLimitHigh[nTG] = m_PerformanceConfig.GetNoteLimitHigh (nTG);
 			m_nNoteShift[nTG] = m_PerformanceConfig.GetNoteShift (nTG);
+			SetVoiceLimits (m_PerformanceConfig.GetMinVoices (nTG), m_PerformanceConfig.GetMaxVoices (nTG), nTG);
 			
 			if(m_PerformanceConfig.VoiceDataFilled(nTG)) 
 			{
@@ -24,11 +24,17 @@
 #include "config.h"
 #include "userinterface.h"
 #include "sysexfileloader.h"
+#include "voicecache.h"
 #include "performanceconfig.h"
 #include "midikeyboard.h"
 #include "pckeyboard.h"
 #include "serialmididevice.h"
 #include "perftimer.h"
+#include "directsounddevice.h"
+#include "audiobufferarena.h"
+#include "xrunmonitor.h"
+#include "polyphonygovernor.h"
+#include "voicepool.h"
 #include <fatfs/ff.h>
 #include <atomic>
 #include <stdint.h>
@@ -44,6 +50,7 @@
 #include "common.h"
 #include "effect_mixer.hpp"
 #include "effect_platervbstereo.h"
+#include "audiomixpath.h"
 #include "effect_compressor.h"
 
 class CMiniDexed
@@ -82,6 +89,7 @@ public:
 	void SetMasterTune (int nMasterTune, unsigned nTG);		// -99 .. 99
 	void SetCutoff (int nCutoff, unsigned nTG);			// 0 .. 99
 	void SetResonance (int nResonance, unsigned nTG);		// 0 .. 99
+	void SetVoiceLimits (unsigned nMinVoices, unsigned nMaxVoices, unsigned nTG);	// voice pool
 	void SetMIDIChannel (uint8_t uchChannel, unsigned nTG);
 
 	void keyup (int16_t pitch, unsigned nTG);
@@ -237,6 +245,24 @@ public:
 
 	void setMasterVolume (float32_t vol);
 
+	// profiling of the audio path (if ProfileEnabled=1)
+	enum TProfileStage
+	{
+		ProfileStageChunk,		// whole chunk
+		ProfileStageRenderWait,		// core 1 waiting for cores 2 and 3
+		ProfileStageMix,
+		ProfileStageReverb,
+		ProfileStageOutput,		// master volume and Q23 conversion
+		ProfileStageWrite,
+		ProfileStageTG1,		// + nTG, includes the compressor
+		ProfileStageProgramChange = ProfileStageTG1 + CConfig::AllToneGenerators,
+		ProfileStageUnknown
+	};
+
+	bool GetProfileEnabled (void) const;
+	const CPerformanceTimer *GetProfileTimer (TProfileStage Stage) const;
+	void ResetProfile (void);
+
 	void DisplayWrite (const char *pMenu, const char *pParam, const char *pValue,
 			   bool bArrowDown, bool bArrowUp);
 
@@ -248,8 +274,29 @@ private:
 	uint8_t m_uchOPMask[CConfig::AllToneGenerators];
 	void LoadPerformanceParameters(void); 
 	void ProcessSound (void);
+	bool AllocateAudioBuffers (unsigned nChannels);
+
+	void ProfileStart (TProfileStage Stage);
+	void ProfileStop (TProfileStage Stage);
+	void UpdateProfileDeadline (void);
+	void DumpProfile (void);
+	void UpdateVoiceLimit (unsigned nRenderTicks, unsigned nFrames);
+	unsigned GetInitialTGVoices (unsigned nTG) const;
+	void GrowTGVoices (void);
+	unsigned GetChunkStartTicks (unsigned nFrames);
+	void UpdateVoiceCache (void);
+	void ProcessPendingPrograms (void);
+	void ProgramLoaded (unsigned nProgram, unsigned nTG);
 
 #ifdef ARM_ALLOW_MULTI_CORE
+	void StartTGJobs (unsigned nFrames);
+	void ScheduleTGJobs (void);
+	void ProcessTGJobs (unsigned nBuffer, unsigned nFrames);
+	void WaitTGJobs (void);
+	void ProcessAudioPath (unsigned nBuffer, unsigned nFrames);
+	static void MixStageHandler (TMixStage Stage, bool bStart, void *pParam);
+	void WriteSoundData (const int32_t *pBuffer, unsigned nSamples);
+
 	enum TCoreStatus
 	{
 		CoreStatusInit,
@@ -258,6 +305,19 @@ private:
 		CoreStatusExit,
 		CoreStatusUnknown
 	};
+
+	// The cores poll their status flags while the TGs are rendered on all
+	// cores, so data written concurrently gets a cache line of its own.
+	struct alignas (CAudioBufferArena::Alignment) TCoreStatusFlag
+	{
+		std::atomic<TCoreStatus> Status;
+	};
+
+	struct alignas (CAudioBufferArena::Alignment) TTGJobState
+	{
+		unsigned nRenderTicks;		// render cost in the last chunk
+		bool bRendered[2];		// TG output valid in this buffer
+	};
 #endif
 
 private:
@@ -275,6 +335,10 @@ private:
 	unsigned m_nVoiceBankIDPerformance;
 	unsigned m_nVoiceBankIDMSBPerformance;
 	unsigned m_nProgram[CConfig::AllToneGenerators];
+	// bank ID * VoicesPerBank + program, which is loaded from the main loop
+	static const unsigned NoPendingProgram = (unsigned) -1;
+	volatile unsigned m_nPendingProgram[CConfig::AllToneGenerators];
+	CSpinLock m_PendingProgramSpinLock;
 	unsigned m_nVolume[CConfig::AllToneGenerators];
 	unsigned m_nExpression[CConfig::AllToneGenerators];
 	unsigned m_nPan[CConfig::AllToneGenerators];
@@ -302,6 +366,10 @@ private:
 	unsigned m_nNoteLimitLow[CConfig::AllToneGenerators];
 	unsigned m_nNoteLimitHigh[CConfig::AllToneGenerators];
 	int m_nNoteShift[CConfig::AllToneGenerators];
+	unsigned m_nMinVoices[CConfig::AllToneGenerators];
+	unsigned m_nMaxVoices[CConfig::AllToneGenerators];	// 0: the whole pool
+	unsigned m_nTGVoices[CConfig::AllToneGenerators];	// allocated in the TG
+	unsigned m_nDroppedEvents[CConfig::AllToneGenerators];	// reported so far
 
 	unsigned m_nReverbSend[CConfig::AllToneGenerators];
   
@@ -312,6 +380,7 @@ private:
 
 	CUserInterface m_UI;
 	CSysExFileLoader m_SysExFileLoader;
+	CVoiceCache m_VoiceCache;
 	CPerformanceConfig m_PerformanceConfig;
 
 	CMIDIKeyboard *m_pMIDIKeyboard[CConfig::MaxUSBMIDIDevices];
@@ -321,22 +390,45 @@ private:
 	bool m_bQuadDAC8Chan;
 
 	CSoundBaseDevice *m_pSoundDevice;
+	CDirectI2SSoundDevice *m_pDirectSoundDevice;	// same device, if DirectSoundOutput=1
+
+	// buffers of the audio path, allocated from m_BufferArena in Initialize()
+	CAudioBufferArena m_BufferArena;
+	float32_t *m_pSampleBuffer[2];
+	float32_t *m_pReverbSendBuffer[2];
+	float32_t *m_pReverbBuffer[2];
+	int32_t *m_pOutputBuffer;			// interleaved Q23, not used with direct output
+
 	bool m_bChannelsSwapped;
 	unsigned m_nQueueSizeFrames;
+	CXRunMonitor m_XRunMonitor;			// provides the working chunk size
+	CPolyphonyGovernor m_PolyphonyGovernor;
+	CVoicePool m_VoicePool;
+
+	bool m_bSampleAccurateMIDI;
+	unsigned m_nNextChunkStartTicks;			// audio core only
+	std::atomic<unsigned> m_nChunkStartTicks;		// of the chunk in render
 
 #ifdef ARM_ALLOW_MULTI_CORE
 //	unsigned m_nActiveTGsLog2;
-	std::atomic<TCoreStatus> m_CoreStatus[CORES];
+	TCoreStatusFlag m_CoreStatus[CORES];
+	std::atomic<bool> m_bInitialized;			// core 1 waits for it to render
+	alignas (CAudioBufferArena::Alignment) std::atomic<unsigned> m_nNextTGJob;	// next index into m_nTGJobOrder[]
 	std::atomic<unsigned> m_nFramesToProcess;
-	float32_t m_OutputLevel[CConfig::AllToneGenerators][CConfig::MaxChunkSize];
+	alignas (CAudioBufferArena::Alignment) unsigned m_nTGJobOrder[CConfig::AllToneGenerators]; // TGs sorted by render cost
+	TTGJobState m_TGJobState[CConfig::AllToneGenerators];
+	bool m_bPipelinedRender;
+	unsigned m_nRenderBuffer;				// 0 or 1, flips each chunk if pipelined
+	unsigned m_nMixFrames;					// rendered in the last round, if pipelined
+	float32_t *m_pOutputLevel[2][CConfig::AllToneGenerators];	// from m_BufferArena, aligned
 #endif
 
-	CPerformanceTimer m_GetChunkTimer;
+	CPerformanceTimer *m_pProfileTimer[ProfileStageUnknown];
 	bool m_bProfileEnabled;
+	unsigned m_nLastProfileDumpTicks;
 
 	AudioEffectPlateReverb* reverb;
-	AudioStereoMixer<CConfig::AllToneGenerators>* tg_mixer;
-	AudioStereoMixer<CConfig::AllToneGenerators>* reverb_send_mixer;
+	AudioStereoSendMixer<CConfig::AllToneGenerators>* tg_mixer;	// dry mix and reverb send
 
 	CSpinLock m_ReverbSpinLock;
 
@@ -162,6 +162,12 @@ bool CPerformanceConfig::Load (void)
 		PropertyName.Format ("NoteShift%u", nTG+1);
 		m_nNoteShift[nTG] = m_Properties.GetSignedNumber (PropertyName, 0);
 
+		PropertyName.Format ("MinVoices%u", nTG+1);
+		m_nMinVoices[nTG] = m_Properties.GetNumber (PropertyName, 0);
+
+		PropertyName.Format ("MaxVoices%u", nTG+1);
+		m_nMaxVoices[nTG] = m_Properties.GetNumber (PropertyName, 0);
+
 		PropertyName.Format ("ReverbSend%u", nTG+1);
 		m_nReverbSend[nTG] = m_Properties.GetNumber (PropertyName, 50);
 		
@@ -279,6 +285,12 @@ bool CPerformanceConfig::Save (void)
 		PropertyName.Format ("NoteShift%u", nTG+1);
 		m_Properties.SetSignedNumber (PropertyName, m_nNoteShift[nTG]);
 
+		PropertyName.Format ("MinVoices%u", nTG+1);
+		m_Properties.SetNumber (PropertyName, m_nMinVoices[nTG]);
+
+		PropertyName.Format ("MaxVoices%u", nTG+1);
+		m_Properties.SetNumber (PropertyName, m_nMaxVoices[nTG]);
+
 		PropertyName.Format ("ReverbSend%u", nTG+1);
 		m_Properties.SetNumber (PropertyName, m_nReverbSend[nTG]);
 		
@@ -409,6 +421,18 @@ int CPerformanceConfig::GetNoteShift (unsigned nTG) const
 	return m_nNoteShift[nTG];
 }
 
+unsigned CPerformanceConfig::GetMinVoices (unsigned nTG) const
+{
+	assert (nTG < CConfig::AllToneGenerators);
+	return m_nMinVoices[nTG];
+}
+
+unsigned CPerformanceConfig::GetMaxVoices (unsigned nTG) const
+{
+	assert (nTG < CConfig::AllToneGenerators);
+	return m_nMaxVoices[nTG];
+}
+
 unsigned CPerformanceConfig::GetReverbSend (unsigned nTG) const
 {
 	assert (nTG < CConfig::AllToneGenerators);
@@ -481,6 +505,18 @@ void CPerformanceConfig::SetNoteShift (int nValue, unsigned nTG)
 	m_nNoteShift[nTG] = nValue;
 }
 
+void CPerformanceConfig::SetMinVoices (unsigned nValue, unsigned nTG)
+{
+	assert (nTG < CConfig::AllToneGenerators);
+	m_nMinVoices[nTG] = nValue;
+}
+
+void CPerformanceConfig::SetMaxVoices (unsigned nValue, unsigned nTG)
+{
+	assert (nTG < CConfig::AllToneGenerators);
+	m_nMaxVoices[nTG] = nValue;
+}
+
 void CPerformanceConfig::SetReverbSend (unsigned nValue, unsigned nTG)
 {
 	assert (nTG < CConfig::AllToneGenerators);
@@ -54,6 +54,8 @@ public:
 	unsigned GetNoteLimitLow (unsigned nTG) const;		// 0 .. 127
 	unsigned GetNoteLimitHigh (unsigned nTG) const;		// 0 .. 127
 	int GetNoteShift (unsigned nTG) const;			// -24 .. 24
+	unsigned GetMinVoices (unsigned nTG) const;		// reserved in the voice pool
+	unsigned GetMaxVoices (unsigned nTG) const;		// 0: Polyphony
 	unsigned GetReverbSend (unsigned nTG) const;		// 0 .. 127
 	unsigned GetPitchBendRange (unsigned nTG) const;		// 0 .. 12
 	unsigned GetPitchBendStep (unsigned nTG) const;		// 0 .. 12
@@ -82,6 +84,8 @@ public:
 	void SetNoteLimitLow (unsigned nValue, unsigned nTG);
 	void SetNoteLimitHigh (unsigned nValue, unsigned nTG);
 	void SetNoteShift (int nValue, unsigned nTG);
+	void SetMinVoices (unsigned nValue, unsigned nTG);
+	void SetMaxVoices (unsigned nValue, unsigned nTG);
 	void SetReverbSend (unsigned nValue, unsigned nTG);
 	void SetPitchBendRange (unsigned nValue, unsigned nTG);
 	void SetPitchBendStep (unsigned nValue, unsigned nTG);
@@ -165,6 +169,8 @@ private:
 	unsigned m_nNoteLimitLow[CConfig::AllToneGenerators];
 	unsigned m_nNoteLimitHigh[CConfig::AllToneGenerators];
 	int m_nNoteShift[CConfig::AllToneGenerators];
+	unsigned m_nMinVoices[CConfig::AllToneGenerators];
+	unsigned m_nMaxVoices[CConfig::AllToneGenerators];
 	int m_nReverbSend[CConfig::AllToneGenerators];
 	unsigned m_nPitchBendRange[CConfig::AllToneGenerators];
 	unsigned m_nPitchBendStep[CConfig::AllToneGenerators];
@@ -18,14 +18,12 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include "perftimer.h"
-#include <iostream>
 
 CPerformanceTimer::CPerformanceTimer (const char *pName, unsigned nDeadlineMicros)
 :	m_Name (pName),
-	m_nDeadlineMicros (nDeadlineMicros),
-	m_nMaximumMicros (0),
-	m_nLastDumpTicks (0)
+	m_nDeadlineMicros (nDeadlineMicros)
 {
+	Reset ();
 }
 
 void CPerformanceTimer::Start (void)
@@ -36,31 +34,148 @@ void CPerformanceTimer::Start (void)
 void CPerformanceTimer::Stop (void)
 {
 	unsigned nEndTicks = CTimer::GetClockTicks ();
-	unsigned nMicros = (nEndTicks - m_nStartTicks) / (CLOCKHZ / 1000000);
 
+	AddSample ((nEndTicks - m_nStartTicks) / (CLOCKHZ / 1000000));
+}
+
+void CPerformanceTimer::AddSample (unsigned nMicros)
+{
 	if (nMicros > m_nMaximumMicros)
 	{
 		m_nMaximumMicros = nMicros;
 	}
+
+	if (   m_nDeadlineMicros != 0
+	    && nMicros > m_nDeadlineMicros)
+	{
+		m_nDeadlineMisses++;
+	}
+
+	m_nHistogram[GetBucket (nMicros)]++;
+	m_nCount++;
 }
 
-void CPerformanceTimer::Dump (unsigned nIntervalTicks)
+void CPerformanceTimer::Reset (void)
 {
-	unsigned nTicks = CTimer::GetClockTicks ();
+	m_nMaximumMicros = 0;
+	m_nCount = 0;
+	m_nDeadlineMisses = 0;
+	m_nLastDumpCount = 0;
 
-	if (nTicks - m_nLastDumpTicks >= nIntervalTicks)
+	for (unsigned i = 0; i < Buckets; i++)
 	{
-		m_nLastDumpTicks = nTicks;
+		m_nHistogram[i] = 0;
+	}
+}
+
+const char *CPerformanceTimer::GetName (void) const
+{
+	return m_Name.c_str ();
+}
+
+unsigned CPerformanceTimer::GetCount (void) const
+{
+	return m_nCount;
+}
 
-		unsigned nMaximumMicros = m_nMaximumMicros;	// may be overwritten from interrupt
+unsigned CPerformanceTimer::GetPercentile (unsigned nPercent) const
+{
+	unsigned nCount = m_nCount;		// may be updated from another core
+	if (nCount == 0)
+	{
+		return 0;
+	}
 
-		std::cout << m_Name << ": Maximum duration was " << nMaximumMicros <<  "us";
+	// rank of the requested sample (1-based, rounded up)
+	unsigned nRank = (nCount * nPercent + 99) / 100;
+	if (nRank == 0)
+	{
+		nRank = 1;
+	}
 
-		if (m_nDeadlineMicros != 0)
+	unsigned nSum = 0;
+	for (unsigned i = 0; i < Buckets; i++)
+	{
+		nSum += m_nHistogram[i];
+		if (nSum >= nRank)
 		{
-			std::cout << " (" << nMaximumMicros*100 / m_nDeadlineMicros << "%)";
+			unsigned nLimit = GetBucketLimit (i);
+
+			return nLimit < m_nMaximumMicros ? nLimit : m_nMaximumMicros;
 		}
+	}
 
-		std::cout << std::endl;
+	return m_nMaximumMicros;
+}
+
+unsigned CPerformanceTimer::GetMaximum (void) const
+{
+	return m_nMaximumMicros;
+}
+
+unsigned CPerformanceTimer::GetDeadlineMisses (void) const
+{
+	return m_nDeadlineMisses;
+}
+
+unsigned CPerformanceTimer::GetDeadline (void) const
+{
+	return m_nDeadlineMicros;
+}
+
+void CPerformanceTimer::SetDeadline (unsigned nDeadlineMicros)
+{
+	m_nDeadlineMicros = nDeadlineMicros;
+}
+
+bool CPerformanceTimer::Dump (std::ostream &rStream)
+{
+	unsigned nCount = m_nCount;			// may be updated from another core
+	if (nCount == m_nLastDumpCount)
+	{
+		return false;
 	}
+	m_nLastDumpCount = nCount;
+
+	unsigned nMaximumMicros = m_nMaximumMicros;	// may be overwritten from interrupt
+
+	rStream << m_Name << " " << GetPercentile (50) << "/" << GetPercentile (99)
+		<< "/" << nMaximumMicros << "us";
+
+	if (m_nDeadlineMicros != 0)
+	{
+		rStream << " (" << nMaximumMicros*100 / m_nDeadlineMicros << "%, "
+			<< m_nDeadlineMisses << " misses)";
+	}
+
+	return true;
+}
+
+// Values below SubBuckets have a bucket of their own. Above, each octave
+// [2^n, 2^(n+1)) is divided into SubBuckets buckets of equal width.
+unsigned CPerformanceTimer::GetBucket (unsigned nMicros)
+{
+	if (nMicros < SubBuckets)
+	{
+		return nMicros;
+	}
+
+	unsigned nOctave = 31 - __builtin_clz (nMicros);		// >= 2
+	unsigned nSub = (nMicros >> (nOctave-2)) & (SubBuckets-1);
+	unsigned nBucket = (nOctave-1) * SubBuckets + nSub;
+
+	return nBucket < Buckets ? nBucket : Buckets-1;
+}
+
+unsigned CPerformanceTimer::GetBucketLimit (unsigned nBucket)
+{
+	if (nBucket < SubBuckets)
+	{
+		return nBucket;
+	}
+
+	unsigned nOctave = nBucket / SubBuckets + 1;
+	unsigned nSub = nBucket % SubBuckets;
+
+	return ((SubBuckets + nSub + 1) << (nOctave-2)) - 1;
 }
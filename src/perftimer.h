@@ -21,17 +21,43 @@
 #define _perftimer_h
 
 #include <string>
+#include <ostream>
 #include <circle/timer.h>
 
+// Measures the duration of a code section and keeps a histogram of the
+// durations with logarithmic buckets (4 per octave), from which percentiles
+// are estimated. If a deadline is set, durations above it are counted as misses.
+
 class CPerformanceTimer
 {
+public:
+	static const unsigned SubBuckets = 4;			// per octave
+	static const unsigned Buckets = 16 * SubBuckets;	// up to 131071us, longer in last bucket
+
 public:
 	CPerformanceTimer (const char *pName, unsigned nDeadlineMicros = 0);
 
 	void Start (void);
 	void Stop (void);
 
-	void Dump (unsigned nIntervalTicks = CLOCKHZ);
+	void AddSample (unsigned nMicros);		// for durations measured elsewhere
+
+	void Reset (void);
+
+	const char *GetName (void) const;
+	unsigned GetCount (void) const;
+	unsigned GetPercentile (unsigned nPercent) const;	// in us, upper bound of bucket
+	unsigned GetMaximum (void) const;			// in us
+	unsigned GetDeadlineMisses (void) const;
+	unsigned GetDeadline (void) const;
+	void SetDeadline (unsigned nDeadlineMicros);
+
+	// writes a short summary, if there were samples since the last call
+	bool Dump (std::ostream &rStream);
+
+private:
+	static unsigned GetBucket (unsigned nMicros);
+	static unsigned GetBucketLimit (unsigned nBucket);	// highest value in bucket
 
 private:
 	std::string m_Name;
@@ -40,7 +66,11 @@ private:
 	unsigned m_nStartTicks;
 	unsigned m_nMaximumMicros;
 
-	unsigned m_nLastDumpTicks;
+	unsigned m_nCount;
+	unsigned m_nDeadlineMisses;
+	unsigned m_nHistogram[Buckets];
+
+	unsigned m_nLastDumpCount;
 };
 
 #endif
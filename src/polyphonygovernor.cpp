@@ -0,0 +1,172 @@
+//
+// polyphonygovernor.cpp
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2022  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "polyphonygovernor.h"
+#include <circle/timer.h>
+#include <circle/logger.h>
+#include <assert.h>
+
+LOGMODULE ("governor");
+
+CPolyphonyGovernor::CPolyphonyGovernor (void)
+:	m_nMaxVoices (0),
+	m_bEnabled (false),
+	m_nVoiceLimit (0),
+	m_nHighLoadChunks (0),
+	m_nLowLoadTicks (0),
+	m_nReportedVoiceLimit (0)
+{
+}
+
+void CPolyphonyGovernor::Initialize (unsigned nMaxVoices, bool bEnabled)
+{
+	m_nMaxVoices = nMaxVoices;
+	m_bEnabled = bEnabled && nMaxVoices > MinVoiceLimit;
+
+	m_nVoiceLimit = nMaxVoices;
+	m_nReportedVoiceLimit = nMaxVoices;
+
+	if (m_bEnabled)
+	{
+		LOGNOTE ("Polyphony governor enabled");
+	}
+}
+
+bool CPolyphonyGovernor::Update (unsigned nRenderTicks, unsigned nChunkTicks, const unsigned *pVoices, unsigned nTGs)
+{
+	assert (pVoices);
+
+	if (   !m_bEnabled
+	    || nChunkTicks == 0)
+	{
+		return false;
+	}
+
+	unsigned nLimit = m_nVoiceLimit;
+
+	if ((u64) nRenderTicks * 100 > (u64) nChunkTicks * HighLoadPercent)
+	{
+		m_nLowLoadTicks = 0;
+
+		unsigned nVoices = 0;
+		unsigned nMaxTGVoices = 0;
+		for (unsigned nTG = 0; nTG < nTGs; nTG++)
+		{
+			nVoices += pVoices[nTG];
+			if (pVoices[nTG] > nMaxTGVoices)
+			{
+				nMaxTGVoices = pVoices[nTG];
+			}
+		}
+
+		if (nMaxTGVoices <= MinVoiceLimit)
+		{
+			m_nHighLoadChunks = 0;
+
+			return false;			// nothing to cut
+		}
+
+		if (nLimit > nMaxTGVoices)
+		{
+			// hold the polyphony where it is, without stealing
+			m_nHighLoadChunks = 1;
+			m_nVoiceLimit = nMaxTGVoices;
+
+			return true;
+		}
+
+		if (   ++m_nHighLoadChunks < HighLoadChunks
+		    || nLimit <= MinVoiceLimit)
+		{
+			return false;
+		}
+		m_nHighLoadChunks = 0;
+
+		// number of voices, which would have fitted into the target load
+		unsigned nAllowed = (u64) nVoices * nChunkTicks * TargetLoadPercent / ((u64) nRenderTicks * 100);
+
+		// lower the limit (at least by one), until the voices of all TGs
+		// (each cut at the limit) do fit
+		unsigned nNewLimit = nMaxTGVoices < nLimit ? nMaxTGVoices : nLimit;
+		do
+		{
+			nNewLimit--;
+
+			unsigned nSum = 0;
+			for (unsigned nTG = 0; nTG < nTGs; nTG++)
+			{
+				nSum += pVoices[nTG] < nNewLimit ? pVoices[nTG] : nNewLimit;
+			}
+
+			if (nSum <= nAllowed)
+			{
+				break;
+			}
+		}
+		while (nNewLimit > MinVoiceLimit);
+
+		if (nNewLimit == nLimit)
+		{
+			return false;
+		}
+
+		m_nVoiceLimit = nNewLimit;
+
+		return true;
+	}
+
+	m_nHighLoadChunks = 0;
+
+	if (   (u64) nRenderTicks * 100 >= (u64) nChunkTicks * LowLoadPercent
+	    || nLimit >= m_nMaxVoices)
+	{
+		m_nLowLoadTicks = 0;
+
+		return false;
+	}
+
+	m_nLowLoadTicks += nChunkTicks;
+	if (m_nLowLoadTicks < RestoreMillis * (CLOCKHZ / 1000))
+	{
+		return false;
+	}
+
+	m_nLowLoadTicks = 0;
+	m_nVoiceLimit = 2*nLimit < m_nMaxVoices ? 2*nLimit : m_nMaxVoices;
+
+	return true;
+}
+
+void CPolyphonyGovernor::Report (void)
+{
+	unsigned nLimit = m_nVoiceLimit;
+	if (nLimit != m_nReportedVoiceLimit)
+	{
+		if (nLimit < m_nReportedVoiceLimit)
+		{
+			LOGWARN ("Voice limit lowered to %u per TG", nLimit);
+		}
+		else
+		{
+			LOGNOTE ("Voice limit raised to %u per TG", nLimit);
+		}
+
+		m_nReportedVoiceLimit = nLimit;
+	}
+}
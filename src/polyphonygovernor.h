@@ -0,0 +1,77 @@
+//
+// polyphonygovernor.h
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2022  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _polyphonygovernor_h
+#define _polyphonygovernor_h
+
+#include <circle/types.h>
+#include <atomic>
+
+// Keeps the render time of a chunk within the CPU budget by lowering the
+// number of voices, which each TG may render at a time. When the render
+// time of a chunk exceeds HighLoadPercent of the chunk period, the voice
+// limit is first lowered to the most voices a TG is playing, so that the
+// polyphony cannot grow further, but no voice is stolen. The render time
+// includes the mix, the reverb and interrupts, so a single slow chunk does
+// not cut voices. Only if the load stays high for HighLoadChunks chunks, the
+// limit is lowered so that the TGs with the most voices would fit into
+// TargetLoadPercent (assuming the same cost per voice). If no TG plays more
+// than MinVoiceLimit voices, cutting would not save anything and the limit
+// is kept. Each RestoreMillis with a load below LowLoadPercent the limit is
+// doubled again.
+//
+// Update() is called on the audio core after each chunk, Report() logs the
+// transitions of the limit from the main loop.
+
+class CPolyphonyGovernor
+{
+public:
+	static const unsigned HighLoadPercent = 85;
+	static const unsigned TargetLoadPercent = 70;
+	static const unsigned LowLoadPercent = 50;
+	static const unsigned HighLoadChunks = 3;
+	static const unsigned RestoreMillis = 100;
+	static const unsigned MinVoiceLimit = 1;
+
+public:
+	CPolyphonyGovernor (void);
+
+	void Initialize (unsigned nMaxVoices, bool bEnabled);
+
+	bool IsEnabled (void) const		{ return m_bEnabled; }
+	unsigned GetVoiceLimit (void) const	{ return m_nVoiceLimit; }
+
+	// pVoices[nTG]: live voices of each TG in this chunk
+	// returns true, if the voice limit has changed
+	bool Update (unsigned nRenderTicks, unsigned nChunkTicks, const unsigned *pVoices, unsigned nTGs);
+
+	void Report (void);
+
+private:
+	unsigned m_nMaxVoices;
+	bool m_bEnabled;
+
+	std::atomic<unsigned> m_nVoiceLimit;
+
+	unsigned m_nHighLoadChunks;		// audio core only
+	unsigned m_nLowLoadTicks;		// audio core only
+	unsigned m_nReportedVoiceLimit;		// main loop only
+};
+
+#endif
@@ -22,6 +22,7 @@
 //
 
 #include <circle/logger.h>
+#include <circle/timer.h>
 #include <cstring>
 #include "serialmididevice.h"
 #include <assert.h>
@@ -38,15 +39,31 @@ CSerialMIDIDevice::CSerialMIDIDevice (CMiniDexed *pSynthesizer, CInterruptSystem
 	m_pConfig (pConfig),
 	m_Serial (pInterrupt, TRUE, SERIAL_MIDI_DEVICE),
 	m_nSerialState (0),
-	m_nSysEx (0),
-	m_SendBuffer (&m_Serial)
+	m_SendBuffer (&m_Serial),
+	m_hReceiveTimer (0),
+	m_nReceivedBytes (0),
+	m_nLostBytes (0),
+	m_nDriverOverruns (0),
+	m_nReceiveErrors (0),
+	m_nMaxLatency (0),
+	m_nReportedLostBytes (0),
+	m_nReportedDriverOverruns (0),
+	m_nReportedReceiveErrors (0),
+	m_nLastReportTicks (0)
 {
 	AddDevice ("ttyS1");
+
+	m_SysExParser.SetThruHandler (SysExThruHandler, this);
 }
 
 CSerialMIDIDevice::~CSerialMIDIDevice (void)
 
 {
+	if (m_hReceiveTimer)
+	{
+		CTimer::Get ()->CancelKernelTimer (m_hReceiveTimer);
+	}
+
 	m_nSerialState = 255;
 }
 
@@ -58,119 +75,203 @@ boolean CSerialMIDIDevice::Initialize (void)
 	// Ensure CR->CRLF translation is disabled for MIDI links
 	ser_options &= ~(SERIAL_OPTION_ONLCR);
 	m_Serial.SetOptions(ser_options);
+
+	if (res)
+	{
+		m_hReceiveTimer = CTimer::Get ()->StartKernelTimer (1, ReceiveTimerHandler, this);
+	}
+
 	return res;
 }
 
-void CSerialMIDIDevice::Process (void)
+// Runs on each kernel timer tick (every 10 ms with HZ=100) in interrupt context,
+// so that the driver is drained, even while the main loop is blocked (e.g. by an
+// SD card write). The serial driver receives in interrupt mode into a buffer of
+// its own. The bytes, which have arrived since the previous tick, are moved into
+// the receive ring here and are all stamped with the time of this poll, so that
+// the measured latency does not include up to one tick, which a byte waited in
+// the driver buffer.
+void CSerialMIDIDevice::Receive (void)
 {
-	m_SendBuffer.Update ();
+	u8 Buffer[64];
+	int nResult;
+	while ((nResult = m_Serial.Read (Buffer, sizeof Buffer)) != 0)
+	{
+		if (nResult < 0)
+		{
+			if (nResult == -SERIAL_ERROR_OVERRUN)
+			{
+				m_nDriverOverruns++;	// UART FIFO or driver buffer was full
+			}
+			else
+			{
+				m_nReceiveErrors++;	// break, framing or parity
+			}
+
+			continue;
+		}
 
-	// Read serial MIDI data
-	u8 Buffer[100];
-	int nResult = m_Serial.Read (Buffer, sizeof Buffer);
-	if (nResult <= 0)
+		unsigned nTicks = CTimer::GetClockTicks ();
+
+		for (int i = 0; i < nResult; i++)
+		{
+			if (!m_ReceiveRing.Put ({nTicks, Buffer[i]}))
+			{
+				m_nLostBytes++;
+			}
+		}
+
+		m_nReceivedBytes += nResult;
+	}
+}
+
+void CSerialMIDIDevice::ReceiveTimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext)
+{
+	CSerialMIDIDevice *pThis = static_cast<CSerialMIDIDevice *> (pParam);
+	assert (pThis);
+
+	pThis->Receive ();
+
+	pThis->m_hReceiveTimer = CTimer::Get ()->StartKernelTimer (1, ReceiveTimerHandler, pThis);
+}
+
+// logs lost bytes, driver overruns and receive errors once per second, if there
+// are new ones
+void CSerialMIDIDevice::ReportReceive (void)
+{
+	unsigned nTicks = CTimer::GetClockTicks ();
+	if (nTicks - m_nLastReportTicks < CLOCKHZ)
 	{
-		if(nResult!=0)
-			LOGERR("Serial.Read() error: %d\n",nResult);
 		return;
 	}
 
-/*        if (m_pConfig->GetMIDIDumpEnabled ())
+	m_nLastReportTicks = nTicks;
+
+	unsigned nLostBytes = m_nLostBytes;
+	unsigned nDriverOverruns = m_nDriverOverruns;
+	unsigned nReceiveErrors = m_nReceiveErrors;
+	if (   nLostBytes != m_nReportedLostBytes
+	    || nDriverOverruns != m_nReportedDriverOverruns
+	    || nReceiveErrors != m_nReportedReceiveErrors)
 	{
-		printf("Incoming MIDI data:");
-		for (uint16_t i = 0; i < nResult; i++)
-		{
-			if((i % 8) == 0)
-				printf("\n%04d:",i);
-			printf(" 0x%02x",Buffer[i]);
-		}
-		printf("\n");
-	}*/
+		LOGWARN ("%u bytes lost, %u driver overruns, %u receive errors "
+			 "(total %u, %u, %u, max. latency %u us)",
+			 nLostBytes - m_nReportedLostBytes,
+			 nDriverOverruns - m_nReportedDriverOverruns,
+			 nReceiveErrors - m_nReportedReceiveErrors,
+			 nLostBytes, nDriverOverruns, nReceiveErrors, GetMaxLatency ());
+
+		m_nReportedLostBytes = nLostBytes;
+		m_nReportedDriverOverruns = nDriverOverruns;
+		m_nReportedReceiveErrors = nReceiveErrors;
+	}
+}
+
+unsigned CSerialMIDIDevice::GetMaxLatency (void) const
+{
+	return (u64) m_nMaxLatency * 1000000 / CLOCKHZ;
+}
+
+void CSerialMIDIDevice::Process (void)
+{
+	m_SendBuffer.Update ();
+
+	ReportReceive ();
 
 	// Process MIDI messages
 	// See: https://www.midi.org/specifications/item/table-1-summary-of-midi-message
 	// "Running status" see: https://www.lim.di.unimi.it/IEEE/MIDI/SOT5.HTM#Running-	
-	
-	for (int i = 0; i < nResult; i++)
+
+	unsigned nTicks = CTimer::GetClockTicks ();
+
+	TReceiveEntry Entry;
+	while (m_ReceiveRing.Get (&Entry))
 	{
-		u8 uchData = Buffer[i];
+		u8 uchData = Entry.ucData;
 
-		if(uchData == 0xF0)
+		unsigned nLatency = nTicks - Entry.nTicks;
+		if (nLatency < CLOCKHZ && nLatency > m_nMaxLatency)	// ignore entries from the future
 		{
-			// SYSEX found
-			m_SerialMessage[m_nSysEx++]=uchData;
-			continue;
+			m_nMaxLatency = nLatency;
 		}
 
 		// System Real Time messages may appear anywhere in the byte stream, so handle them specially
-		if(uchData == 0xF8 || uchData == 0xFA || uchData == 0xFB || uchData == 0xFC || uchData == 0xFE || uchData == 0xFF)
+		if (CSysExParser::IsRealtime (uchData))
 		{
 			MIDIMessageHandler (&uchData, 1);
 			continue;
 		}
-		else if(m_nSysEx > 0)
+
+		// SysEx messages are parsed while they arrive
+		if (uchData == 0xF0 || m_SysExParser.IsActive ())
 		{
-			m_SerialMessage[m_nSysEx++]=uchData;
-			if ((uchData & 0x80) == 0x80 || m_nSysEx >= MAX_MIDI_MESSAGE)
+			CSysExParser::TStatus Status = m_SysExParser.Put (uchData);
+			if (Status == CSysExParser::StatusMessage)
 			{
-				if(uchData == 0xF7)
-					MIDIMessageHandler (m_SerialMessage, m_nSysEx);
-				m_nSysEx = 0;
+				MIDIMessageHandler (m_SysExParser.GetMessage (), m_SysExParser.GetLength ());
 			}
-			continue;
+			else if (Status == CSysExParser::StatusBankDump)
+			{
+				BankDumpHandler (m_SysExParser.GetMessage (), 0);
+			}
+
+			if (Status != CSysExParser::StatusIgnored)
+			{
+				continue;
+			}
+
+			// another status byte has ended the SysEx message
 		}
-		else
+
+		switch (m_nSerialState)
 		{
-			switch (m_nSerialState)
+		case 0:
+		MIDIRestart:
+			if (   (uchData & 0x80) == 0x80		// status byte, all channels
+			    && (uchData & 0xF0) != 0xF0)	// ignore system messages
 			{
-			case 0:
-			MIDIRestart:
-				if (   (uchData & 0x80) == 0x80		// status byte, all channels
-				    && (uchData & 0xF0) != 0xF0)	// ignore system messages
-				{
-					m_SerialMessage[m_nSerialState++] = uchData;
-				}
-				break;
-	
-			case 1:
-			case 2:
-			DATABytes:
-				if (uchData & 0x80)			// got status when parameter expected
-				{
-					m_nSerialState = 0;
-	
-					goto MIDIRestart;
-				}
-	
 				m_SerialMessage[m_nSerialState++] = uchData;
-	
-				if (   (m_SerialMessage[0] & 0xE0) == 0xC0
-				    || m_nSerialState == 3		// message is complete
-				    || (m_SerialMessage[0] & 0xF0) == 0xD0)   // channel aftertouch
-				{
-					MIDIMessageHandler (m_SerialMessage, m_nSerialState);
-	
-					m_nSerialState = 4; // State 4 for test if 4th byte is a status byte or a data byte 
-				}
-	
-				break;
-			case 4:
-				
-				if ((uchData & 0x80) == 0)  // true data byte, false status byte
-				{
-					m_nSerialState = 1;
-					goto DATABytes;
-				}
-				else 
-				{
-					m_nSerialState = 0;
-					goto MIDIRestart; 
-				}
-				break;
-			default:
-				assert (0);
-				break;
 			}
+			break;
+
+		case 1:
+		case 2:
+		DATABytes:
+			if (uchData & 0x80)			// got status when parameter expected
+			{
+				m_nSerialState = 0;
+
+				goto MIDIRestart;
+			}
+
+			m_SerialMessage[m_nSerialState++] = uchData;
+
+			if (   (m_SerialMessage[0] & 0xE0) == 0xC0
+			    || m_nSerialState == 3		// message is complete
+			    || (m_SerialMessage[0] & 0xF0) == 0xD0)   // channel aftertouch
+			{
+				MIDIMessageHandler (m_SerialMessage, m_nSerialState);
+
+				m_nSerialState = 4; // State 4 for test if 4th byte is a status byte or a data byte 
+			}
+
+			break;
+		case 4:
+			
+			if ((uchData & 0x80) == 0)  // true data byte, false status byte
+			{
+				m_nSerialState = 1;
+				goto DATABytes;
+			}
+			else 
+			{
+				m_nSerialState = 0;
+				goto MIDIRestart; 
+			}
+			break;
+		default:
+			assert (0);
+			break;
 		}
 	}
 }
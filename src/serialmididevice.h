@@ -25,8 +25,10 @@
 
 #include "mididevice.h"
 #include "config.h"
+#include "spscring.h"
 #include <circle/interrupt.h>
 #include <circle/serial.h>
+#include <circle/timer.h>
 #include <circle/writebuffer.h>
 #include <circle/types.h>
 
@@ -44,15 +46,54 @@ public:
 
 	void Send (const u8 *pMessage, size_t nLength, unsigned nCable = 0) override;
 
+	// receive statistics, the latency is the maximum time in microseconds
+	// a byte waited in the receive ring, before it was processed (without
+	// the time in the driver buffer, which is up to one kernel timer tick),
+	// the bytes lost with a driver overrun cannot be counted, only the events
+	unsigned GetReceivedBytes (void) const	{ return m_nReceivedBytes; }
+	unsigned GetLostBytes (void) const	{ return m_nLostBytes; }
+	unsigned GetDriverOverruns (void) const	{ return m_nDriverOverruns; }
+	unsigned GetReceiveErrors (void) const	{ return m_nReceiveErrors; }
+	unsigned GetMaxLatency (void) const;
+
 private:
+	void Receive (void);
+	static void ReceiveTimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext);
+
+	void ReportReceive (void);
+
+private:
+	struct TReceiveEntry
+	{
+		unsigned nTicks;
+		u8 ucData;
+	};
+
+	// 4096 bytes take 1.3 seconds at 31250 baud
+	static const unsigned ReceiveRingSize = 4096;
+
 	CConfig *m_pConfig;
 
 	CSerialDevice m_Serial;
 	unsigned m_nSerialState;
-	unsigned m_nSysEx;
-	u8 m_SerialMessage[MAX_MIDI_MESSAGE];
+	u8 m_SerialMessage[3];
+	CSysExParser m_SysExParser;
 
 	CWriteBufferDevice m_SendBuffer;
+
+	CSPSCRing<TReceiveEntry, ReceiveRingSize> m_ReceiveRing;	// filled from interrupt
+	TKernelTimerHandle m_hReceiveTimer;
+
+	volatile unsigned m_nReceivedBytes;
+	volatile unsigned m_nLostBytes;		// receive ring was full
+	volatile unsigned m_nDriverOverruns;	// UART FIFO or driver buffer was full
+	volatile unsigned m_nReceiveErrors;	// break, framing or parity error
+	unsigned m_nMaxLatency;			// clock ticks
+
+	unsigned m_nReportedLostBytes;
+	unsigned m_nReportedDriverOverruns;
+	unsigned m_nReportedReceiveErrors;
+	unsigned m_nLastReportTicks;
 };
 
 #endif
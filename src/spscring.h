@@ -0,0 +1,118 @@
+//
+// spscring.h
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2022  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _spscring_h
+#define _spscring_h
+
+#include "audiobufferarena.h"
+#include <atomic>
+
+// Lock-free ring buffer for one producer and one consumer, which may run on
+// different cores. Entries can be written and read in place (for large
+// entries) with GetWriteEntry()/Commit() and GetReadEntry()/Release().
+// The indices run freely and are masked on access, so Size must be a power
+// of two. Each index has a cache line of its own.
+
+template <typename T, unsigned Size>
+class CSPSCRing
+{
+	static_assert ((Size & (Size-1)) == 0, "Size must be a power of two");
+
+public:
+	CSPSCRing (void)
+	:	m_nWrite (0),
+		m_nRead (0)
+	{
+	}
+
+	// producer, returns 0 if the ring is full
+	T *GetWriteEntry (void)
+	{
+		unsigned nWrite = m_nWrite.load (std::memory_order_relaxed);
+		if (nWrite - m_nRead.load (std::memory_order_acquire) >= Size)
+		{
+			return 0;
+		}
+
+		return &m_Entries[nWrite & (Size-1)];
+	}
+
+	void Commit (void)
+	{
+		m_nWrite.store (m_nWrite.load (std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	bool Put (const T &rEntry)
+	{
+		T *pEntry = GetWriteEntry ();
+		if (!pEntry)
+		{
+			return false;
+		}
+
+		*pEntry = rEntry;
+		Commit ();
+
+		return true;
+	}
+
+	// consumer, returns 0 if the ring is empty
+	const T *GetReadEntry (void) const
+	{
+		unsigned nRead = m_nRead.load (std::memory_order_relaxed);
+		if (nRead == m_nWrite.load (std::memory_order_acquire))
+		{
+			return 0;
+		}
+
+		return &m_Entries[nRead & (Size-1)];
+	}
+
+	void Release (void)
+	{
+		m_nRead.store (m_nRead.load (std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	bool Get (T *pEntry)
+	{
+		const T *pReadEntry = GetReadEntry ();
+		if (!pReadEntry)
+		{
+			return false;
+		}
+
+		*pEntry = *pReadEntry;
+		Release ();
+
+		return true;
+	}
+
+	bool IsEmpty (void) const
+	{
+		return m_nRead.load (std::memory_order_relaxed) == m_nWrite.load (std::memory_order_acquire);
+	}
+
+private:
+	alignas (CAudioBufferArena::Alignment) std::atomic<unsigned> m_nWrite;
+	alignas (CAudioBufferArena::Alignment) std::atomic<unsigned> m_nRead;
+
+	alignas (CAudioBufferArena::Alignment) T m_Entries[Size];
+};
+
+#endif
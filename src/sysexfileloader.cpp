@@ -18,13 +18,17 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include "sysexfileloader.h"
+#include "bankdirhash.h"
 #include <stdio.h>
 #include <dirent.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <stddef.h>
 #include <assert.h>
 #include <circle/logger.h>
+#include <circle/timer.h>
+#include <circle/synchronize.h>
 #include "voices.c"
 
 LOGMODULE ("syxfile");
@@ -62,49 +66,325 @@ uint8_t CSysExFileLoader::s_DefaultVoice[SizeSingleVoice] =	// INIT VOICE
 };
 
 CSysExFileLoader::CSysExFileLoader (const char *pDirName)
-:	m_DirName (pDirName)
+:	m_DirName (pDirName),
+	m_LibraryName (pDirName),
+	m_pLoadJobs (new TLoadJob[LoadJobs]),
+	m_nJobHead (0),
+	m_nJobCount (0),
+	m_bLoadDone (false),
+	m_pLibraryFile (nullptr),
+	m_nCacheUseCount (0),
+	m_nRequestedBankID (MaxVoiceBankID+1)
 {
+	assert (m_pLoadJobs);
+	for (unsigned i = 0; i < LoadJobs; i++)
+	{
+		m_pLoadJobs[i].State.store (JobFree, std::memory_order_relaxed);
+	}
+
 	m_DirName += "/voice";
-	m_nNumHighestBank = 0;
+	m_LibraryName += "/voice.lib";
 
-	for (unsigned i = 0; i <= MaxVoiceBankID; i++)
+	for (unsigned i = 0; i < BankCacheSize; i++)
 	{
-		m_pVoiceBank[i] = nullptr;
+		m_BankCache[i].nBankID = MaxVoiceBankID+1;
+		m_BankCache[i].nLastUsed = 0;
 	}
 }
 
 CSysExFileLoader::~CSysExFileLoader (void)
 {
-	for (unsigned i = 0; i <= MaxVoiceBankID; i++)
+	ClearBanks ();
+
+	delete [] m_pLoadJobs;
+}
+
+void CSysExFileLoader::ClearBanks (void)
+{
+	for (unsigned i = 0; i < m_Banks.GetCount (); i++)
 	{
-		delete m_pVoiceBank[i];
+		delete m_Banks.GetValue (i);
 	}
+
+	m_Banks.Clear ();
+}
+
+const CSysExFileLoader::TBankInfo *CSysExFileLoader::GetBankInfo (unsigned nBankID) const
+{
+	TBankInfo * const *ppInfo = m_Banks.Find (nBankID);
+
+	return ppInfo ? *ppInfo : nullptr;
 }
 
 void CSysExFileLoader::Load (bool bHeaderlessSysExVoices)
 {
-	m_nNumHighestBank = 0;
-	m_nBanksLoaded = 0;
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+
+	ClearBanks ();
+
+	m_DirNames.clear ();
+	m_DirNames.push_back (m_DirName);
 
     DIR *pDirectory = opendir (m_DirName.c_str ());
 	if (!pDirectory)
 	{
 		LOGWARN ("Directory %s not found", m_DirName.c_str ());
 
+		m_bLoadDone.store (true, std::memory_order_release);
+		SendEvent ();				// release the cores in HelpLoad()
+
 		return;
 	}
 
-	dirent *pEntry;
-	while ((pEntry = readdir (pDirectory)) != nullptr)
+	// The signature covers the names, sizes and times of the files in the
+	// directory tree, but not their contents. If the tree cannot be hashed,
+	// the library is not used and the banks are scanned.
+	uint32_t nSignature = 2166136261U;		// FNV-1a
+	bool bSignature = HashBankDirectory (m_DirName, MaxSubDirs, &nSignature);
+	nSignature = (nSignature ^ bHeaderlessSysExVoices) * 16777619U;
+
+	if (!bSignature)
+	{
+		LOGWARN ("Cannot hash %s, bank library not used", m_DirName.c_str ());
+	}
+
+	bool bWarmBoot = bSignature && LoadLibrary (nSignature);
+	if (!bWarmBoot)
 	{
-		LoadBank(m_DirName.c_str (), pEntry->d_name, bHeaderlessSysExVoices, 0);
+		bool bLibrary = bSignature && CreateLibrary ();
+
+		dirent *pEntry;
+		while ((pEntry = readdir (pDirectory)) != nullptr)
+		{
+			LoadBank(0, pEntry->d_name, bHeaderlessSysExVoices, 0);
+		}
+
+		while (!CompleteJobs ())
+		{
+			ParseNextJob ();
+		}
+
+		if (bLibrary)
+		{
+			WriteLibrary (nSignature);
+		}
 	}
-	LOGDBG ("%u Banks loaded. Highest Bank loaded: #%u", m_nBanksLoaded, m_nNumHighestBank+1);
 
 	closedir (pDirectory);
+
+	m_bLoadDone.store (true, std::memory_order_release);
+	SendEvent ();					// release the cores in HelpLoad()
+
+	m_Banks.Finish ();
+
+	unsigned nBanksLoaded = m_Banks.GetCount ();
+	LOGDBG ("%u Banks loaded. Highest Bank loaded: #%u", nBanksLoaded, m_Banks.GetHighest ()+1);
+	LOGDBG ("Bank index uses %u KB, bank cache %u KB",
+		(unsigned) (nBanksLoaded * sizeof (TBankInfo) + m_Banks.GetMemory () + 1023) / 1024,
+		(unsigned) (sizeof m_BankCache + 1023) / 1024);
+
+	LOGNOTE ("%u banks loaded in %u ms (%s boot)", nBanksLoaded,
+		 (CTimer::GetClockTicks () - nStartTicks) / (CLOCKHZ / 1000),
+		 bWarmBoot ? "warm" : "cold");
+}
+
+// Reads the index from the library file, if its signature matches.
+bool CSysExFileLoader::LoadLibrary (uint32_t nSignature)
+{
+	FILE *pFile = fopen (m_LibraryName.c_str (), "rb");
+	if (!pFile)
+	{
+		return false;
+	}
+
+	TLibraryHeader Header;
+	if (   fread (&Header, sizeof Header, 1, pFile) != 1
+	    || memcmp (Header.Magic, "MDVL", 4) != 0
+	    || Header.nVersion != LibraryVersion
+	    || Header.nSignature != nSignature
+	    || fseek (pFile, Header.nIndexOffset, SEEK_SET) != 0)
+	{
+		fclose (pFile);
+
+		LOGNOTE ("%s is outdated", m_LibraryName.c_str ());
+
+		return false;
+	}
+
+	// read the index in large blocks
+	static const unsigned EntriesPerRead = 64;
+	TLibraryEntry *pEntries = new TLibraryEntry[EntriesPerRead];
+	assert (pEntries);
+
+	bool bOK = true;
+	for (unsigned nBank = 0; bOK && nBank < Header.nBanks; )
+	{
+		unsigned nCount = Header.nBanks - nBank;
+		if (nCount > EntriesPerRead)
+		{
+			nCount = EntriesPerRead;
+		}
+
+		if (fread (pEntries, sizeof (TLibraryEntry), nCount, pFile) != nCount)
+		{
+			bOK = false;
+
+			break;
+		}
+
+		for (unsigned i = 0; i < nCount; i++, nBank++)
+		{
+			const TLibraryEntry *pEntry = &pEntries[i];
+			unsigned nBankIdx = pEntry->nBankID;
+
+			if (   nBankIdx > MaxVoiceBankID
+			    || pEntry->nOffset + VoiceSysExSize > Header.nIndexOffset)
+			{
+				bOK = false;
+
+				break;
+			}
+
+			TBankInfo *pInfo = new TBankInfo;
+			assert (pInfo);
+
+			pInfo->FileName.assign (pEntry->FileName, strnlen (pEntry->FileName, sizeof pEntry->FileName));
+			pInfo->nDir = LibraryDir;
+			pInfo->nOffset = pEntry->nOffset;
+			memcpy (pInfo->VoiceName, pEntry->VoiceName, sizeof pInfo->VoiceName);
+
+			if (!m_Banks.Add (nBankIdx, pInfo))
+			{
+				delete pInfo;
+				bOK = false;
+
+				break;
+			}
+		}
+	}
+
+	delete [] pEntries;
+
+	fclose (pFile);
+
+	if (!bOK)
+	{
+		LOGWARN ("%s: Invalid index", m_LibraryName.c_str ());
+
+		ClearBanks ();
+	}
+
+	return bOK;
 }
 
-void CSysExFileLoader::LoadBank (const char * sDirName, const char * sBankName, bool bHeaderlessSysExVoices, unsigned nSubDirCount)
+// Opens the library file for writing, the voice data is appended by
+// AddToLibrary() while the banks are loaded.
+bool CSysExFileLoader::CreateLibrary (void)
+{
+	assert (!m_pLibraryFile);
+	m_LibraryIndex.clear ();
+
+	m_pLibraryFile = fopen (m_LibraryName.c_str (), "wb");
+	if (!m_pLibraryFile)
+	{
+		LOGWARN ("Cannot create %s", m_LibraryName.c_str ());
+
+		return false;
+	}
+
+	// the header is written last, so that an incomplete file is never valid
+	TLibraryHeader Header;
+	memset (&Header, 0, sizeof Header);
+	if (fwrite (&Header, sizeof Header, 1, m_pLibraryFile) != 1)
+	{
+		fclose (m_pLibraryFile);
+		m_pLibraryFile = nullptr;
+
+		remove (m_LibraryName.c_str ());
+
+		return false;
+	}
+
+	return true;
+}
+
+bool CSysExFileLoader::AddToLibrary (unsigned nBankIdx, const TBankInfo *pInfo, const uint8_t *pVoiceData)
+{
+	assert (m_pLibraryFile);
+	assert (nBankIdx <= MaxVoiceBankID);
+	assert (pInfo);
+	assert (pVoiceData);
+
+	TLibraryEntry Entry;
+	memset (&Entry, 0, sizeof Entry);
+
+	Entry.nBankID = nBankIdx;
+	Entry.nOffset = ftell (m_pLibraryFile);
+
+	// keep the number and the extension, if the name is too long
+	size_t nLen = pInfo->FileName.length ();
+	if (nLen < sizeof Entry.FileName)
+	{
+		memcpy (Entry.FileName, pInfo->FileName.c_str (), nLen);
+	}
+	else
+	{
+		memcpy (Entry.FileName, pInfo->FileName.c_str (), sizeof Entry.FileName - 5);
+		memcpy (&Entry.FileName[sizeof Entry.FileName - 5], &pInfo->FileName[nLen-4], 4);
+	}
+
+	memcpy (Entry.VoiceName, pInfo->VoiceName, sizeof Entry.VoiceName);
+
+	if (fwrite (pVoiceData, VoiceSysExSize, 1, m_pLibraryFile) != 1)
+	{
+		return false;
+	}
+
+	m_LibraryIndex.push_back (Entry);
+
+	return true;
+}
+
+// Appends the index and writes the header. The library is removed on error.
+bool CSysExFileLoader::WriteLibrary (uint32_t nSignature)
+{
+	assert (m_pLibraryFile);
+
+	TLibraryHeader Header;
+	memcpy (Header.Magic, "MDVL", 4);
+	Header.nVersion = LibraryVersion;
+	Header.nSignature = nSignature;
+	Header.nBanks = m_LibraryIndex.size ();
+	Header.nIndexOffset = ftell (m_pLibraryFile);
+
+	bool bOK =    m_LibraryIndex.size () == m_Banks.GetCount ()
+		   && (   m_LibraryIndex.empty ()
+		       || fwrite (m_LibraryIndex.data (), sizeof (TLibraryEntry),
+				  m_LibraryIndex.size (), m_pLibraryFile) == m_LibraryIndex.size ())
+		   && fseek (m_pLibraryFile, 0, SEEK_SET) == 0
+		   && fwrite (&Header, sizeof Header, 1, m_pLibraryFile) == 1;
+
+	bOK = fclose (m_pLibraryFile) == 0 && bOK;
+	m_pLibraryFile = nullptr;
+
+	m_LibraryIndex.clear ();
+	m_LibraryIndex.shrink_to_fit ();
+
+	if (!bOK)
+	{
+		LOGWARN ("Cannot write %s", m_LibraryName.c_str ());
+
+		remove (m_LibraryName.c_str ());
+
+		return false;
+	}
+
+	LOGDBG ("%s written (%u banks)", m_LibraryName.c_str (), Header.nBanks);
+
+	return true;
+}
+
+void CSysExFileLoader::LoadBank (unsigned nDir, const char * sBankName, bool bHeaderlessSysExVoices, unsigned nSubDirCount)
 {
 	unsigned nBank;
 	size_t nLen = strlen (sBankName);
@@ -113,8 +393,13 @@ void CSysExFileLoader::LoadBank (const char * sDirName, const char * sBankName,
 		|| strcasecmp (&sBankName[nLen-4], ".syx") != 0
 		|| sscanf (sBankName, "%u", &nBank) != 1)
 	{
+		if (strcmp (sBankName, ".") == 0 || strcmp (sBankName, "..") == 0)
+		{
+			return;
+		}
+
 		// See if this is a subdirectory...
-		std::string Dirname (sDirName);
+		std::string Dirname (m_DirNames[nDir]);
 		Dirname += "/";
 		Dirname += sBankName;
 
@@ -124,15 +409,19 @@ void CSysExFileLoader::LoadBank (const char * sDirName, const char * sBankName,
 			if (nSubDirCount >= MaxSubDirs)
 			{
 				LOGWARN ("Too many nested subdirectories: %s", sBankName);
+				closedir (pDirectory);
 				return;
 			}
 	
 			LOGDBG ("Processing subdirectory %s", sBankName);
 
+			unsigned nSubDir = m_DirNames.size ();
+			m_DirNames.push_back (Dirname);
+
 			dirent *pEntry;
 			while ((pEntry = readdir (pDirectory)) != nullptr)
 			{
-				LoadBank(Dirname.c_str (), pEntry->d_name, bHeaderlessSysExVoices, nSubDirCount+1);
+				LoadBank(nSubDir, pEntry->d_name, bHeaderlessSysExVoices, nSubDirCount+1);
 			}
 			closedir (pDirectory);
 		}
@@ -157,102 +446,345 @@ void CSysExFileLoader::LoadBank (const char * sDirName, const char * sBankName,
 		return;
 	}
 
-	if (m_pVoiceBank[nBankIdx])
-	{
-		LOGWARN ("Bank #%u already loaded", nBank);
+	QueueBank (nBankIdx, nDir, sBankName, bHeaderlessSysExVoices);
+}
 
-		return;
+// The bank files are read on core 0 into a ring of load jobs. The jobs are
+// parsed (format check, checksum, voice names) by any core, which calls
+// ParseNextJob(): the secondary cores from HelpLoad() and core 0 itself, if
+// it has to wait for a free job. The parsed jobs are added to the index on
+// core 0 in the order, in which the files have been read. The secondary cores
+// sleep with WFE, while there is no job to parse, core 0 wakes them with SEV,
+// when it has read a job or has finished loading.
+
+void CSysExFileLoader::QueueBank (unsigned nBankIdx, unsigned nDir, const char *sBankName, bool bHeaderlessSysExVoices)
+{
+	while (m_nJobCount == LoadJobs)
+	{
+		if (!CompleteJobs ())
+		{
+			ParseNextJob ();
+		}
 	}
 
-	m_pVoiceBank[nBankIdx] = new TVoiceBank;
-	assert (m_pVoiceBank[nBankIdx]);
-	assert (sizeof(TVoiceBank) == VoiceSysExHdrSize + VoiceSysExSize);
+	TLoadJob *pJob = &m_pLoadJobs[(m_nJobHead + m_nJobCount) % LoadJobs];
+	assert (pJob->State.load (std::memory_order_relaxed) == JobFree);
+	m_nJobCount++;
 
-	std::string Filename (sDirName);
+	pJob->nBankIdx = nBankIdx;
+	pJob->nDir = nDir;
+	pJob->FileName = sBankName;
+	pJob->bHeaderless = bHeaderlessSysExVoices;
+	pJob->nLength = 0;
+
+	std::string Filename (m_DirNames[nDir]);
 	Filename += "/";
 	Filename += sBankName;
 
 	FILE *pFile = fopen (Filename.c_str (), "rb");
 	if (pFile)
 	{
-		bool bBankLoaded = false;
-		if (   fread (m_pVoiceBank[nBankIdx], VoiceSysExHdrSize+VoiceSysExSize, 1, pFile) == 1
-			&& m_pVoiceBank[nBankIdx]->StatusStart == 0xF0
-			&& m_pVoiceBank[nBankIdx]->CompanyID   == 0x43
-			&& m_pVoiceBank[nBankIdx]->Format      == 0x09
-			&& m_pVoiceBank[nBankIdx]->StatusEnd   == 0xF7)
+		pJob->nLength = fread (&pJob->Bank, 1, sizeof pJob->Bank, pFile);
+
+		fclose (pFile);
+	}
+
+	pJob->State.store (JobRead, std::memory_order_release);
+	SendEvent ();					// wake the cores in HelpLoad()
+
+	CompleteJobs ();
+}
+
+// Adds the parsed jobs at the head of the ring to the index and frees them,
+// returns false, if the job at the head is not parsed yet.
+bool CSysExFileLoader::CompleteJobs (void)
+{
+	while (m_nJobCount > 0)
+	{
+		TLoadJob *pJob = &m_pLoadJobs[m_nJobHead];
+		if (pJob->State.load (std::memory_order_acquire) != JobParsed)
 		{
-			if (m_nBanksLoaded % 100 == 0)
-			{
-				LOGDBG ("Banks successfully loaded #%u", m_nBanksLoaded);
-			}
-			//LOGDBG ("Bank #%u successfully loaded", nBank);
+			return false;
+		}
 
-			m_BankFileName[nBankIdx] = sBankName;
-			if (nBankIdx > m_nNumHighestBank)
-			{
-				// This is the bank ID of the highest loaded bank
-				m_nNumHighestBank = nBankIdx;
-			}
-			m_nBanksLoaded++;
-			bBankLoaded = true;
+		AddBank (pJob);
+
+		pJob->State.store (JobFree, std::memory_order_relaxed);
+		m_nJobHead = (m_nJobHead + 1) % LoadJobs;
+		m_nJobCount--;
+	}
+
+	return true;
+}
+
+// Parses one job, which has been read, returns false, if there is none.
+bool CSysExFileLoader::ParseNextJob (void)
+{
+	for (unsigned i = 0; i < LoadJobs; i++)
+	{
+		TLoadJob *pJob = &m_pLoadJobs[i];
+
+		TJobState State = JobRead;
+		if (pJob->State.compare_exchange_strong (State, JobParsing, std::memory_order_acquire))
+		{
+			ParseBank (pJob);
+
+			pJob->State.store (JobParsed, std::memory_order_release);
+
+			return true;
 		}
-		else if (bHeaderlessSysExVoices)
+	}
+
+	return false;
+}
+
+void CSysExFileLoader::HelpLoad (void)
+{
+	while (!m_bLoadDone.load (std::memory_order_acquire))
+	{
+		if (!ParseNextJob ())
+		{
+			// an event sent after the check above wakes us immediately
+			WaitForEvent ();
+		}
+	}
+}
+
+// Validates the bank data, which has been read, and extracts the voice names.
+void CSysExFileLoader::ParseBank (TLoadJob *pJob)
+{
+	assert (pJob);
+	assert (sizeof(TVoiceBank) == VoiceSysExHdrSize + VoiceSysExSize);
+
+	const TVoiceBank *pBank = &pJob->Bank;
+	const uint8_t (*pVoices)[SizePackedVoice] = nullptr;
+	pJob->bChecksumOK = true;
+
+	if (   pJob->nLength == VoiceSysExHdrSize+VoiceSysExSize
+		&& pBank->StatusStart == 0xF0
+		&& pBank->CompanyID   == 0x43
+		&& pBank->Format      == 0x09
+		&& pBank->StatusEnd   == 0xF7)
+	{
+		pVoices = pBank->Voice;
+		pJob->nOffset = offsetof (TVoiceBank, Voice);
+
+		uint8_t ucChecksum = pBank->Checksum;
+		for (unsigned i = 0; i < VoicesPerBank; i++)
 		{
-			// Config says to accept headerless SysEx Voice Banks
-			// so reset file pointer and try again.
-			fseek (pFile, 0, SEEK_SET);
-			if (fread (m_pVoiceBank[nBankIdx]->Voice, VoiceSysExSize, 1, pFile) == 1)
+			for (unsigned j = 0; j < SizePackedVoice; j++)
 			{
-				if (m_nBanksLoaded % 100 == 0)
-				{
-					LOGDBG ("Banks successfully loaded #%u", m_nBanksLoaded);
-				}
-				//LOGDBG ("Bank #%u successfully loaded (headerless)", nBank);
-
-				// Add in the missing header items.
-				// Naturally it isn't possible to validate these!
-				m_pVoiceBank[nBankIdx]->StatusStart = 0xF0;
-				m_pVoiceBank[nBankIdx]->CompanyID   = 0x43;
-				m_pVoiceBank[nBankIdx]->Format      = 0x09;
-				m_pVoiceBank[nBankIdx]->ByteCountMS = 0x20;
-				m_pVoiceBank[nBankIdx]->ByteCountLS = 0x00;
-				m_pVoiceBank[nBankIdx]->Checksum    = 0x00;
-				m_pVoiceBank[nBankIdx]->StatusEnd   = 0xF7;
-
-				m_BankFileName[nBankIdx] = sBankName;
-				if (nBankIdx > m_nNumHighestBank)
-				{
-					// This is the bank ID of the highest loaded bank
-					m_nNumHighestBank = nBankIdx;
-				}
-				bBankLoaded = true;
-				m_nBanksLoaded++;
+				ucChecksum += pBank->Voice[i][j];
 			}
 		}
 
-		if (!bBankLoaded)
+		pJob->bChecksumOK = (ucChecksum & 0x7F) == 0;
+	}
+	else if (   pJob->bHeaderless
+		 && pJob->nLength >= VoiceSysExSize)
+	{
+		// Config says to accept headerless SysEx Voice Banks,
+		// which start at the beginning of the file.
+		// Naturally it isn't possible to validate these!
+		pVoices = reinterpret_cast<const uint8_t (*)[SizePackedVoice]> (pBank);
+		pJob->nOffset = 0;
+	}
+
+	pJob->pVoices = pVoices;
+	if (!pVoices)
+	{
+		return;
+	}
+
+	// The name is the last 10 characters of the voice data
+	for (unsigned i = 0; i < VoicesPerBank; i++)
+	{
+		memcpy (pJob->VoiceName[i], &pVoices[i][SizePackedVoice - SizeVoiceName], SizeVoiceName);
+	}
+}
+
+// Keeps the location of the voice data and the voice names of a parsed bank
+// in the index. The voice data itself is dropped.
+void CSysExFileLoader::AddBank (const TLoadJob *pJob)
+{
+	assert (pJob);
+
+	if (!pJob->pVoices)
+	{
+		if (pJob->nLength > 0)
 		{
-			LOGWARN ("%s: Invalid size or format", Filename.c_str ());
+			LOGWARN ("%s/%s: Invalid size or format", m_DirNames[pJob->nDir].c_str (),
+				 pJob->FileName.c_str ());
+		}
+
+		return;
+	}
+
+	if (!pJob->bChecksumOK)
+	{
+		LOGDBG ("%s: Checksum error", pJob->FileName.c_str ());
+	}
+
+	TBankInfo *pInfo = new TBankInfo;
+	assert (pInfo);
 
-			delete m_pVoiceBank[nBankIdx];
-			m_pVoiceBank[nBankIdx] = nullptr;
+	pInfo->FileName = pJob->FileName;
+	pInfo->nDir = pJob->nDir;
+	pInfo->nOffset = pJob->nOffset;
+	memcpy (pInfo->VoiceName, pJob->VoiceName, sizeof pInfo->VoiceName);
+
+	if (!m_Banks.Add (pJob->nBankIdx, pInfo))
+	{
+		LOGWARN ("Bank #%u already loaded", pJob->nBankIdx+1);
+
+		delete pInfo;
+
+		return;
+	}
+
+	if (m_pLibraryFile)
+	{
+		AddToLibrary (pJob->nBankIdx, pInfo, &pJob->pVoices[0][0]);
+	}
+
+	unsigned nBanksLoaded = m_Banks.GetCount ();
+	if (nBanksLoaded % 100 == 1)
+	{
+		LOGDBG ("Banks successfully loaded #%u", nBanksLoaded-1);
+	}
+	//LOGDBG ("Bank #%u successfully loaded", pJob->nBankIdx+1);
+}
+
+// Decodes a voice from the bank cache, returns false, if the bank is not
+// in memory. May be called from interrupt context.
+bool CSysExFileLoader::GetCachedVoice (unsigned nBankID, unsigned nVoiceID, uint8_t *pVoiceData)
+{
+	assert (nBankID <= MaxVoiceBankID);
+	assert (nVoiceID < VoicesPerBank);
+
+	m_BankCacheSpinLock.Acquire ();
+
+	for (unsigned i = 0; i < BankCacheSize; i++)
+	{
+		TCachedBank *pCached = &m_BankCache[i];
+		if (pCached->nBankID == nBankID)
+		{
+			pCached->nLastUsed = ++m_nCacheUseCount;
+
+			DecodePackedVoice (pCached->Voice[nVoiceID], pVoiceData);
+
+			m_BankCacheSpinLock.Release ();
+
+			return true;
 		}
+	}
 
-		fclose (pFile);
+	m_BankCacheSpinLock.Release ();
+
+	return false;
+}
+
+// Loads the voice data of a bank into the cache, the least recently used
+// bank is replaced. Returns false, if the bank is not in the index or cannot
+// be read. The slot is invalid, while it is read, so that GetCachedVoice()
+// does not see it. Only this function replaces banks, so the slot cannot be
+// taken by an interrupt meanwhile.
+bool CSysExFileLoader::FetchBank (unsigned nBankID)
+{
+	assert (nBankID <= MaxVoiceBankID);
+	assert (CurrentExecutionLevel () == TASK_LEVEL);
+
+	const TBankInfo *pInfo = GetBankInfo (nBankID);
+	if (!pInfo)
+	{
+		return false;
+	}
+
+	m_BankCacheSpinLock.Acquire ();
+
+	TCachedBank *pCached = &m_BankCache[0];
+	for (unsigned i = 0; i < BankCacheSize; i++)
+	{
+		if (m_BankCache[i].nBankID == nBankID)
+		{
+			m_BankCacheSpinLock.Release ();
+
+			return true;
+		}
+
+		if (m_BankCache[i].nLastUsed < pCached->nLastUsed)
+		{
+			pCached = &m_BankCache[i];
+		}
+	}
+
+	pCached->nBankID = MaxVoiceBankID+1;
+	pCached->nLastUsed = 0;
+
+	m_BankCacheSpinLock.Release ();
+
+	std::string Filename;
+	if (pInfo->nDir == LibraryDir)
+	{
+		Filename = m_LibraryName;
 	}
 	else
 	{
-		delete m_pVoiceBank[nBankIdx];
-		m_pVoiceBank[nBankIdx] = nullptr;
+		Filename = m_DirNames[pInfo->nDir];
+		Filename += "/";
+		Filename += pInfo->FileName;
+	}
+
+	FILE *pFile = fopen (Filename.c_str (), "rb");
+	if (!pFile)
+	{
+		LOGWARN ("%s: Cannot open", Filename.c_str ());
+
+		return false;
 	}
+
+	bool bOK =    fseek (pFile, pInfo->nOffset, SEEK_SET) == 0
+		   && fread (pCached->Voice, VoiceSysExSize, 1, pFile) == 1;
+
+	fclose (pFile);
+
+	if (!bOK)
+	{
+		LOGWARN ("%s: Read error", Filename.c_str ());
+
+		return false;
+	}
+
+	m_BankCacheSpinLock.Acquire ();
+
+	pCached->nBankID = nBankID;
+	pCached->nLastUsed = ++m_nCacheUseCount;
+
+	m_BankCacheSpinLock.Release ();
+
+	return true;
+}
+
+// loads the bank, which has been requested from interrupt context
+void CSysExFileLoader::Process (void)
+{
+	unsigned nBankID = m_nRequestedBankID;
+	if (nBankID > MaxVoiceBankID)
+	{
+		return;
+	}
+
+	m_nRequestedBankID = MaxVoiceBankID+1;
+
+	FetchBank (nBankID);
 }
 
 std::string CSysExFileLoader::GetBankName (unsigned nBankID)
 {
-	if (nBankID <= MaxVoiceBankID)
+	const TBankInfo *pInfo = GetBankInfo (nBankID);
+	if (pInfo)
 	{
-		std::string Result = m_BankFileName[nBankID];
+		std::string Result = pInfo->FileName;
 
 		size_t nLen = Result.length ();
 		if (nLen > 4)
@@ -277,12 +809,12 @@ std::string CSysExFileLoader::GetVoiceName (unsigned nBankID, unsigned nVoiceID)
 {
 	if ((nBankID <= MaxVoiceBankID) && (nVoiceID < VoicesPerBank))
 	{
-		if (IsValidBank(nBankID))
+		const TBankInfo *pInfo = GetBankInfo (nBankID);
+		if (pInfo)
 		{
-			// The name is the last 10 characters of the voice data
-			char sVoiceName[11];
-			strncpy (sVoiceName, (char *)((char *)&(m_pVoiceBank[nBankID]->Voice[nVoiceID]) + SizePackedVoice - 10), 10);
-			sVoiceName[10] = 0;
+			char sVoiceName[SizeVoiceName+1];
+			strncpy (sVoiceName, pInfo->VoiceName[nVoiceID], SizeVoiceName);
+			sVoiceName[SizeVoiceName] = 0;
 			std::string result(sVoiceName);
 			return result;
 		}
@@ -293,79 +825,45 @@ std::string CSysExFileLoader::GetVoiceName (unsigned nBankID, unsigned nVoiceID)
 unsigned CSysExFileLoader::GetNextBankUp (unsigned nBankID)
 {
 	// Find the next loaded bank "up" from the provided bank ID
-	for (unsigned id=nBankID+1; id <= m_nNumHighestBank; id++)
-	{
-		if (IsValidBank(id))
-		{
-			return id;
-		}
-	}
-	
-	// Handle wrap-around
-	for (unsigned id=0; id<nBankID; id++)
-	{
-		if (IsValidBank(id))
-		{
-			return id;
-		}
-	}
-	
-	// If we get here there are no other banks!
-	return nBankID;
+	return m_Banks.GetNext (nBankID);
 }
 
 unsigned CSysExFileLoader::GetNextBankDown (unsigned nBankID)
 {
 	// Find the next loaded bank "down" from the provided bank ID
-	for (int id=((int)nBankID)-1; id >= 0; id--)
-	{
-		if (IsValidBank((unsigned)id))
-		{
-			return id;
-		}
-	}
-
-	// Handle wrap-around
-	for (unsigned id=m_nNumHighestBank; id>nBankID; id--)
-	{
-		if (IsValidBank(id))
-		{
-			return id;
-		}
-	}
-	
-	// If we get here there are no other banks!
-	return nBankID;
+	return m_Banks.GetPrevious (nBankID);
 }
 
 bool CSysExFileLoader::IsValidBank (unsigned nBankID)
 {
-	if (m_pVoiceBank[nBankID])
-	{
-		// Use a valid "status start/end" as an indicator of a valid loaded bank
-		if ((m_pVoiceBank[nBankID]->StatusStart == 0xF0) &&
-			(m_pVoiceBank[nBankID]->StatusEnd == 0xF7))
-		{
-			return true;
-		}
-	}
-	return false;
+	// Only banks with a valid format are added to the index
+	return m_Banks.Find (nBankID) != nullptr;
 }
 
 unsigned CSysExFileLoader::GetNumHighestBank (void)
 {
-	return m_nNumHighestBank;
+	return m_Banks.GetHighest ();
 }
 
 void CSysExFileLoader::GetVoice (unsigned nBankID, unsigned nVoiceID, uint8_t *pVoiceData)
 {
 	if (   nBankID <= MaxVoiceBankID
-	    && nVoiceID <= VoicesPerBank)
+	    && nVoiceID < VoicesPerBank)
 	{
-		if (IsValidBank(nBankID))
+		if (GetCachedVoice (nBankID, nVoiceID, pVoiceData))
 		{
-			DecodePackedVoice (m_pVoiceBank[nBankID]->Voice[nVoiceID], pVoiceData);
+			return;
+		}
 
+		if (CurrentExecutionLevel () != TASK_LEVEL)
+		{
+			// no file access from the MIDI interrupt handler, which may
+			// have interrupted the main loop inside FatFs
+			m_nRequestedBankID = nBankID;
+		}
+		else if (   FetchBank (nBankID)
+			 && GetCachedVoice (nBankID, nVoiceID, pVoiceData))
+		{
 			return;
 		}
 		else
@@ -23,8 +23,13 @@
 #define _sysexfileloader_h
 
 #include <stdint.h>
+#include <stdio.h>
 #include <string>
+#include <vector>
+#include <atomic>
 #include <circle/macros.h>
+#include <circle/spinlock.h>
+#include "bankregistry.h"
 
 class CSysExFileLoader		// Loader for DX7 .syx files
 {
@@ -36,6 +41,8 @@ public:
 	static const unsigned VoiceSysExHdrSize = 8; // Additional (optional) Header/Footer bytes for bank of 32 voices
 	static const unsigned VoiceSysExSize = 4096; // Bank of 32 voices as per DX7 MIDI Spec
 	static const unsigned MaxSubDirs = 3; // Number of nested subdirectories supported.
+	static const unsigned BankCacheSize = 8; // Number of banks kept in memory
+	static const unsigned SizeVoiceName = 10;
 
 	struct TVoiceBank
 	{
@@ -57,8 +64,15 @@ public:
 	CSysExFileLoader (const char *pDirName = "/sysex");
 	~CSysExFileLoader (void);
 
+	// builds the bank index, the voice data is loaded on first use
+	// the index is taken from the voice library file, if it is up-to-date,
+	// otherwise the directory is scanned and the library file is rewritten
 	void Load (bool bHeaderlessSysExVoices = false);
 
+	// may be called on other cores, while Load() runs, to help parsing
+	// the bank files, returns, when Load() has finished
+	void HelpLoad (void);
+
 	std::string GetBankName (unsigned nBankID);	// 0 .. MaxVoiceBankID
 	std::string GetVoiceName (unsigned nBankID, unsigned nVoice); // 0 .. MaxVoiceBankID, 0 .. VoicesPerBank-1
 	unsigned GetNumHighestBank (); // 0 .. MaxVoiceBankID
@@ -66,25 +80,131 @@ public:
 	unsigned GetNextBankUp (unsigned nBankID);
 	unsigned GetNextBankDown (unsigned nBankID);
 
+	// may be called from interrupt context, the voice data is only read from
+	// the SD card at task level, otherwise the default voice is returned for
+	// a bank, which is not in memory, and the bank is loaded by Process()
 	void GetVoice (unsigned nBankID,		// 0 .. MaxVoiceBankID
 		       unsigned nVoiceID,		// 0 .. 31
 		       uint8_t *pVoiceData);		// returns unpacked format (156 bytes)
 
+	void Process (void);				// from the main loop
+
 private:
 	static void DecodePackedVoice (const uint8_t *pPackedData, uint8_t *pDecodedData);
 
+private:
+	// Index entry of a bank, which has been found at boot
+	struct TBankInfo
+	{
+		std::string FileName;
+		unsigned nDir;			// index into m_DirNames
+		unsigned nOffset;		// of the voice data in the file
+		char VoiceName[VoicesPerBank][SizeVoiceName];
+	};
+
+	// The voice library file (<dir>/voice.lib) holds a header, the voice data
+	// of all banks (VoiceSysExSize each) and the index at the end
+	struct TLibraryHeader
+	{
+		char Magic[4];			// "MDVL"
+		uint32_t nVersion;
+		uint32_t nSignature;		// of the directory tree and options
+		uint32_t nBanks;
+		uint32_t nIndexOffset;
+	}
+	PACKED;
+
+	struct TLibraryEntry
+	{
+		uint16_t nBankID;
+		uint16_t nReserved;
+		uint32_t nOffset;		// of the voice data
+		char FileName[64];		// null-terminated
+		char VoiceName[VoicesPerBank][SizeVoiceName];
+	}
+	PACKED;
+
+	static const unsigned LibraryVersion = 1;
+	static const unsigned LibraryDir = (unsigned) -1;	// TBankInfo::nDir for the library
+
+	// A bank file, which is loaded
+	enum TJobState
+	{
+		JobFree,
+		JobRead,			// by core 0
+		JobParsing,			// by any core
+		JobParsed,
+		JobUnknown
+	};
+
+	struct TLoadJob
+	{
+		std::atomic<TJobState> State;
+
+		unsigned nBankIdx;
+		unsigned nDir;
+		std::string FileName;
+		bool bHeaderless;
+
+		size_t nLength;			// bytes read
+		TVoiceBank Bank;		// or the headerless data
+
+		const uint8_t (*pVoices)[SizePackedVoice];	// nullptr if invalid
+		unsigned nOffset;
+		bool bChecksumOK;
+		char VoiceName[VoicesPerBank][SizeVoiceName];
+	};
+
+	static const unsigned LoadJobs = 8;
+
+	// Voice data of a bank, which has been used recently
+	struct TCachedBank
+	{
+		unsigned nBankID;		// MaxVoiceBankID+1 if unused
+		unsigned nLastUsed;
+		uint8_t Voice[VoicesPerBank][SizePackedVoice];
+	};
+
+private:
+	void LoadBank (unsigned nDir, const char * sBankName, bool bHeaderlessSysExVoices, unsigned nSubDirCount);
+	void QueueBank (unsigned nBankIdx, unsigned nDir, const char *sBankName, bool bHeaderlessSysExVoices);
+	bool CompleteJobs (void);
+	bool ParseNextJob (void);
+	static void ParseBank (TLoadJob *pJob);
+	void AddBank (const TLoadJob *pJob);
+
+	bool GetCachedVoice (unsigned nBankID, unsigned nVoiceID, uint8_t *pVoiceData);
+	bool FetchBank (unsigned nBankID);		// at task level only
+
+	const TBankInfo *GetBankInfo (unsigned nBankID) const;
+	void ClearBanks (void);
+
+	bool LoadLibrary (uint32_t nSignature);
+	bool CreateLibrary (void);
+	bool AddToLibrary (unsigned nBankIdx, const TBankInfo *pInfo, const uint8_t *pVoiceData);
+	bool WriteLibrary (uint32_t nSignature);
+
 private:
 	std::string m_DirName;
+	std::vector<std::string> m_DirNames;
+	std::string m_LibraryName;
 	
-	unsigned m_nNumHighestBank;
-	unsigned m_nBanksLoaded;
+	CBankRegistry<TBankInfo *, MaxVoiceBankID> m_Banks;
+
+	TLoadJob *m_pLoadJobs;			// ring of LoadJobs
+	unsigned m_nJobHead;
+	unsigned m_nJobCount;
+	std::atomic<bool> m_bLoadDone;
 
-	TVoiceBank *m_pVoiceBank[MaxVoiceBankID+1];
-	std::string m_BankFileName[MaxVoiceBankID+1];
+	FILE *m_pLibraryFile;			// while it is written
+	std::vector<TLibraryEntry> m_LibraryIndex;
+
+	TCachedBank m_BankCache[BankCacheSize];
+	unsigned m_nCacheUseCount;
+	CSpinLock m_BankCacheSpinLock;			// for m_BankCache and m_nCacheUseCount
+	volatile unsigned m_nRequestedBankID;		// MaxVoiceBankID+1 if none
 
 	static uint8_t s_DefaultVoice[SizeSingleVoice];
-	
-	void LoadBank (const char * sDirName, const char * sBankName, bool bHeaderlessSysExVoices, unsigned nSubDirCount);
 };
 
 #endif
@@ -0,0 +1,262 @@
+//
+// sysexparser.cpp
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2022  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "sysexparser.h"
+#include <assert.h>
+
+#define SYSEX_BEGIN		0xF0
+#define SYSEX_END		0xF7
+#define SYSEX_YAMAHA		0x43
+
+CSysExParser::CSysExParser (void)
+:	m_nDropped (0),
+	m_pThruHandler (0),
+	m_pThruParam (0)
+{
+	Reset ();
+}
+
+void CSysExParser::SetThruHandler (TThruHandler *pHandler, void *pParam)
+{
+	m_pThruHandler = pHandler;
+	m_pThruParam = pParam;
+}
+
+void CSysExParser::Reset (void)
+{
+	m_State = StateIdle;
+	m_nLength = 0;
+	m_nMaxLength = MaxMessageLength;
+	m_nBankBytes = 0;
+	m_ucChecksum = 0;
+	m_bThru = false;
+	m_nThruLength = 0;
+}
+
+CSysExParser::TStatus CSysExParser::Put (u8 ucByte)
+{
+	if (IsRealtime (ucByte))
+	{
+		return StatusIgnored;
+	}
+
+	if (ucByte == SYSEX_BEGIN)
+	{
+		if (m_State != StateIdle && m_State != StateDiscard)
+		{
+			m_nDropped++;			// no end byte
+		}
+
+		if (m_bThru)
+		{
+			FlushThru ();
+		}
+
+		Reset ();
+		m_State = StateHeader;
+		m_Message[m_nLength++] = ucByte;
+
+		return StatusPending;
+	}
+
+	if (m_State == StateIdle)
+	{
+		return StatusIgnored;
+	}
+
+	if (ucByte == SYSEX_END)
+	{
+		TState State = m_State;
+		m_State = StateIdle;
+
+		if (m_bThru)
+		{
+			PutThru (ucByte);
+			FlushThru ();
+			m_bThru = false;
+		}
+
+		switch (State)
+		{
+		case StateHeader:
+		case StateBuffer:
+			assert (m_nLength < MaxMessageLength);
+			m_Message[m_nLength++] = ucByte;
+			return StatusMessage;
+
+		case StateBankData:
+			if (   m_nBankBytes != BankDataLength + 1
+			    || (m_ucChecksum & 0x7F) != 0)
+			{
+				m_nDropped++;
+				return StatusPending;
+			}
+			return StatusBankDump;
+
+		default:
+			return StatusPending;		// end of a dropped message
+		}
+	}
+
+	if (ucByte & 0x80)
+	{
+		// another status byte, the message is incomplete
+		if (m_State != StateDiscard)
+		{
+			m_nDropped++;
+		}
+
+		if (m_bThru)
+		{
+			FlushThru ();
+			m_bThru = false;
+		}
+
+		m_State = StateIdle;
+
+		return StatusIgnored;
+	}
+
+	switch (m_State)
+	{
+	case StateHeader:
+		m_Message[m_nLength++] = ucByte;
+		if (m_nLength == HeaderLength)
+		{
+			Classify ();
+		}
+		break;
+
+	case StateBuffer:
+		if (m_nLength + 1 >= m_nMaxLength)	// room for the end byte
+		{
+			Drop ();
+			if (m_bThru)
+			{
+				PutThru (ucByte);
+			}
+			break;
+		}
+		m_Message[m_nLength++] = ucByte;
+		break;
+
+	case StateBankData:
+		if (m_bThru)
+		{
+			PutThru (ucByte);
+		}
+		if (++m_nBankBytes > BankDataLength + 1)
+		{
+			Drop ();
+			break;
+		}
+		m_ucChecksum += ucByte;
+		break;
+
+	case StateDiscard:
+		if (m_bThru)
+		{
+			PutThru (ucByte);
+		}
+		break;
+
+	default:
+		assert (0);
+		break;
+	}
+
+	return StatusPending;
+}
+
+// called with the complete header in m_Message
+void CSysExParser::Classify (void)
+{
+	assert (m_nLength == HeaderLength);
+
+	m_State = StateBuffer;
+
+	if (m_Message[1] != SYSEX_YAMAHA)
+	{
+		return;
+	}
+
+	u8 ucSubStatus = m_Message[2] & 0x70;
+	if (ucSubStatus == 0x10)			// parameter change
+	{
+		m_nMaxLength = ParameterChangeLength;
+	}
+	else if (ucSubStatus == 0x00)			// bulk dump
+	{
+		unsigned nByteCount = (unsigned) m_Message[4] << 7 | m_Message[5];
+
+		if (m_Message[3] == 0 && nByteCount == 155)		// one voice
+		{
+			m_nMaxLength = VoiceDumpLength;
+		}
+		else if (m_Message[3] == 9 && nByteCount == BankDataLength)	// 32 voices
+		{
+			m_State = StateBankData;
+
+			if (m_pThruHandler != 0)
+			{
+				m_bThru = true;
+				for (unsigned i = 0; i < HeaderLength; i++)
+				{
+					PutThru (m_Message[i]);
+				}
+			}
+		}
+	}
+}
+
+void CSysExParser::Drop (void)
+{
+	m_nDropped++;
+
+	// a long message has been buffered so far, pass on its start
+	if (m_pThruHandler != 0 && !m_bThru)
+	{
+		(*m_pThruHandler) (m_Message, m_nLength, m_pThruParam);
+		m_bThru = true;
+	}
+
+	m_State = StateDiscard;
+}
+
+void CSysExParser::PutThru (u8 ucByte)
+{
+	assert (m_bThru);
+	assert (m_nThruLength < ThruFragmentLength);
+	m_ThruFragment[m_nThruLength++] = ucByte;
+
+	if (m_nThruLength == ThruFragmentLength)
+	{
+		FlushThru ();
+	}
+}
+
+void CSysExParser::FlushThru (void)
+{
+	if (m_nThruLength > 0)
+	{
+		assert (m_pThruHandler != 0);
+		(*m_pThruHandler) (m_ThruFragment, m_nThruLength, m_pThruParam);
+		m_nThruLength = 0;
+	}
+}
@@ -0,0 +1,126 @@
+//
+// sysexparser.h
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2022  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _sysexparser_h
+#define _sysexparser_h
+
+#include <circle/types.h>
+
+// Incremental parser for SysEx messages, which is fed byte by byte from the
+// MIDI input. The header is classified as soon as it has been received:
+//
+// * DX7 parameter changes (7 bytes) and single voice dumps (163 bytes) are
+//   collected into a buffer of their size and returned as soon as the end
+//   byte arrives. A voice dump, which is longer than expected, is dropped
+//   without waiting for its end.
+// * DX7 bank dumps (4104 bytes) are not buffered at all. The checksum is
+//   computed, while the data streams through, and only the header is
+//   returned.
+// * Other messages are buffered up to MaxMessageLength bytes (enough for
+//   the universal and MiniDexed specific messages) and dropped otherwise.
+//
+// The bytes of the messages, which are not returned as a whole (bank dumps
+// and dropped long messages), are passed to the thru handler in fragments
+// of up to ThruFragmentLength bytes while they arrive, if one is set.
+//
+// System real-time bytes are not consumed and may be handled by the caller
+// at any time. A status byte other than F0/F7 aborts the message and is not
+// consumed either.
+
+class CSysExParser
+{
+public:
+	static const unsigned MaxMessageLength = 256;		// except bank dumps
+
+	static const unsigned HeaderLength = 6;			// F0 43 0n ff cc cc
+	static const unsigned VoiceDumpLength = 163;
+	static const unsigned ParameterChangeLength = 7;
+	static const unsigned BankDataLength = 4096;
+
+	static const unsigned ThruFragmentLength = 64;
+
+	enum TStatus
+	{
+		StatusIgnored,		// byte is not part of a SysEx message
+		StatusPending,		// byte consumed, message is not complete yet
+		StatusMessage,		// complete message available with GetMessage()
+		StatusBankDump,		// DX7 bank dump received, header in GetMessage()
+		StatusUnknown
+	};
+
+	typedef void TThruHandler (const u8 *pData, unsigned nLength, void *pParam);
+
+public:
+	CSysExParser (void);
+
+	void SetThruHandler (TThruHandler *pHandler, void *pParam);
+
+	void Reset (void);
+
+	bool IsActive (void) const		{ return m_State != StateIdle; }
+
+	TStatus Put (u8 ucByte);
+
+	const u8 *GetMessage (void) const	{ return m_Message; }
+	unsigned GetLength (void) const		{ return m_nLength; }
+
+	unsigned GetDropped (void) const	{ return m_nDropped; }	// messages
+
+	static bool IsRealtime (u8 ucByte)
+	{
+		return ucByte >= 0xF8 && ucByte != 0xF9 && ucByte != 0xFD;
+	}
+
+private:
+	void Classify (void);
+	void Drop (void);
+
+	void PutThru (u8 ucByte);
+	void FlushThru (void);
+
+private:
+	enum TState
+	{
+		StateIdle,
+		StateHeader,		// collecting the header
+		StateBuffer,		// collecting the message up to m_nMaxLength
+		StateBankData,		// streaming the data of a bank dump
+		StateDiscard,		// waiting for the end of a dropped message
+		StateUnknown
+	};
+
+	TState m_State;
+
+	u8 m_Message[MaxMessageLength];
+	unsigned m_nLength;
+	unsigned m_nMaxLength;		// of the current message, including F7
+
+	unsigned m_nBankBytes;		// data and checksum
+	u8 m_ucChecksum;
+
+	unsigned m_nDropped;
+
+	TThruHandler *m_pThruHandler;
+	void *m_pThruParam;
+	bool m_bThru;			// the current message is passed to the thru handler
+	u8 m_ThruFragment[ThruFragmentLength];
+	unsigned m_nThruLength;
+};
+
+#endif
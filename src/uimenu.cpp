@@ -64,6 +64,7 @@ const CUIMenu::TMenuItem CUIMenu::s_MainMenu[] =
 #endif
 	{"Effects",	MenuHandler,	s_EffectsMenu},
 	{"Performance",	MenuHandler, s_PerformanceMenu}, 
+	{"Profile",	ShowProfile},
 	{0}
 };
 
@@ -1106,6 +1107,54 @@ void CUIMenu::SavePerformance (CUIMenu *pUIMenu, TMenuEvent Event)
 	CTimer::Get ()->StartKernelTimer (MSEC2HZ (1500), TimerHandler, 0, pUIMenu);
 }
 
+// Shows the 99th percentile and the maximum duration of the stages of the
+// audio path (CMiniDexed::TProfileStage). Select the stage with up/down.
+void CUIMenu::ShowProfile (CUIMenu *pUIMenu, TMenuEvent Event)
+{
+	unsigned nStages = CMiniDexed::ProfileStageTG1 + pUIMenu->m_nToneGenerators;
+
+	switch (Event)
+	{
+	case MenuEventUpdate:
+	case MenuEventUpdateParameter:
+		break;
+
+	case MenuEventStepDown:
+		if (pUIMenu->m_nProfileStage > 0)
+		{
+			pUIMenu->m_nProfileStage--;
+		}
+		break;
+
+	case MenuEventStepUp:
+		if (pUIMenu->m_nProfileStage < nStages-1)
+		{
+			pUIMenu->m_nProfileStage++;
+		}
+		break;
+
+	default:
+		return;
+	}
+
+	const CPerformanceTimer *pTimer = pUIMenu->m_pMiniDexed->GetProfileTimer (
+		(CMiniDexed::TProfileStage) pUIMenu->m_nProfileStage);
+	assert (pTimer);
+
+	string Value ("Disabled");
+	if (pUIMenu->m_pMiniDexed->GetProfileEnabled ())
+	{
+		Value =   to_string (pTimer->GetPercentile (99)) + "/"
+			+ to_string (pTimer->GetMaximum ()) + "us";
+	}
+
+	string Param = string (pTimer->GetName ()) + " p99/max";
+
+	pUIMenu->m_pMiniDexed->DisplayWrite (pUIMenu->m_pParentMenu[pUIMenu->m_nCurrentMenuItem].Name,
+				      Param.c_str (), Value.c_str (),
+				      pUIMenu->m_nProfileStage > 0, pUIMenu->m_nProfileStage < nStages-1);
+}
+
 string CUIMenu::GetGlobalValueString (unsigned nParameter, int nValue)
 {
 	string Result;
@@ -0,0 +1,124 @@
+//
+// voicecache.cpp
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2024  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "voicecache.h"
+#include <string.h>
+#include <assert.h>
+
+CVoiceCache::CVoiceCache (CSysExFileLoader *pSysExFileLoader)
+:	m_pSysExFileLoader (pSysExFileLoader),
+	m_pSlots (new TSlot[MaxBanks])
+{
+	assert (m_pSysExFileLoader);
+	assert (m_pSlots);
+
+	for (unsigned i = 0; i < MaxBanks; i++)
+	{
+		m_pSlots[i].nBankID.store (NoBank, std::memory_order_relaxed);
+	}
+}
+
+CVoiceCache::~CVoiceCache (void)
+{
+	delete [] m_pSlots;
+}
+
+void CVoiceCache::Update (const unsigned *pBankIDs, unsigned nBanks)
+{
+	assert (pBankIDs);
+
+	// release the slots of banks, which are not wanted any more
+	TSlot *pFreeSlot = nullptr;
+	for (unsigned i = 0; i < MaxBanks; i++)
+	{
+		TSlot *pSlot = &m_pSlots[i];
+		unsigned nBankID = pSlot->nBankID.load (std::memory_order_relaxed);
+
+		bool bWanted = false;
+		for (unsigned j = 0; j < nBanks && !bWanted; j++)
+		{
+			bWanted = pBankIDs[j] == nBankID;
+		}
+
+		if (!bWanted)
+		{
+			pSlot->nBankID.store (NoBank, std::memory_order_relaxed);
+
+			if (!pFreeSlot)
+			{
+				pFreeSlot = pSlot;
+			}
+		}
+	}
+
+	if (!pFreeSlot)
+	{
+		return;
+	}
+
+	// decode the first wanted bank, which is not cached yet
+	for (unsigned i = 0; i < nBanks; i++)
+	{
+		unsigned nBankID = pBankIDs[i];
+		if (   nBankID >= NoBank
+		    || Find (nBankID)
+		    || !m_pSysExFileLoader->IsValidBank (nBankID))
+		{
+			continue;
+		}
+
+		for (unsigned nVoice = 0; nVoice < CSysExFileLoader::VoicesPerBank; nVoice++)
+		{
+			m_pSysExFileLoader->GetVoice (nBankID, nVoice, pFreeSlot->Voice[nVoice]);
+		}
+
+		pFreeSlot->nBankID.store (nBankID, std::memory_order_release);
+
+		return;
+	}
+}
+
+bool CVoiceCache::GetVoice (unsigned nBankID, unsigned nVoiceID, uint8_t *pVoiceData)
+{
+	assert (pVoiceData);
+
+	TSlot *pSlot;
+	if (   nVoiceID >= CSysExFileLoader::VoicesPerBank
+	    || !(pSlot = Find (nBankID)))
+	{
+		return false;
+	}
+
+	memcpy (pVoiceData, pSlot->Voice[nVoiceID], CSysExFileLoader::SizeSingleVoice);
+
+	return true;
+}
+
+CVoiceCache::TSlot *CVoiceCache::Find (unsigned nBankID)
+{
+	for (unsigned i = 0; i < MaxBanks; i++)
+	{
+		if (m_pSlots[i].nBankID.load (std::memory_order_acquire) == nBankID)
+		{
+			return &m_pSlots[i];
+		}
+	}
+
+	return nullptr;
+}
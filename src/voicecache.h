@@ -0,0 +1,66 @@
+//
+// voicecache.h
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2024  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _voicecache_h
+#define _voicecache_h
+
+#include "sysexfileloader.h"
+#include <atomic>
+#include <stdint.h>
+
+// Cache of decoded voices (in the 156 bytes format) for the banks, which are
+// selected on the tone generators, so that a program change only needs to
+// copy the voice. The cache is filled by Update() from the main loop on core
+// 0, one bank per call. GetVoice() may be called from the MIDI handler in
+// interrupt context on the same core, so a slot is invalidated, before it
+// is written, and published, when it is complete.
+
+class CVoiceCache
+{
+public:
+	static const unsigned MaxBanks = 64;		// 16 TGs with 4 banks each
+
+public:
+	CVoiceCache (CSysExFileLoader *pSysExFileLoader);
+	~CVoiceCache (void);
+
+	// pBankIDs are the banks, which should be cached (duplicates allowed)
+	void Update (const unsigned *pBankIDs, unsigned nBanks);
+
+	// returns false, if the bank is not cached
+	bool GetVoice (unsigned nBankID, unsigned nVoiceID, uint8_t *pVoiceData);
+
+private:
+	static const unsigned NoBank = CSysExFileLoader::MaxVoiceBankID+1;
+
+	struct TSlot
+	{
+		std::atomic<unsigned> nBankID;		// NoBank if unused
+		uint8_t Voice[CSysExFileLoader::VoicesPerBank][CSysExFileLoader::SizeSingleVoice];
+	};
+
+	TSlot *Find (unsigned nBankID);
+
+private:
+	CSysExFileLoader *m_pSysExFileLoader;
+
+	TSlot *m_pSlots;
+};
+
+#endif
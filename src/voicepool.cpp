@@ -0,0 +1,104 @@
+//
+// voicepool.cpp
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2022  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "voicepool.h"
+#include <assert.h>
+
+CVoicePool::CVoicePool (void)
+:	m_nSize (0)
+{
+	for (unsigned nTG = 0; nTG < MaxToneGenerators; nTG++)
+	{
+		m_nMinVoices[nTG] = 0;
+		m_nMaxVoices[nTG] = 0;
+		m_nVoices[nTG] = 0;
+	}
+}
+
+void CVoicePool::Initialize (unsigned nSize)
+{
+	m_nSize = nSize;
+
+	for (unsigned nTG = 0; nTG < MaxToneGenerators; nTG++)
+	{
+		m_nMaxVoices[nTG] = nSize;
+	}
+}
+
+void CVoicePool::SetLimits (unsigned nMinVoices, unsigned nMaxVoices, unsigned nTG)
+{
+	assert (nTG < MaxToneGenerators);
+
+	if (nMaxVoices > m_nSize)
+	{
+		nMaxVoices = m_nSize;
+	}
+
+	if (nMinVoices > nMaxVoices)
+	{
+		nMinVoices = nMaxVoices;
+	}
+
+	m_nMinVoices[nTG] = nMinVoices;
+	m_nMaxVoices[nTG] = nMaxVoices;
+}
+
+unsigned CVoicePool::GetMinVoices (unsigned nTG) const
+{
+	assert (nTG < MaxToneGenerators);
+	return m_nMinVoices[nTG];
+}
+
+unsigned CVoicePool::GetMaxVoices (unsigned nTG) const
+{
+	assert (nTG < MaxToneGenerators);
+	return m_nMaxVoices[nTG];
+}
+
+bool CVoicePool::CanAllocate (unsigned nTG) const
+{
+	assert (nTG < MaxToneGenerators);
+
+	unsigned nVoices = m_nVoices[nTG];
+	if (nVoices >= m_nMaxVoices[nTG])
+	{
+		return false;
+	}
+
+	if (nVoices < m_nMinVoices[nTG])
+	{
+		return true;			// reserved for this TG
+	}
+
+	// the reserved voices of the other TGs count as used
+	unsigned nUsed = 0;
+	for (unsigned i = 0; i < MaxToneGenerators; i++)
+	{
+		unsigned nTGVoices = m_nVoices[i];
+		nUsed += nTGVoices > m_nMinVoices[i] ? nTGVoices : m_nMinVoices[i];
+	}
+
+	return nUsed < m_nSize;
+}
+
+void CVoicePool::SetVoices (unsigned nVoices, unsigned nTG)
+{
+	assert (nTG < MaxToneGenerators);
+	m_nVoices[nTG] = nVoices;
+}
@@ -0,0 +1,62 @@
+//
+// voicepool.h
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2022  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _voicepool_h
+#define _voicepool_h
+
+#include <atomic>
+
+// Global budget of voices, which is shared by all TGs. Each TG may play up
+// to its maximum number of voices, as long as the pool is not exhausted.
+// The minimum number of voices of a TG is reserved for it, even when the
+// other TGs are playing. The TGs report their live voices with SetVoices()
+// after each keydown and chunk (from any core).
+
+class CVoicePool
+{
+public:
+	static const unsigned MaxToneGenerators = 16;	// >= CConfig::AllToneGenerators
+
+public:
+	CVoicePool (void);
+
+	void Initialize (unsigned nSize);		// 0 disables the pool
+
+	bool IsEnabled (void) const		{ return m_nSize > 0; }
+	unsigned GetSize (void) const		{ return m_nSize; }
+
+	void SetLimits (unsigned nMinVoices, unsigned nMaxVoices, unsigned nTG);
+	unsigned GetMinVoices (unsigned nTG) const;
+	unsigned GetMaxVoices (unsigned nTG) const;
+
+	// true, if the TG may start one more voice
+	bool CanAllocate (unsigned nTG) const;
+
+	void SetVoices (unsigned nVoices, unsigned nTG);
+
+private:
+	unsigned m_nSize;
+
+	unsigned m_nMinVoices[MaxToneGenerators];
+	unsigned m_nMaxVoices[MaxToneGenerators];
+
+	std::atomic<unsigned> m_nVoices[MaxToneGenerators];	// live voices
+};
+
+#endif
@@ -0,0 +1,209 @@
+//
+// xrunmonitor.cpp
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2022  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "xrunmonitor.h"
+#include <circle/timer.h>
+#include <circle/logger.h>
+#include <assert.h>
+
+LOGMODULE ("xrun");
+
+CXRunMonitor::CXRunMonitor (void)
+:	m_nSampleRate (48000),
+	m_nMinChunkFrames (0),
+	m_nMaxChunkFrames (0),
+	m_bAdaptive (false),
+	m_nChunkFrames (0),
+	m_nXRuns (0),
+	m_nNearMisses (0),
+	m_bStarted (false),
+	m_nLastUnderruns (0),
+	m_nPeriodNearMisses (0),
+	m_nGrowPeriodStartTicks (0),
+	m_nHeadroomStartTicks (0),
+	m_nMaxRenderTicks (0),
+	m_nReportedChunkFrames (0),
+	m_nReportedXRuns (0),
+	m_nReportedNearMisses (0),
+	m_nLastReportTicks (0)
+{
+}
+
+void CXRunMonitor::Initialize (unsigned nSampleRate, unsigned nMinChunkFrames, unsigned nMaxChunkFrames,
+			       bool bAdaptive)
+{
+	assert (nSampleRate > 0);
+	assert (nMinChunkFrames > 0);
+
+	m_nSampleRate = nSampleRate;
+	m_nMinChunkFrames = nMinChunkFrames;
+	m_nMaxChunkFrames = bAdaptive && nMaxChunkFrames > nMinChunkFrames ? nMaxChunkFrames : nMinChunkFrames;
+	m_bAdaptive = m_nMaxChunkFrames > m_nMinChunkFrames;
+
+	m_nChunkFrames = nMinChunkFrames;
+	m_nReportedChunkFrames = nMinChunkFrames;
+
+	if (m_bAdaptive)
+	{
+		LOGNOTE ("Adaptive chunk size from %u to %u frames", m_nMinChunkFrames, m_nMaxChunkFrames);
+	}
+}
+
+unsigned CXRunMonitor::GetChunkMicros (void) const
+{
+	return (u64) m_nChunkFrames * 1000000U / m_nSampleRate;
+}
+
+bool CXRunMonitor::Update (unsigned nQueuedFrames, unsigned nUnderruns)
+{
+	unsigned nTicks = CTimer::GetClockTicks ();
+	unsigned nChunkFrames = m_nChunkFrames;
+
+	if (!m_bStarted)			// the queue is empty before the first chunk
+	{
+		m_bStarted = true;
+		m_nLastUnderruns = nUnderruns;
+		m_nGrowPeriodStartTicks = nTicks;
+		m_nHeadroomStartTicks = nTicks;
+
+		return false;
+	}
+
+	bool bXRun = nQueuedFrames == 0 || nUnderruns != m_nLastUnderruns;
+	bool bNearMiss = bXRun || nQueuedFrames < nChunkFrames/4;
+	m_nLastUnderruns = nUnderruns;
+
+	if (bXRun)
+	{
+		m_nXRuns++;
+	}
+	else if (bNearMiss)
+	{
+		m_nNearMisses++;
+	}
+
+	if (!m_bAdaptive)
+	{
+		return false;
+	}
+
+	if (nTicks - m_nGrowPeriodStartTicks >= GrowPeriodMillis * (CLOCKHZ / 1000))
+	{
+		m_nGrowPeriodStartTicks = nTicks;
+		m_nPeriodNearMisses = 0;
+	}
+
+	if (bNearMiss)
+	{
+		m_nHeadroomStartTicks = nTicks;
+		m_nMaxRenderTicks = 0;
+
+		if (   ++m_nPeriodNearMisses >= NearMissLimit
+		    && nChunkFrames < m_nMaxChunkFrames)
+		{
+			SetChunkFrames (nChunkFrames * 2);
+
+			return true;
+		}
+
+		return false;
+	}
+
+	if (   nTicks - m_nHeadroomStartTicks >= ShrinkPeriodMillis * (CLOCKHZ / 1000)
+	    && nChunkFrames > m_nMinChunkFrames)
+	{
+		// Shrink only, if the half chunk could have been rendered
+		// within its period with some margin.
+		u64 nChunkTicks = (u64) nChunkFrames * CLOCKHZ / m_nSampleRate;
+		if ((u64) m_nMaxRenderTicks * 100 < nChunkTicks * HeadroomPercent)
+		{
+			SetChunkFrames (nChunkFrames / 2);
+
+			return true;
+		}
+
+		m_nHeadroomStartTicks = nTicks;
+		m_nMaxRenderTicks = 0;
+	}
+
+	return false;
+}
+
+void CXRunMonitor::ChunkRendered (unsigned nTicks)
+{
+	if (nTicks > m_nMaxRenderTicks)
+	{
+		m_nMaxRenderTicks = nTicks;
+	}
+}
+
+void CXRunMonitor::Report (void)
+{
+	unsigned nChunkFrames = m_nChunkFrames;
+	if (nChunkFrames != m_nReportedChunkFrames)
+	{
+		LOGNOTE ("Chunk size %s to %u frames (%u us)",
+			 nChunkFrames > m_nReportedChunkFrames ? "increased" : "decreased",
+			 nChunkFrames, GetChunkMicros ());
+
+		m_nReportedChunkFrames = nChunkFrames;
+	}
+
+	// xruns are reported once per second at most
+	unsigned nTicks = CTimer::GetClockTicks ();
+	if (nTicks - m_nLastReportTicks < CLOCKHZ)
+	{
+		return;
+	}
+
+	m_nLastReportTicks = nTicks;
+
+	unsigned nXRuns = m_nXRuns;
+	unsigned nNearMisses = m_nNearMisses;
+	if (   nXRuns != m_nReportedXRuns
+	    || nNearMisses != m_nReportedNearMisses)
+	{
+		LOGWARN ("%u xruns, %u near-misses (total %u, %u)",
+			 nXRuns - m_nReportedXRuns, nNearMisses - m_nReportedNearMisses,
+			 nXRuns, nNearMisses);
+
+		m_nReportedXRuns = nXRuns;
+		m_nReportedNearMisses = nNearMisses;
+	}
+}
+
+void CXRunMonitor::SetChunkFrames (unsigned nFrames)
+{
+	if (nFrames > m_nMaxChunkFrames)
+	{
+		nFrames = m_nMaxChunkFrames;
+	}
+	else if (nFrames < m_nMinChunkFrames)
+	{
+		nFrames = m_nMinChunkFrames;
+	}
+
+	m_nChunkFrames = nFrames;
+
+	unsigned nTicks = CTimer::GetClockTicks ();
+	m_nPeriodNearMisses = 0;
+	m_nGrowPeriodStartTicks = nTicks;
+	m_nHeadroomStartTicks = nTicks;
+	m_nMaxRenderTicks = 0;
+}
@@ -0,0 +1,97 @@
+//
+// xrunmonitor.h
+//
+// MiniDexed - Dexed FM synthesizer for bare metal Raspberry Pi
+// Copyright (C) 2022  The MiniDexed Team
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _xrunmonitor_h
+#define _xrunmonitor_h
+
+#include <circle/types.h>
+#include <atomic>
+
+// Watches the fill level of the sound queue, each time a chunk is about to
+// be rendered. An empty queue (or an underrun reported by the device) is an
+// xrun, a queue with less than a quarter chunk left is a near-miss.
+//
+// In adaptive mode the working chunk size is doubled (up to the maximum)
+// after repeated near-misses and halved again (down to the configured chunk
+// size) after a sustained period of headroom. The audio path renders the
+// working chunk size and keeps two chunks in the queue, so the latency
+// follows the chunk size.
+//
+// Update() and ChunkRendered() are called on the audio core, Report() logs
+// the xruns and chunk size transitions from the main loop.
+
+class CXRunMonitor
+{
+public:
+	static const unsigned NearMissLimit = 3;		// near-misses within GrowPeriod to grow
+	static const unsigned GrowPeriodMillis = 1000;
+	static const unsigned ShrinkPeriodMillis = 10000;	// headroom required to shrink
+	static const unsigned HeadroomPercent = 40;		// of the chunk period, max. render time
+
+public:
+	CXRunMonitor (void);
+
+	// frame counts per chunk, nMaxChunkFrames is ignored if !bAdaptive
+	void Initialize (unsigned nSampleRate, unsigned nMinChunkFrames, unsigned nMaxChunkFrames,
+			 bool bAdaptive);
+
+	unsigned GetChunkFrames (void) const	{ return m_nChunkFrames; }
+	unsigned GetChunkMicros (void) const;
+
+	// nQueuedFrames: frames left in the sound queue before rendering
+	// nUnderruns: total underrun count of the device (0 if not supported)
+	// returns true, if the chunk size has changed
+	bool Update (unsigned nQueuedFrames, unsigned nUnderruns = 0);
+
+	void ChunkRendered (unsigned nTicks);		// render time of the last chunk
+
+	unsigned GetXRuns (void) const		{ return m_nXRuns; }
+	unsigned GetNearMisses (void) const	{ return m_nNearMisses; }
+
+	void Report (void);
+
+private:
+	void SetChunkFrames (unsigned nFrames);
+
+private:
+	unsigned m_nSampleRate;
+	unsigned m_nMinChunkFrames;
+	unsigned m_nMaxChunkFrames;
+	bool m_bAdaptive;
+
+	std::atomic<unsigned> m_nChunkFrames;
+	std::atomic<unsigned> m_nXRuns;
+	std::atomic<unsigned> m_nNearMisses;
+
+	// audio core only
+	bool m_bStarted;
+	unsigned m_nLastUnderruns;
+	unsigned m_nPeriodNearMisses;
+	unsigned m_nGrowPeriodStartTicks;
+	unsigned m_nHeadroomStartTicks;
+	unsigned m_nMaxRenderTicks;		// since m_nHeadroomStartTicks
+
+	// main loop only
+	unsigned m_nReportedChunkFrames;
+	unsigned m_nReportedXRuns;
+	unsigned m_nReportedNearMisses;
+	unsigned m_nLastReportTicks;
+};
+
+#endif